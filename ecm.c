@@ -0,0 +1,1127 @@
+/*
+ * Elliptic Curve Method (ECM) Attack on RSA
+ * Usage: ./ecm <n> [e] [--threads T] [--B1 X] [--curves C] [--batch K] [--sigma S] [--stats FILE]
+ *        ./ecm --demo
+ *        ./ecm --bench-batch
+ *
+ * Build: gcc ecm.c -o ecm -lm -lpthread
+ *
+ * Each curve is sequential, but curves are independent: a pool of worker
+ * threads pulls sigma values from a shared counter and the first factor
+ * found cancels every other worker.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#define DEFAULT_B1 2000
+#define B2_FACTOR 100
+#define STAGE2_D 210
+#define MAX_THREADS 256
+#define MAX_BATCH 4096
+#define MAX_BATCH_BENCH 1024
+#define CANCEL_CHECK_MASK 63   // poll the cancel flag every 64 primes
+#define DEFAULT_STATS_FILE "ecm_stats.txt"
+
+uint64_t gcd(uint64_t a, uint64_t b)
+{
+    while (b != 0)
+    {
+        uint64_t temp = b;
+        b = a % b;
+        a = temp;
+    }
+    return a;
+}
+
+int64_t mod_inverse(int64_t e, int64_t phi)
+{
+    int64_t t = 0, newt = 1;
+    int64_t r = phi, newr = e;
+    
+    while (newr != 0)
+    {
+        int64_t quotient = r / newr;
+        int64_t temp_t = t;
+        t = newt;
+        newt = temp_t - quotient * newt;
+        int64_t temp_r = r;
+        r = newr;
+        newr = temp_r - quotient * newr;
+    }
+    
+    if (t < 0)
+        t += phi;
+    return t;
+}
+
+// ============ Montgomery arithmetic (n odd, n < 2^63) ============
+
+typedef struct {
+    uint64_t n;
+    uint64_t ninv;   // -n^-1 mod 2^64
+    uint64_t one;    // R mod n
+    uint64_t r2;     // R^2 mod n
+} MontCtx;
+
+static void mont_init(MontCtx *M, uint64_t n)
+{
+    uint64_t inv = n;
+    for (int i = 0; i < 5; i++)
+        inv *= 2 - n * inv;   // Newton: doubles correct bits each step
+    M->n = n;
+    M->ninv = (uint64_t)0 - inv;
+    M->one = (uint64_t)(((__uint128_t)1 << 64) % n);
+    M->r2 = (uint64_t)(((__uint128_t)M->one * M->one) % n);
+}
+
+static inline uint64_t mont_redc(__uint128_t t, const MontCtx *M)
+{
+    uint64_t m = (uint64_t)t * M->ninv;
+    uint64_t u = (uint64_t)((t + (__uint128_t)m * M->n) >> 64);
+    return (u >= M->n) ? u - M->n : u;
+}
+
+static inline uint64_t mont_mul(uint64_t a, uint64_t b, const MontCtx *M)
+{
+    return mont_redc((__uint128_t)a * b, M);
+}
+
+static inline uint64_t mod_add(uint64_t a, uint64_t b, uint64_t n)
+{
+    uint64_t s = a + b;
+    return (s >= n) ? s - n : s;
+}
+
+static inline uint64_t mod_sub(uint64_t a, uint64_t b, uint64_t n)
+{
+    return (a >= b) ? a - b : a + n - b;
+}
+
+static inline uint64_t to_mont(uint64_t a, const MontCtx *M)
+{
+    return mont_mul(a % M->n, M->r2, M);
+}
+
+static inline uint64_t from_mont(uint64_t a, const MontCtx *M)
+{
+    return mont_redc(a, M);
+}
+
+// Deterministic Miller-Rabin for n < 2^64 (first 12 primes as bases)
+static int is_prime_mr(uint64_t n)
+{
+    static const uint64_t bases[] = {2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37};
+    if (n < 2)
+        return 0;
+    for (int i = 0; i < 12; i++)
+    {
+        if (n % bases[i] == 0)
+            return n == bases[i];
+    }
+    
+    MontCtx M;
+    mont_init(&M, n);
+    uint64_t d = n - 1;
+    int s = 0;
+    while ((d & 1) == 0)
+    {
+        d >>= 1;
+        s++;
+    }
+    uint64_t minus_one = n - M.one;
+    for (int i = 0; i < 12; i++)
+    {
+        uint64_t x = M.one, b = to_mont(bases[i], &M);
+        for (uint64_t k = d; k; k >>= 1)
+        {
+            if (k & 1)
+                x = mont_mul(x, b, &M);
+            b = mont_mul(b, b, &M);
+        }
+        if (x == M.one || x == minus_one)
+            continue;
+        int composite = 1;
+        for (int r = 1; r < s && composite; r++)
+        {
+            x = mont_mul(x, x, &M);
+            if (x == minus_one)
+                composite = 0;
+        }
+        if (composite)
+            return 0;
+    }
+    return 1;
+}
+
+// ============ Montgomery curve, XZ coordinates ============
+
+typedef struct {
+    uint64_t x, z;
+} Point;
+
+// [2]P, with a24 = (A + 2) / 4
+static void xdbl(Point *r, const Point *p, uint64_t a24, const MontCtx *M)
+{
+    uint64_t s = mod_add(p->x, p->z, M->n);
+    uint64_t d = mod_sub(p->x, p->z, M->n);
+    uint64_t t1 = mont_mul(s, s, M);
+    uint64_t t2 = mont_mul(d, d, M);
+    uint64_t t3 = mod_sub(t1, t2, M->n);
+    r->x = mont_mul(t1, t2, M);
+    r->z = mont_mul(t3, mod_add(t2, mont_mul(a24, t3, M), M->n), M);
+}
+
+// P + Q given P - Q
+static void xadd(Point *r, const Point *p, const Point *q, const Point *diff, const MontCtx *M)
+{
+    uint64_t u = mont_mul(mod_sub(p->x, p->z, M->n), mod_add(q->x, q->z, M->n), M);
+    uint64_t v = mont_mul(mod_add(p->x, p->z, M->n), mod_sub(q->x, q->z, M->n), M);
+    uint64_t s = mod_add(u, v, M->n);
+    uint64_t d = mod_sub(u, v, M->n);
+    uint64_t x = mont_mul(diff->z, mont_mul(s, s, M), M);
+    uint64_t z = mont_mul(diff->x, mont_mul(d, d, M), M);
+    r->x = x;
+    r->z = z;
+}
+
+// Montgomery ladder: [k]P
+static void ladder(Point *r, const Point *p, uint64_t k, uint64_t a24, const MontCtx *M)
+{
+    Point r0 = *p, r1;
+    xdbl(&r1, p, a24, M);
+    int top = 63 - __builtin_clzll(k);
+    for (int i = top - 1; i >= 0; i--)
+    {
+        if ((k >> i) & 1)
+        {
+            xadd(&r0, &r1, &r0, p, M);
+            xdbl(&r1, &r1, a24, M);
+        }
+        else
+        {
+            xadd(&r1, &r1, &r0, p, M);
+            xdbl(&r0, &r0, a24, M);
+        }
+    }
+    *r = r0;
+}
+
+// ============ Shared job state ============
+
+typedef struct {
+    uint64_t n;
+    uint64_t B1, B2;
+    uint64_t max_curves;             // 0 = unlimited
+    int batch;                       // curves per affine batch (1 = XZ ladder)
+    const uint32_t *primes;          // primes <= B2
+    int num_primes;
+    int num_stage1;                  // primes <= B1
+    const uint8_t *is_prime;         // bitmap up to B2
+    
+    atomic_uint_fast64_t next_sigma;
+    atomic_uint_fast64_t issued;     // curves handed out
+    atomic_uint_fast64_t factor;     // 0 until the first worker succeeds
+} EcmJob;
+
+typedef struct {
+    EcmJob *job;
+    uint64_t curves_done;
+    pthread_t tid;
+} Worker;
+
+static int cancelled(EcmJob *job)
+{
+    return atomic_load_explicit(&job->factor, memory_order_relaxed) != 0;
+}
+
+static void publish_factor(EcmJob *job, uint64_t f)
+{
+    uint_fast64_t expected = 0;
+    atomic_compare_exchange_strong(&job->factor, &expected, f);
+}
+
+/*
+ * Suyama parametrization: u = sigma^2 - 5, v = 4 sigma,
+ * x0 = u^3, z0 = v^3, a24 = (v - u)^3 (3u + v) / (16 u^3 v).
+ * Returns a factor if the curve setup itself hits a non-invertible element.
+ */
+static uint64_t curve_from_sigma(uint64_t sigma, Point *p, uint64_t *a24, const MontCtx *M)
+{
+    uint64_t n = M->n;
+    uint64_t s = to_mont(sigma, M);
+    uint64_t u = mod_sub(mont_mul(s, s, M), to_mont(5, M), n);
+    uint64_t v = mod_add(mod_add(s, s, n), mod_add(s, s, n), n);
+    uint64_t u3 = mont_mul(mont_mul(u, u, M), u, M);
+    uint64_t v3 = mont_mul(mont_mul(v, v, M), v, M);
+    uint64_t vmu = mod_sub(v, u, n);
+    uint64_t num = mont_mul(mont_mul(mont_mul(vmu, vmu, M), vmu, M),
+                            mod_add(mod_add(mod_add(u, u, n), u, n), v, n), M);
+    uint64_t den = mont_mul(mont_mul(to_mont(16, M), u3, M), v, M);
+    
+    uint64_t den_plain = from_mont(den, M);
+    uint64_t g = gcd(den_plain, n);
+    if (g != 1)
+        return (g != n) ? g : 0;
+    uint64_t inv = (uint64_t)mod_inverse((int64_t)den_plain, (int64_t)n);
+    
+    *a24 = mont_mul(num, to_mont(inv, M), M);
+    p->x = u3;
+    p->z = v3;
+    return 1;
+}
+
+// Stage 1: multiply by every prime power <= B1. Returns 0 if cancelled.
+static int ecm_stage1(EcmJob *job, Point *P, uint64_t a24, const MontCtx *M)
+{
+    for (int i = 0; i < job->num_stage1; i++)
+    {
+        if ((i & CANCEL_CHECK_MASK) == 0 && cancelled(job))
+            return 0;
+        uint64_t p = job->primes[i];
+        uint64_t q = p;
+        while (q <= job->B1 / p)
+            q *= p;
+        ladder(P, P, q, a24, M);
+    }
+    return 1;
+}
+
+/*
+ * Stage 2: baby-step / giant-step continuation over primes in (B1, B2]
+ * with D = 210. Returns a proper factor, 1 if nothing found, 0 if cancelled.
+ */
+static uint64_t ecm_stage2(EcmJob *job, const Point *P, uint64_t a24, const MontCtx *M)
+{
+    uint64_t n = M->n;
+    
+    // Baby steps: [j]P for odd j < D/2 (only those coprime to D are used)
+    Point baby[STAGE2_D / 2];
+    Point P2;
+    xdbl(&P2, P, a24, M);
+    baby[1] = *P;
+    xadd(&baby[3], &P2, P, P, M);
+    for (int j = 5; j < STAGE2_D / 2; j += 2)
+        xadd(&baby[j], &baby[j - 2], &P2, &baby[j - 4], M);
+    
+    // Giant steps: G_k = [k D]P
+    Point G1, Gprev, G;
+    ladder(&G1, P, STAGE2_D, a24, M);
+    uint64_t k0 = job->B1 / STAGE2_D;
+    if (k0 < 1)
+        k0 = 1;
+    ladder(&G, P, k0 * STAGE2_D, a24, M);
+    if (k0 > 1)
+        ladder(&Gprev, P, (k0 - 1) * STAGE2_D, a24, M);
+    
+    uint64_t acc = M->one;
+    for (uint64_t k = k0; k * STAGE2_D <= job->B2 + STAGE2_D; k++)
+    {
+        if ((k & CANCEL_CHECK_MASK) == 0 && cancelled(job))
+            return 0;
+        uint64_t base = k * STAGE2_D;
+        for (int j = 1; j < STAGE2_D / 2; j += 2)
+        {
+            if (gcd(j, STAGE2_D) != 1)
+                continue;
+            uint64_t lo = base - j, hi = base + j;
+            int use = (lo > job->B1 && lo <= job->B2 && job->is_prime[lo]) ||
+                      (hi > job->B1 && hi <= job->B2 && job->is_prime[hi]);
+            if (!use)
+                continue;
+            // X_G Z_j - X_j Z_G vanishes mod p iff [kD]P = +-[j]P mod p
+            uint64_t t = mod_sub(mont_mul(G.x, baby[j].z, M), mont_mul(baby[j].x, G.z, M), n);
+            acc = mont_mul(acc, t, M);
+        }
+        Point next;
+        if (k == 1)
+            xdbl(&next, &G, a24, M);   // no [0]P difference available for the first step
+        else
+            xadd(&next, &G, &G1, &Gprev, M);
+        Gprev = G;
+        G = next;
+    }
+    
+    uint64_t g = gcd(from_mont(acc, M), n);
+    if (g > 1 && g < n)
+        return g;
+    return 1;
+}
+
+// One curve in XZ coordinates. Returns a proper factor, 1 on failure, 0 if cancelled.
+static uint64_t ecm_curve(EcmJob *job, uint64_t sigma, const MontCtx *M)
+{
+    Point P;
+    uint64_t a24;
+    
+    uint64_t setup = curve_from_sigma(sigma, &P, &a24, M);
+    if (setup != 1)
+        return (setup > 1) ? setup : 1;
+    
+    if (!ecm_stage1(job, &P, a24, M))
+        return 0;
+    
+    uint64_t g = gcd(from_mont(P.z, M), M->n);
+    if (g == M->n)
+        return 1;
+    if (g > 1)
+        return g;
+    
+    return ecm_stage2(job, &P, a24, M);
+}
+
+// ============ Batch inversion (Montgomery's trick) ============
+
+/*
+ * Inverts k Montgomery-form values with one extended Euclid plus 3(k-1)
+ * multiplies. scratch must hold k words. Returns 1 on success; otherwise
+ * returns 0 and stores gcd(product, n) in *factor (possibly n itself).
+ */
+static int batch_inverse(uint64_t *out, const uint64_t *in, int k, uint64_t *scratch,
+                         const MontCtx *M, uint64_t *factor)
+{
+    scratch[0] = in[0];
+    for (int i = 1; i < k; i++)
+        scratch[i] = mont_mul(scratch[i - 1], in[i], M);
+    
+    uint64_t prod = from_mont(scratch[k - 1], M);
+    uint64_t g = gcd(prod, M->n);
+    if (g != 1)
+    {
+        *factor = g;
+        return 0;
+    }
+    uint64_t inv = to_mont((uint64_t)mod_inverse((int64_t)prod, (int64_t)M->n), M);
+    
+    for (int i = k - 1; i > 0; i--)
+    {
+        out[i] = mont_mul(inv, scratch[i - 1], M);
+        inv = mont_mul(inv, in[i], M);
+    }
+    out[0] = inv;
+    return 1;
+}
+
+// ============ Multi-curve affine stage 1 ============
+
+/*
+ * k curves B y^2 = x^3 + A x^2 + x advanced in lock-step. Every doubling or
+ * addition needs one inversion per curve; Montgomery's trick turns those
+ * k inversions into a single extended Euclid.
+ */
+typedef struct {
+    int k;
+    uint64_t *A, *B;          // curve coefficients (Montgomery form)
+    uint64_t *x, *y;          // current point R
+    uint64_t *bx, *by;        // base point for the current prime power
+    uint64_t *den, *inv, *scratch;
+    uint8_t *dead;            // curve hit O mod every prime of n; skip it
+} CurveBatch;
+
+static int batch_alloc(CurveBatch *cb, int k)
+{
+    cb->k = k;
+    uint64_t *words = calloc((size_t)k * 9, sizeof(uint64_t));
+    cb->dead = calloc(k, 1);
+    if (!words || !cb->dead)
+    {
+        free(words);
+        free(cb->dead);
+        return 0;
+    }
+    cb->A = words;
+    cb->B = words + k;
+    cb->x = words + 2 * k;
+    cb->y = words + 3 * k;
+    cb->bx = words + 4 * k;
+    cb->by = words + 5 * k;
+    cb->den = words + 6 * k;
+    cb->inv = words + 7 * k;
+    cb->scratch = words + 8 * k;
+    return 1;
+}
+
+static void batch_free(CurveBatch *cb)
+{
+    free(cb->A);
+    free(cb->dead);
+}
+
+/*
+ * Batch-invert cb->den into cb->inv. A proper factor is returned directly;
+ * curves whose denominator is 0 mod n are marked dead and the batch retried.
+ * Returns 1 on success, or the factor (> 1).
+ */
+static uint64_t batch_invert_curves(CurveBatch *cb, const MontCtx *M)
+{
+    uint64_t g;
+    while (!batch_inverse(cb->inv, cb->den, cb->k, cb->scratch, M, &g))
+    {
+        if (g != M->n)
+            return g;
+        for (int i = 0; i < cb->k; i++)
+        {
+            uint64_t gi = gcd(from_mont(cb->den[i], M), M->n);
+            if (gi > 1 && gi < M->n)
+                return gi;
+            if (gi == M->n)
+            {
+                cb->dead[i] = 1;
+                cb->den[i] = M->one;
+            }
+        }
+    }
+    return 1;
+}
+
+static uint64_t batch_double(CurveBatch *cb, const MontCtx *M)
+{
+    uint64_t n = M->n;
+    for (int i = 0; i < cb->k; i++)
+    {
+        uint64_t by = mont_mul(cb->B[i], cb->y[i], M);
+        cb->den[i] = cb->dead[i] ? M->one : mod_add(by, by, n);
+    }
+    uint64_t r = batch_invert_curves(cb, M);
+    if (r != 1)
+        return r;
+    for (int i = 0; i < cb->k; i++)
+    {
+        if (cb->dead[i])
+            continue;
+        // lambda = (3x^2 + 2Ax + 1) / 2By
+        uint64_t x = cb->x[i], y = cb->y[i];
+        uint64_t xx = mont_mul(x, x, M);
+        uint64_t ax = mont_mul(cb->A[i], x, M);
+        uint64_t num = mod_add(mod_add(mod_add(xx, xx, n), xx, n), mod_add(mod_add(ax, ax, n), M->one, n), n);
+        uint64_t lambda = mont_mul(num, cb->inv[i], M);
+        uint64_t x3 = mod_sub(mod_sub(mont_mul(cb->B[i], mont_mul(lambda, lambda, M), M), cb->A[i], n),
+                              mod_add(x, x, n), n);
+        cb->y[i] = mod_sub(mont_mul(lambda, mod_sub(x, x3, n), M), y, n);
+        cb->x[i] = x3;
+    }
+    return 1;
+}
+
+// R <- R + base on every live curve
+static uint64_t batch_add_base(CurveBatch *cb, const MontCtx *M)
+{
+    uint64_t n = M->n;
+    for (int i = 0; i < cb->k; i++)
+        cb->den[i] = cb->dead[i] ? M->one : mod_sub(cb->bx[i], cb->x[i], n);
+    uint64_t r = batch_invert_curves(cb, M);
+    if (r != 1)
+        return r;
+    for (int i = 0; i < cb->k; i++)
+    {
+        if (cb->dead[i])
+            continue;
+        uint64_t x = cb->x[i], y = cb->y[i];
+        uint64_t lambda = mont_mul(mod_sub(cb->by[i], y, n), cb->inv[i], M);
+        uint64_t x3 = mod_sub(mod_sub(mont_mul(cb->B[i], mont_mul(lambda, lambda, M), M), cb->A[i], n),
+                              mod_add(x, cb->bx[i], n), n);
+        cb->y[i] = mod_sub(mont_mul(lambda, mod_sub(x, x3, n), M), y, n);
+        cb->x[i] = x3;
+    }
+    return 1;
+}
+
+/*
+ * Suyama curves for sigma0 .. sigma0+k-1 in affine form: x0 = u^3 / v^3,
+ * y0 = 1, A = 4 a24 - 2 and B = x0^3 + A x0^2 + x0 so that (x0, 1) lies on
+ * the curve. Both inversions per curve come from one batch inversion of
+ * 16 u^3 v^4. Returns 1, or a factor.
+ */
+static uint64_t batch_setup(CurveBatch *cb, uint64_t sigma0, const MontCtx *M)
+{
+    uint64_t n = M->n;
+    uint64_t *num = cb->bx, *d1 = cb->by, *u3s = cb->x, *v3s = cb->y;
+    uint64_t five = to_mont(5, M), sixteen = to_mont(16, M);
+    
+    for (int i = 0; i < cb->k; i++)
+    {
+        cb->dead[i] = 0;
+        uint64_t s = to_mont(sigma0 + i, M);
+        uint64_t u = mod_sub(mont_mul(s, s, M), five, n);
+        uint64_t v = mod_add(mod_add(s, s, n), mod_add(s, s, n), n);
+        uint64_t vmu = mod_sub(v, u, n);
+        u3s[i] = mont_mul(mont_mul(u, u, M), u, M);
+        v3s[i] = mont_mul(mont_mul(v, v, M), v, M);
+        num[i] = mont_mul(mont_mul(mont_mul(vmu, vmu, M), vmu, M),
+                          mod_add(mod_add(mod_add(u, u, n), u, n), v, n), M);
+        d1[i] = mont_mul(mont_mul(sixteen, u3s[i], M), v, M);   // 16 u^3 v
+        cb->den[i] = mont_mul(d1[i], v3s[i], M);                // 16 u^3 v^4
+    }
+    uint64_t r = batch_invert_curves(cb, M);
+    if (r != 1)
+        return r;
+    
+    uint64_t two = mod_add(M->one, M->one, n);
+    for (int i = 0; i < cb->k; i++)
+    {
+        uint64_t a24 = mont_mul(mont_mul(num[i], v3s[i], M), cb->inv[i], M);
+        uint64_t x0 = mont_mul(mont_mul(u3s[i], d1[i], M), cb->inv[i], M);
+        uint64_t A = mod_sub(mod_add(mod_add(a24, a24, n), mod_add(a24, a24, n), n), two, n);
+        uint64_t xx = mont_mul(x0, x0, M);
+        cb->A[i] = A;
+        cb->B[i] = mod_add(mont_mul(xx, mod_add(x0, A, n), M), x0, n);
+        cb->x[i] = x0;
+        cb->y[i] = M->one;
+    }
+    return 1;
+}
+
+/*
+ * k curves at once: affine stage 1 with shared inversions, then the
+ * usual XZ stage 2 per curve. Returns a factor, 1 on failure, 0 if cancelled.
+ */
+static uint64_t ecm_batch(EcmJob *job, CurveBatch *cb, uint64_t sigma0, const MontCtx *M)
+{
+    uint64_t n = M->n;
+    uint64_t r = batch_setup(cb, sigma0, M);
+    if (r != 1)
+        return r;
+    
+    for (int p_idx = 0; p_idx < job->num_stage1; p_idx++)
+    {
+        if ((p_idx & CANCEL_CHECK_MASK) == 0 && cancelled(job))
+            return 0;
+        uint64_t p = job->primes[p_idx];
+        uint64_t q = p;
+        while (q <= job->B1 / p)
+            q *= p;
+        
+        memcpy(cb->bx, cb->x, cb->k * sizeof(uint64_t));
+        memcpy(cb->by, cb->y, cb->k * sizeof(uint64_t));
+        for (int bit = 62 - __builtin_clzll(q); bit >= 0; bit--)
+        {
+            if ((r = batch_double(cb, M)) != 1)
+                return r;
+            if (((q >> bit) & 1) && (r = batch_add_base(cb, M)) != 1)
+                return r;
+        }
+    }
+    
+    uint64_t inv4 = to_mont((uint64_t)mod_inverse(4, (int64_t)n), M);
+    uint64_t two = mod_add(M->one, M->one, n);
+    for (int i = 0; i < cb->k; i++)
+    {
+        if (cb->dead[i])
+            continue;
+        Point P = {cb->x[i], M->one};
+        uint64_t a24 = mont_mul(mod_add(cb->A[i], two, n), inv4, M);
+        uint64_t g = ecm_stage2(job, &P, a24, M);
+        if (g != 1)
+            return g;
+    }
+    return 1;
+}
+
+static void *worker_main(void *arg)
+{
+    Worker *w = (Worker *)arg;
+    EcmJob *job = w->job;
+    MontCtx M;
+    mont_init(&M, job->n);
+    
+    CurveBatch cb;
+    int k = job->batch;
+    if (k > 1 && !batch_alloc(&cb, k))
+        k = 1;
+    
+    while (!cancelled(job))
+    {
+        uint64_t slot = atomic_fetch_add(&job->issued, k);
+        if (job->max_curves && slot >= job->max_curves)
+            break;
+        int run = k;   // the last batch stops at max_curves
+        if (job->max_curves && job->max_curves - slot < (uint64_t)k)
+            run = (int)(job->max_curves - slot);
+        if (k > 1)
+            cb.k = run;
+        uint64_t sigma = atomic_fetch_add(&job->next_sigma, run);
+        uint64_t r = (run > 1) ? ecm_batch(job, &cb, sigma, &M) : ecm_curve(job, sigma, &M);
+        if (r == 0)
+            break;
+        w->curves_done += run;
+        if (r > 1)
+            publish_factor(job, r);
+    }
+    
+    if (k > 1)
+        batch_free(&cb);
+    return NULL;
+}
+
+// ============ Prime tables ============
+
+static uint8_t *sieve_bitmap(uint64_t limit)
+{
+    uint8_t *is_prime = malloc(limit + 1);
+    if (!is_prime)
+        return NULL;
+    memset(is_prime, 1, limit + 1);
+    is_prime[0] = 0;
+    if (limit >= 1)
+        is_prime[1] = 0;
+    for (uint64_t p = 2; p * p <= limit; p++)
+    {
+        if (is_prime[p])
+        {
+            for (uint64_t j = p * p; j <= limit; j += p)
+                is_prime[j] = 0;
+        }
+    }
+    return is_prime;
+}
+
+// ============ Curve statistics (persisted across runs) ============
+
+#define MAX_STAT_ROWS 64
+
+typedef struct {
+    uint64_t B1;
+    uint64_t curves;
+} StatRow;
+
+// Expected curves per factor size (GMP-ECM tables, Suyama parametrization)
+static const struct { int digits; uint64_t B1; uint64_t curves; } expected_work[] = {
+    {10, 360, 7},
+    {15, 2000, 25},
+    {20, 11000, 90},
+    {25, 50000, 300},
+    {30, 250000, 700},
+};
+
+static int load_stats(const char *path, StatRow *rows)
+{
+    FILE *fp = fopen(path, "r");
+    if (!fp)
+        return 0;
+    int count = 0;
+    uint64_t b1, curves;
+    while (count < MAX_STAT_ROWS && fscanf(fp, "%" SCNu64 " %" SCNu64, &b1, &curves) == 2)
+    {
+        rows[count].B1 = b1;
+        rows[count].curves = curves;
+        count++;
+    }
+    fclose(fp);
+    return count;
+}
+
+static int save_stats(const char *path, const StatRow *rows, int count)
+{
+    char tmp[1024];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    FILE *fp = fopen(tmp, "w");
+    if (!fp)
+        return 0;
+    for (int i = 0; i < count; i++)
+        fprintf(fp, "%" PRIu64 " %" PRIu64 "\n", rows[i].B1, rows[i].curves);
+    fclose(fp);
+    return rename(tmp, path) == 0;
+}
+
+// Add this run's curves and return the new lifetime total at B1
+static uint64_t record_curves(const char *path, uint64_t B1, uint64_t curves)
+{
+    StatRow rows[MAX_STAT_ROWS];
+    int count = load_stats(path, rows);
+    int i;
+    for (i = 0; i < count; i++)
+        if (rows[i].B1 == B1)
+            break;
+    if (i == count)
+    {
+        if (count == MAX_STAT_ROWS)
+            return curves;
+        rows[count].B1 = B1;
+        rows[count].curves = 0;
+        count++;
+    }
+    rows[i].curves += curves;
+    if (!save_stats(path, rows, count))
+        fprintf(stderr, "Warning: could not write %s\n", path);
+    return rows[i].curves;
+}
+
+static void print_expected_work(uint64_t B1, uint64_t total)
+{
+    int rows = sizeof(expected_work) / sizeof(expected_work[0]);
+    for (int i = 0; i < rows; i++)
+    {
+        if (expected_work[i].B1 != B1)
+            continue;
+        printf("Coverage: %.2f of the expected %" PRIu64 " curves for a %d-digit factor\n",
+               (double)total / expected_work[i].curves, expected_work[i].curves,
+               expected_work[i].digits);
+        return;
+    }
+}
+
+// ============ Driver ============
+
+static double wall_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/*
+ * Runs curves on `threads` workers until a factor is found or max_curves
+ * have been issued; batch > 1 runs stage 1 on that many curves at a
+ * time. Returns the factor (0 on failure); *curves gets the number of
+ * curves actually completed.
+ */
+uint64_t ecm_factor(uint64_t n, uint64_t B1, uint64_t max_curves, int threads,
+                    int batch, uint64_t sigma0, uint64_t *curves)
+{
+    *curves = 0;
+    if (n % 2 == 0)
+        return 2;
+    if (n % 3 == 0)
+        return 3;
+    
+    uint64_t B2 = B1 * B2_FACTOR;
+    uint8_t *is_prime = sieve_bitmap(B2);
+    if (!is_prime)
+        return 0;
+    uint32_t *primes = malloc(sizeof(uint32_t) * (B2 / 2 + 2));
+    if (!primes)
+    {
+        free(is_prime);
+        return 0;
+    }
+    int num_primes = 0, num_stage1 = 0;
+    for (uint64_t i = 2; i <= B2; i++)
+    {
+        if (!is_prime[i])
+            continue;
+        primes[num_primes++] = (uint32_t)i;
+        if (i <= B1)
+            num_stage1 = num_primes;
+    }
+    
+    EcmJob job;
+    job.n = n;
+    job.B1 = B1;
+    job.B2 = B2;
+    job.max_curves = max_curves;
+    job.batch = (batch > 1) ? batch : 1;
+    job.primes = primes;
+    job.num_primes = num_primes;
+    job.num_stage1 = num_stage1;
+    job.is_prime = is_prime;
+    atomic_init(&job.next_sigma, sigma0);
+    atomic_init(&job.issued, 0);
+    atomic_init(&job.factor, 0);
+    
+    Worker workers[MAX_THREADS];
+    for (int t = 0; t < threads; t++)
+    {
+        workers[t].job = &job;
+        workers[t].curves_done = 0;
+        pthread_create(&workers[t].tid, NULL, worker_main, &workers[t]);
+    }
+    for (int t = 0; t < threads; t++)
+    {
+        pthread_join(workers[t].tid, NULL);
+        *curves += workers[t].curves_done;
+    }
+    
+    free(primes);
+    free(is_prime);
+    return atomic_load(&job.factor);
+}
+
+static int default_threads(void)
+{
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cpus < 1)
+        return 1;
+    return (cpus > MAX_THREADS) ? MAX_THREADS : (int)cpus;
+}
+
+static uint64_t random_sigma(void)
+{
+    // sigma must avoid {0, 1, 3, 5}; start well above them
+    return 6 + ((uint64_t)time(NULL) * 2654435761ULL ^ (uint64_t)getpid()) % 1000000007ULL;
+}
+
+void run_demo()
+{
+    int threads = default_threads();
+    
+    printf("ECM Scaling Demo (B1=%d, %d thread%s)\n", DEFAULT_B1, threads, threads == 1 ? "" : "s");
+    printf("======================================\n\n");
+    printf("%-10s %15s %12s %12s\n", "Bits", "Curves", "Wall", "CPU");
+    printf("------------------------------------------------------\n");
+    
+    // Same table as pollards_rho --demo
+    struct { int bits; uint64_t n; } tests[] = {
+        {16, 1106774983ULL},
+        {20, 275447306077ULL},
+        {22, 4400626126189ULL},
+        {24, 70377803883943ULL},
+        {26, 1125938964277027ULL},
+        {28, 18014546685901351ULL},
+        {30, 288230981742142951ULL},
+        {31, 1152922614855900181ULL},
+    };
+    int num_tests = sizeof(tests) / sizeof(tests[0]);
+    
+    for (int i = 0; i < num_tests; i++)
+    {
+        double start = wall_seconds();
+        clock_t cpu_start = clock();
+        uint64_t curves;
+        uint64_t p = ecm_factor(tests[i].n, DEFAULT_B1, 0, threads, 1, 6 + i, &curves);
+        double wall = wall_seconds() - start;
+        double cpu = (double)(clock() - cpu_start) / CLOCKS_PER_SEC;
+        
+        if (p == 0)
+            printf("%-10d %15s %10.4fs %10.4fs\n", tests[i].bits, "FAILED", wall, cpu);
+        else
+            printf("%-10d %15" PRIu64 " %10.4fs %10.4fs\n", tests[i].bits, curves, wall, cpu);
+    }
+    
+    printf("\n");
+    printf("ECM runtime depends on the smaller factor p, not on n:\n");
+    printf("L_p[1/2, sqrt(2)] per factor, so curves parallelize perfectly.\n");
+}
+
+void run_batch_bench()
+{
+    // 60-bit modulus from the demo table; stage-1 cost is independent of its factors
+    uint64_t n = 1152922614855900181ULL;
+    MontCtx M;
+    mont_init(&M, n);
+    
+    printf("Batch Inversion Benchmark (n = %" PRIu64 ")\n", n);
+    printf("=========================================\n\n");
+    printf("%-8s %14s %14s %9s %16s %16s\n", "k", "Euclid/inv", "Batch/inv", "Speedup",
+           "XZ stage1/curve", "Affine/curve");
+    printf("-------------------------------------------------------------------------------\n");
+    
+    uint64_t vals[MAX_BATCH_BENCH], out[MAX_BATCH_BENCH], scratch[MAX_BATCH_BENCH];
+    uint64_t seed = 88172645463325252ULL;
+    for (int i = 0; i < MAX_BATCH_BENCH; i++)
+    {
+        seed ^= seed << 13;
+        seed ^= seed >> 7;
+        seed ^= seed << 17;
+        vals[i] = to_mont(seed % n, &M);
+    }
+    
+    uint64_t B1 = DEFAULT_B1;
+    uint8_t *is_prime = sieve_bitmap(B1);
+    uint32_t primes[DEFAULT_B1];
+    int num_primes = 0;
+    for (uint64_t i = 2; i <= B1; i++)
+        if (is_prime[i])
+            primes[num_primes++] = (uint32_t)i;
+    
+    EcmJob job;
+    memset(&job, 0, sizeof(job));
+    job.n = n;
+    job.B1 = B1;
+    job.primes = primes;
+    job.num_stage1 = num_primes;
+    atomic_init(&job.factor, 0);
+    
+    for (int k = 16; k <= MAX_BATCH_BENCH; k *= 2)
+    {
+        int reps = (1 << 20) / k;
+        volatile uint64_t sink = 0;
+        uint64_t g;
+        
+        clock_t start = clock();
+        for (int r = 0; r < reps; r++)
+            for (int i = 0; i < k; i++)
+                sink += (uint64_t)mod_inverse((int64_t)from_mont(vals[i], &M), (int64_t)n);
+        double t_single = (double)(clock() - start) / CLOCKS_PER_SEC / ((double)reps * k);
+        
+        start = clock();
+        for (int r = 0; r < reps; r++)
+        {
+            batch_inverse(out, vals, k, scratch, &M, &g);
+            sink += out[r % k];
+        }
+        double t_batch = (double)(clock() - start) / CLOCKS_PER_SEC / ((double)reps * k);
+        
+        // Stage 1 only: XZ ladder per curve vs k affine curves sharing inversions
+        start = clock();
+        for (int i = 0; i < k; i++)
+        {
+            Point P;
+            uint64_t a24;
+            if (curve_from_sigma(6 + i, &P, &a24, &M) == 1)
+                ecm_stage1(&job, &P, a24, &M);
+            sink += P.x;
+        }
+        double t_xz = (double)(clock() - start) / CLOCKS_PER_SEC / k;
+        
+        CurveBatch cb;
+        if (!batch_alloc(&cb, k))
+        {
+            fprintf(stderr, "Error: out of memory for a batch of %d curves\n", k);
+            break;
+        }
+        start = clock();
+        batch_setup(&cb, 6, &M);
+        for (int p_idx = 0; p_idx < num_primes; p_idx++)
+        {
+            uint64_t q = primes[p_idx];
+            while (q <= B1 / primes[p_idx])
+                q *= primes[p_idx];
+            memcpy(cb.bx, cb.x, k * sizeof(uint64_t));
+            memcpy(cb.by, cb.y, k * sizeof(uint64_t));
+            for (int bit = 62 - __builtin_clzll(q); bit >= 0; bit--)
+            {
+                batch_double(&cb, &M);
+                if ((q >> bit) & 1)
+                    batch_add_base(&cb, &M);
+            }
+        }
+        double t_affine = (double)(clock() - start) / CLOCKS_PER_SEC / k;
+        sink += cb.x[0];
+        batch_free(&cb);
+        
+        printf("%-8d %12.1fns %12.1fns %8.1fx %14.1fus %14.1fus\n", k, t_single * 1e9, t_batch * 1e9,
+               t_single / t_batch, t_xz * 1e6, t_affine * 1e6);
+    }
+    free(is_prime);
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2)
+    {
+        printf("Usage: %s <n> [e] [--threads T] [--B1 X] [--curves C] [--batch K] [--sigma S] [--stats FILE]\n", argv[0]);
+        printf("       %s --demo    (run scaling demonstration)\n", argv[0]);
+        printf("       %s --bench-batch    (batch inversion, k = 16..1024)\n", argv[0]);
+        return 1;
+    }
+    
+    if (strcmp(argv[1], "--demo") == 0)
+    {
+        run_demo();
+        return 0;
+    }
+    
+    if (strcmp(argv[1], "--bench-batch") == 0)
+    {
+        run_batch_bench();
+        return 0;
+    }
+    
+    uint64_t n = strtoull(argv[1], NULL, 10);
+    uint64_t e = 3;
+    uint64_t B1 = DEFAULT_B1;
+    uint64_t max_curves = 0;
+    uint64_t sigma0 = random_sigma();
+    int threads = default_threads();
+    int batch = 1;
+    const char *stats_path = DEFAULT_STATS_FILE;
+    
+    for (int i = 2; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+            threads = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--B1") == 0 && i + 1 < argc)
+            B1 = strtoull(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "--curves") == 0 && i + 1 < argc)
+            max_curves = strtoull(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "--batch") == 0 && i + 1 < argc)
+            batch = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--sigma") == 0 && i + 1 < argc)
+            sigma0 = strtoull(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "--stats") == 0 && i + 1 < argc)
+            stats_path = argv[++i];
+        else if (argv[i][0] != '-')
+            e = strtoull(argv[i], NULL, 10);
+    }
+    
+    if (n < 4)
+    {
+        fprintf(stderr, "Error: n must be >= 4\n");
+        return 1;
+    }
+    if (n >> 63)
+    {
+        fprintf(stderr, "Error: n must be < 2^63\n");
+        return 1;
+    }
+    if (is_prime_mr(n))
+    {
+        fprintf(stderr, "Error: n is prime\n");
+        return 1;
+    }
+    if (threads < 1 || threads > MAX_THREADS)
+    {
+        fprintf(stderr, "Error: threads must be between 1 and %d\n", MAX_THREADS);
+        return 1;
+    }
+    if (batch < 1 || batch > MAX_BATCH)
+    {
+        fprintf(stderr, "Error: batch must be between 1 and %d\n", MAX_BATCH);
+        return 1;
+    }
+    if (B1 < 100 || sigma0 < 6)
+    {
+        fprintf(stderr, "Error: need B1 >= 100 and sigma >= 6\n");
+        return 1;
+    }
+    
+    printf("ECM Attack\n");
+    printf("n = %" PRIu64 ", e = %" PRIu64 "\n", n, e);
+    printf("B1 = %" PRIu64 ", B2 = %" PRIu64 ", threads = %d\n\n", B1, B1 * B2_FACTOR, threads);
+    
+    double start = wall_seconds();
+    uint64_t curves;
+    uint64_t p = ecm_factor(n, B1, max_curves, threads, batch, sigma0, &curves);
+    double time_spent = wall_seconds() - start;
+    
+    uint64_t total = record_curves(stats_path, B1, curves);
+    printf("Curves: %" PRIu64 " this run, %" PRIu64 " total at B1=%" PRIu64 " (%s)\n",
+           curves, total, B1, stats_path);
+    print_expected_work(B1, total);
+    
+    if (p == 0)
+    {
+        printf("Failed to factor\n");
+        return 1;
+    }
+    
+    uint64_t q = n / p;
+    uint64_t phi = (p - 1) * (q - 1);
+    
+    printf("Factors: p = %" PRIu64 ", q = %" PRIu64 "\n", p, q);
+    printf("Wall time: %.6fs\n\n", time_spent);
+    
+    if (gcd(e, phi) != 1)
+    {
+        printf("Error: e is not valid for these primes\n");
+        return 1;
+    }
+    
+    int64_t d = mod_inverse(e, phi);
+    
+    printf("phi(n) = %" PRIu64 "\n", phi);
+    printf("Private key d = %" PRId64 "\n\n", d);
+    
+    printf("Public:  (n=%" PRIu64 ", e=%" PRIu64 ")\n", n, e);
+    printf("Private: (n=%" PRIu64 ", d=%" PRId64 ")\n", n, d);
+    
+    return 0;
+}
@@ -0,0 +1,367 @@
+/*
+ * Lehman / Hart One-Line Factoring Attack on RSA
+ * Usage: ./lehman <n> [e] [--method lehman|hart]
+ *        ./lehman --demo
+ *
+ * Both methods look for a^2 - 4kn (Lehman) or s^2 mod n (Hart) being a
+ * perfect square. They shine when p and q are close together, which is
+ * the case for every balanced entry in the run_demo tables.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#define LEHMAN_MAX_BITS 62
+
+uint64_t gcd(uint64_t a, uint64_t b)
+{
+    while (b != 0)
+    {
+        uint64_t temp = b;
+        b = a % b;
+        a = temp;
+    }
+    return a;
+}
+
+int64_t mod_inverse(int64_t e, int64_t phi)
+{
+    int64_t t = 0, newt = 1;
+    int64_t r = phi, newr = e;
+    
+    while (newr != 0)
+    {
+        int64_t quotient = r / newr;
+        int64_t temp_t = t;
+        t = newt;
+        newt = temp_t - quotient * newt;
+        int64_t temp_r = r;
+        r = newr;
+        newr = temp_r - quotient * newr;
+    }
+    
+    if (t < 0)
+        t += phi;
+    return t;
+}
+
+// ============ Square detection ============
+
+// Quadratic-residue tables: x can only be a square if it is a square mod each
+static uint8_t sq_mod64[64], sq_mod63[63], sq_mod65[65], sq_mod11[11];
+
+static void init_square_filters(void)
+{
+    static int done = 0;
+    if (done)
+        return;
+    for (int i = 0; i < 64; i++)
+        sq_mod64[(i * i) % 64] = 1;
+    for (int i = 0; i < 63; i++)
+        sq_mod63[(i * i) % 63] = 1;
+    for (int i = 0; i < 65; i++)
+        sq_mod65[(i * i) % 65] = 1;
+    for (int i = 0; i < 11; i++)
+        sq_mod11[(i * i) % 11] = 1;
+    done = 1;
+}
+
+// floor(sqrt(x)) for 128-bit x
+static uint64_t isqrt_u128(__uint128_t x)
+{
+    uint64_t r = (uint64_t)sqrtl((long double)x);
+    while ((__uint128_t)r * r > x)
+        r--;
+    while ((__uint128_t)(r + 1) * (r + 1) <= x)
+        r++;
+    return r;
+}
+
+// Returns 1 and sets *root if x is a perfect square. The four filters reject
+// all but ~0.4% of non-squares before the square root is taken.
+static int is_square(__uint128_t x, uint64_t *root)
+{
+    if (!sq_mod64[(unsigned)(x & 63)])
+        return 0;
+    uint64_t r = (uint64_t)(x % (63ULL * 65 * 11));
+    if (!sq_mod63[r % 63] || !sq_mod65[r % 65] || !sq_mod11[r % 11])
+        return 0;
+    uint64_t s = isqrt_u128(x);
+    if ((__uint128_t)s * s != x)
+        return 0;
+    *root = s;
+    return 1;
+}
+
+// Trial division by 2 and odd i with i^3 <= n; returns the factor or 0
+static uint64_t trial_cbrt(uint64_t n, uint64_t *iterations)
+{
+    if (n % 2 == 0)
+        return 2;
+    for (uint64_t i = 3; (__uint128_t)i * i * i <= n; i += 2)
+    {
+        (*iterations)++;
+        if (n % i == 0)
+            return i;
+    }
+    return 0;
+}
+
+// ============ Lehman ============
+
+/*
+ * Lehman's method, O(n^1/3)
+ *
+ * For each k <= n^1/3 scan a in [sqrt(4kn), sqrt(4kn) + n^1/6 / (4 sqrt(k))]
+ * for a^2 - 4kn = b^2; then gcd(a + b, n) is a proper factor. Trial division
+ * up to n^1/3 runs last, so close factors are found without paying for it.
+ * Deterministic for n < 2^62.
+ */
+uint64_t lehman(uint64_t n, uint64_t *iterations)
+{
+    *iterations = 0;
+    init_square_filters();
+    
+    if (n % 2 == 0)
+        return 2;
+    
+    uint64_t k_max = (uint64_t)cbrt((double)n) + 1;
+    double sixth = pow((double)n, 1.0 / 6.0);
+    
+    for (uint64_t k = 1; k <= k_max; k++)
+    {
+        __uint128_t four_kn = (__uint128_t)4 * k * n;
+        uint64_t a = isqrt_u128(four_kn);
+        if ((__uint128_t)a * a < four_kn)
+            a++;
+        uint64_t a_max = (uint64_t)(sqrtl((long double)four_kn) + sixth / (4.0 * sqrt((double)k))) + 1;
+        
+        for (; a <= a_max; a++)
+        {
+            (*iterations)++;
+            uint64_t b;
+            if (!is_square((__uint128_t)a * a - four_kn, &b))
+                continue;
+            uint64_t g = gcd(a + b, n);
+            if (g > 1 && g < n)
+                return g;
+        }
+    }
+    // Factors below n^1/3 are the only ones the square search can miss
+    return trial_cbrt(n, iterations);
+}
+
+// ============ Hart's one-line factoring ============
+
+/*
+ * Hart's OLF
+ *
+ * s = ceil(sqrt(n i)), m = s^2 mod n; if m = t^2 then gcd(s - t, n)
+ * splits n. Without Hart's optional 480 multiplier, i = 1 is already
+ * Fermat's first step, so near-square n fall out immediately.
+ * Heuristic O(n^1/3); trial division up to n^1/3 is the fallback.
+ */
+uint64_t hart(uint64_t n, uint64_t *iterations)
+{
+    *iterations = 0;
+    init_square_filters();
+    
+    if (n % 2 == 0)
+        return 2;
+    
+    uint64_t root;
+    if (is_square(n, &root))
+        return root;
+    
+    __uint128_t step = n;
+    uint64_t limit = 4 * ((uint64_t)cbrt((double)n) + 1);
+    __uint128_t ni = 0;
+    
+    for (uint64_t i = 1; i <= limit; i++)
+    {
+        (*iterations)++;
+        ni += step;
+        uint64_t s = isqrt_u128(ni);
+        if ((__uint128_t)s * s < ni)
+            s++;
+        uint64_t m = (uint64_t)(((__uint128_t)s * s) % n);
+        uint64_t t;
+        if (!is_square(m, &t))
+            continue;
+        uint64_t g = gcd((s % n + n - t % n) % n, n);
+        if (g > 1 && g < n)
+            return g;
+    }
+    return trial_cbrt(n, iterations);
+}
+
+// ============ Pollard's Rho (benchmark reference) ============
+
+uint64_t f(uint64_t x, uint64_t n)
+{
+    return ((__uint128_t)x * x + 1) % n;
+}
+
+uint64_t pollards_rho(uint64_t n, uint64_t *iterations)
+{
+    *iterations = 0;
+    
+    if (n % 2 == 0)
+    {
+        *iterations = 1;
+        return 2;
+    }
+    
+    uint64_t x = 2, y = 2, d = 1;
+    
+    while (d == 1)
+    {
+        (*iterations)++;
+        x = f(x, n);
+        y = f(f(y, n), n);
+        
+        uint64_t diff = (x > y) ? x - y : y - x;
+        d = gcd(diff, n);
+        
+        if (*iterations > 10000000)
+            return 0;
+    }
+    
+    return (d != n) ? d : 0;
+}
+
+void run_demo()
+{
+    printf("Lehman / Hart vs Pollard's Rho (balanced semiprimes)\n");
+    printf("====================================================\n\n");
+    printf("%-8s %10s %12s %10s %12s %10s %12s\n", "n bits", "Lehman it", "Lehman", "Hart it", "Hart", "Rho it", "Rho");
+    printf("------------------------------------------------------------------------------\n");
+    
+    // Balanced entries of the run_demo tables (p and q within ~0.1%)
+    uint64_t tests[] = {
+        1106774983ULL,
+        275447306077ULL,
+        4400626126189ULL,
+        70377803883943ULL,
+        1125938964277027ULL,
+        18014546685901351ULL,
+    };
+    int num_tests = sizeof(tests) / sizeof(tests[0]);
+    int reps = 10;
+    
+    uint64_t (*engines[])(uint64_t, uint64_t *) = {lehman, hart, pollards_rho};
+    
+    for (int i = 0; i < num_tests; i++)
+    {
+        printf("%-8d", 64 - __builtin_clzll(tests[i]));
+        for (int e = 0; e < 3; e++)
+        {
+            uint64_t it = 0, p = 0;
+            clock_t start = clock();
+            for (int r = 0; r < reps; r++)
+                p = engines[e](tests[i], &it);
+            double t = (double)(clock() - start) / CLOCKS_PER_SEC / reps;
+            if (p)
+                printf(" %10" PRIu64 " %10.6fs", it, t);
+            else
+                printf(" %10s %10.6fs", "FAILED", t);
+        }
+        printf("\n");
+    }
+    
+    printf("\n");
+    printf("With p ~ q the square search ends within the first few k (or i),\n");
+    printf("long before the O(n^1/3) bound that rho's O(n^1/4) would beat.\n");
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2)
+    {
+        printf("Usage: %s <n> [e] [--method lehman|hart]\n", argv[0]);
+        printf("       %s --demo    (benchmark on balanced semiprimes)\n", argv[0]);
+        return 1;
+    }
+    
+    if (strcmp(argv[1], "--demo") == 0)
+    {
+        run_demo();
+        return 0;
+    }
+    
+    uint64_t n = strtoull(argv[1], NULL, 10);
+    uint64_t e = 3;
+    const char *method = "lehman";
+    
+    for (int i = 2; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--method") == 0 && i + 1 < argc)
+            method = argv[++i];
+        else if (argv[i][0] != '-')
+            e = strtoull(argv[i], NULL, 10);
+    }
+    
+    uint64_t (*engine)(uint64_t, uint64_t *);
+    if (strcmp(method, "lehman") == 0)
+        engine = lehman;
+    else if (strcmp(method, "hart") == 0)
+        engine = hart;
+    else
+    {
+        fprintf(stderr, "Error: unknown method '%s' (use lehman or hart)\n", method);
+        return 1;
+    }
+    
+    if (n < 4)
+    {
+        fprintf(stderr, "Error: n must be >= 4\n");
+        return 1;
+    }
+    if (n >> LEHMAN_MAX_BITS)
+    {
+        fprintf(stderr, "Error: n must be < 2^%d\n", LEHMAN_MAX_BITS);
+        return 1;
+    }
+    
+    printf("%s Attack\n", (engine == lehman) ? "Lehman" : "Hart One-Line");
+    printf("n = %" PRIu64 ", e = %" PRIu64 "\n\n", n, e);
+    
+    clock_t start = clock();
+    uint64_t iterations;
+    uint64_t p = engine(n, &iterations);
+    clock_t end = clock();
+    double time_spent = (double)(end - start) / CLOCKS_PER_SEC;
+    
+    if (p == 0)
+    {
+        printf("Failed to factor\n");
+        return 1;
+    }
+    
+    uint64_t q = n / p;
+    uint64_t phi = (p - 1) * (q - 1);
+    
+    printf("Factors: p = %" PRIu64 ", q = %" PRIu64 "\n", p, q);
+    printf("Iterations: %" PRIu64 ", Time: %.6fs\n\n", iterations, time_spent);
+    
+    if (gcd(e, phi) != 1)
+    {
+        printf("Error: e is not valid for these primes\n");
+        return 1;
+    }
+    
+    int64_t d = mod_inverse(e, phi);
+    
+    printf("phi(n) = %" PRIu64 "\n", phi);
+    printf("Private key d = %" PRId64 "\n\n", d);
+    
+    printf("Public:  (n=%" PRIu64 ", e=%" PRIu64 ")\n", n, e);
+    printf("Private: (n=%" PRIu64 ", d=%" PRId64 ")\n", n, d);
+    
+    return 0;
+}
@@ -1,7 +1,8 @@
 /*
  * Pollard's Rho Attack on RSA
- * Usage: ./pollards_rho <n> [e]
+ * Usage: ./pollards_rho <n> [e] [--fermat BUDGET] [--max-iter N] [--checkpoint FILE] [--resume FILE]
  *        ./pollards_rho --demo
+ *        ./pollards_rho --fermat-stats [keys] [budget]
  */
 
 #include <stdio.h>
@@ -11,6 +12,9 @@
 #include <string.h>
 #include <math.h>
 #include <time.h>
+#include <unistd.h>
+
+#define DEFAULT_FERMAT_BUDGET 100000   // Fermat steps tried before the main attack
 
 uint64_t gcd(uint64_t a, uint64_t b)
 {
@@ -44,21 +48,46 @@ int64_t mod_inverse(int64_t e, int64_t phi)
     return t;
 }
 
-// f(x) = x^2 + 1 mod n
-uint64_t f(uint64_t x, uint64_t n)
+// Square-residue bitmaps: bit r is set iff r is a square mod m
+#define SQ_MOD64 0x0202021202030213ULL
+#define SQ_MOD63 0x0402483012450293ULL
+#define SQ_MOD65_LO 0x218a019866014613ULL   // residues 0..63
+#define SQ_MOD65_HI 0x1ULL                  // residue 64
+#define SQ_MOD11 0x23bULL
+
+// floor(sqrt(x)) for 128-bit x
+static uint64_t isqrt_u128(__uint128_t x)
+{
+    uint64_t r = (uint64_t)sqrtl((long double)x);
+    while ((__uint128_t)r * r > x)
+        r--;
+    while ((__uint128_t)(r + 1) * (r + 1) <= x)
+        r++;
+    return r;
+}
+
+// Cheap rejection of non-squares; passes ~1 in 270 random values
+static int maybe_square(__uint128_t x)
 {
-    return ((__uint128_t)x * x + 1) % n;
+    if (!((SQ_MOD64 >> (unsigned)(x & 63)) & 1))
+        return 0;
+    unsigned r = (unsigned)(x % 45045);   // 63 * 65 * 11
+    if (!((SQ_MOD63 >> (r % 63)) & 1))
+        return 0;
+    unsigned r65 = r % 65;
+    if (!((r65 < 64) ? (SQ_MOD65_LO >> r65) & 1 : SQ_MOD65_HI))
+        return 0;
+    return (SQ_MOD11 >> (r % 11)) & 1;
 }
 
 /*
- * Pollard's Rho Factorization
- * 
- * Uses cycle detection (Floyd's tortoise and hare) to find a factor.
- * Based on the birthday paradox - expects to find a collision in O(n^1/4) steps.
- * 
- * Much faster than trial division for large numbers with similar-sized factors.
+ * Fermat's method with an iteration budget
+ *
+ * Walks a = ceil(sqrt(n)), ceil(sqrt(n)) + 1, ... until a^2 - n = b^2, so
+ * n = (a - b)(a + b). It needs (p + q)/2 - sqrt(n) steps: a handful when p
+ * and q are close. Returns 0 once `budget` steps are spent.
  */
-uint64_t pollards_rho(uint64_t n, uint64_t *iterations)
+uint64_t fermat(uint64_t n, uint64_t budget, uint64_t *iterations)
 {
     *iterations = 0;
     
@@ -68,22 +97,189 @@ uint64_t pollards_rho(uint64_t n, uint64_t *iterations)
         return 2;
     }
     
-    uint64_t x = 2, y = 2, d = 1;
+    uint64_t a = isqrt_u128(n);
+    if ((__uint128_t)a * a < n)
+        a++;
+    __uint128_t r = (__uint128_t)a * a - n;   // a^2 - n, updated incrementally
     
-    while (d == 1)
+    while (*iterations < budget)
     {
         (*iterations)++;
-        x = f(x, n);           // tortoise: one step
-        y = f(f(y, n), n);     // hare: two steps
+        if (maybe_square(r))
+        {
+            uint64_t b = isqrt_u128(r);
+            if ((__uint128_t)b * b == r)
+                return (a - b > 1) ? a - b : 0;
+        }
+        r += 2 * (__uint128_t)a + 1;
+        a++;
+    }
+    return 0;
+}
+
+// ============ Walk state and checkpoints ============
+
+#define GCD_BATCH 128                // |x - y| values multiplied per gcd
+#define CLOCK_CHECK_MASK 0xFFFF      // look at the clock every 65536 steps
+#define CHECKPOINT_MIN_SECONDS 10.0
+#define CHECKPOINT_OVERHEAD 1000.0   // wait >= 1000x the last write: < 0.1% overhead
+#define DEFAULT_MAX_ITERATIONS 10000000
+#define CHECKPOINT_MAGIC "RHO64CK1"
+
+typedef struct {
+    uint64_t n;
+    uint64_t x, y;          // tortoise and hare
+    uint64_t c;             // f(x) = x^2 + c
+    uint64_t iterations;
+    uint64_t q;             // product of |x - y| since the last gcd
+} RhoState;
+
+typedef struct {
+    char magic[8];
+    RhoState state;
+} RhoCheckpoint;
+
+static double wall_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Write to FILE.tmp, fsync, then rename over FILE so a crash never leaves a torn file
+static int save_checkpoint(const char *path, const RhoState *s)
+{
+    char tmp[1024];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    FILE *fp = fopen(tmp, "wb");
+    if (!fp)
+        return 0;
+    
+    RhoCheckpoint ck;
+    memset(&ck, 0, sizeof(ck));
+    memcpy(ck.magic, CHECKPOINT_MAGIC, sizeof(ck.magic));
+    ck.state = *s;
+    int ok = fwrite(&ck, sizeof(ck), 1, fp) == 1 && fflush(fp) == 0 && fsync(fileno(fp)) == 0;
+    ok = (fclose(fp) == 0) && ok;
+    return ok && rename(tmp, path) == 0;
+}
+
+static int load_checkpoint(const char *path, RhoState *s)
+{
+    FILE *fp = fopen(path, "rb");
+    if (!fp)
+        return 0;
+    RhoCheckpoint ck;
+    int ok = fread(&ck, sizeof(ck), 1, fp) == 1 &&
+             memcmp(ck.magic, CHECKPOINT_MAGIC, sizeof(ck.magic)) == 0;
+    fclose(fp);
+    if (ok)
+        *s = ck.state;
+    return ok;
+}
+
+static void rho_init(RhoState *s, uint64_t n)
+{
+    s->n = n;
+    s->x = 2;
+    s->y = 2;
+    s->c = 1;
+    s->iterations = 0;
+    s->q = 1;
+}
+
+static inline uint64_t rho_step(uint64_t x, uint64_t c, uint64_t n)
+{
+    return ((__uint128_t)x * x + c) % n;
+}
+
+/*
+ * Pollard's Rho Factorization
+ * 
+ * Uses cycle detection (Floyd's tortoise and hare) to find a factor.
+ * Based on the birthday paradox - expects to find a collision in O(n^1/4) steps.
+ * 
+ * Much faster than trial division for large numbers with similar-sized factors.
+ * 
+ * The |x - y| values are multiplied together and gcd'd once per GCD_BATCH
+ * steps; if a batch overshoots to gcd = n it is replayed one step at a time.
+ * With checkpoint_path set, the state is saved at batch boundaries no more
+ * often than every CHECKPOINT_MIN_SECONDS (or 1000x the last write time).
+ * max_iterations = 0 means no limit.
+ *
+ * Returns a proper factor, n if the cycle closed without a split (the
+ * walk with this c is spent), or 0 if max_iterations ran out.
+ */
+uint64_t rho_walk(RhoState *s, uint64_t max_iterations, const char *checkpoint_path)
+{
+    uint64_t n = s->n;
+    double next_checkpoint = wall_seconds() + CHECKPOINT_MIN_SECONDS;
+    uint64_t looked = s->iterations;   // iterations at the last look at the clock
+    
+    while (max_iterations == 0 || s->iterations < max_iterations)
+    {
+        uint64_t x0 = s->x, y0 = s->y, it0 = s->iterations;
         
-        uint64_t diff = (x > y) ? x - y : y - x;
-        d = gcd(diff, n);
+        for (int i = 0; i < GCD_BATCH; i++)
+        {
+            s->x = rho_step(s->x, s->c, n);                        // tortoise: one step
+            s->y = rho_step(rho_step(s->y, s->c, n), s->c, n);     // hare: two steps
+            uint64_t diff = (s->x > s->y) ? s->x - s->y : s->y - s->x;
+            s->q = ((__uint128_t)s->q * diff) % n;
+        }
+        s->iterations += GCD_BATCH;
         
-        // Prevent infinite loop
-        if (*iterations > 10000000)
-            return 0;
+        uint64_t d = gcd(s->q, n);
+        if (d == 1)
+        {
+            s->q = 1;
+            if (checkpoint_path && s->iterations - looked > CLOCK_CHECK_MASK)
+            {
+                looked = s->iterations;
+                if (wall_seconds() >= next_checkpoint)
+                {
+                    double start = wall_seconds();
+                    if (!save_checkpoint(checkpoint_path, s))
+                        fprintf(stderr, "Warning: could not write checkpoint %s\n", checkpoint_path);
+                    double cost = wall_seconds() - start;
+                    double wait = cost * CHECKPOINT_OVERHEAD;
+                    next_checkpoint = wall_seconds() + ((wait > CHECKPOINT_MIN_SECONDS) ? wait : CHECKPOINT_MIN_SECONDS);
+                }
+            }
+            continue;
+        }
+        
+        // Replay the batch with a gcd per step to find the first collision
+        s->x = x0;
+        s->y = y0;
+        s->iterations = it0;
+        do
+        {
+            s->iterations++;
+            s->x = rho_step(s->x, s->c, n);
+            s->y = rho_step(rho_step(s->y, s->c, n), s->c, n);
+            uint64_t diff = (s->x > s->y) ? s->x - s->y : s->y - s->x;
+            d = gcd(diff, n);
+        } while (d == 1);
+        return d;
+    }
+    return 0;
+}
+
+uint64_t pollards_rho(uint64_t n, uint64_t *iterations)
+{
+    *iterations = 0;
+    
+    if (n % 2 == 0)
+    {
+        *iterations = 1;
+        return 2;
     }
     
+    RhoState s;
+    rho_init(&s, n);
+    uint64_t d = rho_walk(&s, DEFAULT_MAX_ITERATIONS, NULL);
+    *iterations = s.iterations;
     return (d != n) ? d : 0;
 }
 
@@ -151,12 +347,86 @@ void run_demo()
     printf("\nUniverse age: ~13.8 billion years\n");
 }
 
+// rsa_interactive.c's key generation, reproduced bit for bit
+static int setprimes_ifprime(uint16_t n)
+{
+    for (uint16_t i = 2; i <= n / 2; i++)
+    {
+        if (n % i == 0)
+            return 0;
+    }
+    return 1;
+}
+
+static uint16_t setprimes_getprime(void)
+{
+    uint16_t n;
+    do
+    {
+        n = rand() % 65535 + 5;
+    } while (!setprimes_ifprime(n));
+    return n;
+}
+
+/*
+ * How often the bounded Fermat stage alone breaks keys from setprimes():
+ * p and q are random 16-bit primes with gcd(3, phi) = 1.
+ */
+void run_fermat_stats(int trials, uint64_t budget)
+{
+    const uint64_t buckets[] = {1, 10, 100, 1000, 10000, 100000};
+    int num_buckets = sizeof(buckets) / sizeof(buckets[0]);
+    int within[sizeof(buckets) / sizeof(buckets[0])] = {0};
+    int solved = 0, valid = 0;
+    uint64_t worst = 0;
+    
+    srand(1);
+    for (int t = 0; t < trials; t++)
+    {
+        uint16_t p, q;
+        uint32_t n, phi;
+        do
+        {
+            p = setprimes_getprime();
+            do
+                q = setprimes_getprime();
+            while (p == q);
+            n = (uint32_t)p * q;
+            phi = n - p - q + 1;
+        } while (gcd(3, phi) != 1);
+        
+        if (p < 5 || q < 5)
+            continue;   // setprimes' uint16 wrap-around can emit 0..3
+        valid++;
+        
+        uint64_t iterations;
+        uint64_t f = fermat(n, budget, &iterations);
+        if (f == 0)
+            continue;
+        solved++;
+        if (iterations > worst)
+            worst = iterations;
+        for (int b = 0; b < num_buckets; b++)
+            if (iterations <= buckets[b])
+                within[b]++;
+    }
+    
+    printf("Fermat on setprimes() keys (%d keys, budget %" PRIu64 ")\n", valid, budget);
+    printf("==============================================\n\n");
+    for (int b = 0; b < num_buckets; b++)
+        printf("  <= %6" PRIu64 " iterations: %6.2f%%\n", buckets[b], 100.0 * within[b] / valid);
+    printf("\nSolved: %d/%d (%.2f%%), worst case %" PRIu64 " iterations\n",
+           solved, valid, 100.0 * solved / valid, worst);
+}
+
 int main(int argc, char *argv[])
 {
     if (argc < 2)
     {
-        printf("Usage: %s <n> [e]\n", argv[0]);
+        printf("Usage: %s <n> [e] [--fermat BUDGET] [--max-iter N] [--checkpoint FILE] [--resume FILE]\n", argv[0]);
+        printf("       (BUDGET 0 disables the Fermat stage, N 0 removes the iteration cap)\n");
         printf("       %s --demo    (run scaling demonstration)\n", argv[0]);
+        printf("       %s --fermat-stats [keys] [budget]    (Fermat vs rsa_interactive keys)\n", argv[0]);
         return 1;
     }
     
@@ -166,8 +436,34 @@ int main(int argc, char *argv[])
         return 0;
     }
     
+    if (strcmp(argv[1], "--fermat-stats") == 0)
+    {
+        int trials = (argc >= 3) ? atoi(argv[2]) : 10000;
+        uint64_t budget = (argc >= 4) ? strtoull(argv[3], NULL, 10) : DEFAULT_FERMAT_BUDGET;
+        run_fermat_stats(trials > 0 ? trials : 1, budget);
+        return 0;
+    }
+    
     uint64_t n = strtoull(argv[1], NULL, 10);
-    uint64_t e = (argc >= 3) ? strtoull(argv[2], NULL, 10) : 3;
+    uint64_t e = 3;
+    uint64_t fermat_budget = DEFAULT_FERMAT_BUDGET;
+    uint64_t max_iterations = DEFAULT_MAX_ITERATIONS;
+    const char *checkpoint_path = NULL;
+    const char *resume_path = NULL;
+    
+    for (int i = 2; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--fermat") == 0 && i + 1 < argc)
+            fermat_budget = strtoull(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "--max-iter") == 0 && i + 1 < argc)
+            max_iterations = strtoull(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "--checkpoint") == 0 && i + 1 < argc)
+            checkpoint_path = argv[++i];
+        else if (strcmp(argv[i], "--resume") == 0 && i + 1 < argc)
+            resume_path = argv[++i];
+        else if (argv[i][0] != '-')
+            e = strtoull(argv[i], NULL, 10);
+    }
     
     if (n < 4)
     {
@@ -175,12 +471,57 @@ int main(int argc, char *argv[])
         return 1;
     }
     
+    RhoState state;
+    rho_init(&state, n);
+    if (resume_path)
+    {
+        if (!load_checkpoint(resume_path, &state))
+        {
+            fprintf(stderr, "Error: %s is not a valid checkpoint\n", resume_path);
+            return 1;
+        }
+        if (state.n != n)
+        {
+            fprintf(stderr, "Error: checkpoint is for n = %" PRIu64 "\n", state.n);
+            return 1;
+        }
+        if (!checkpoint_path)
+            checkpoint_path = resume_path;
+    }
+    
     printf("Pollard's Rho Attack\n");
     printf("n = %" PRIu64 ", e = %" PRIu64 "\n\n", n, e);
     
     clock_t start = clock();
-    uint64_t iterations;
-    uint64_t p = pollards_rho(n, &iterations);
+    uint64_t iterations = 0;
+    uint64_t p = 0;
+    if (resume_path)
+        printf("Resuming from %s at iteration %" PRIu64 "\n", resume_path, state.iterations);
+    else
+    {
+        p = fermat(n, fermat_budget, &iterations);
+        if (p)
+            printf("Fermat fast path: solved in %" PRIu64 " iterations\n", iterations);
+        else if (fermat_budget)
+            printf("Fermat fast path: no factor in %" PRIu64 " iterations\n", fermat_budget);
+    }
+    if (!p && n % 2 == 0)
+        p = 2;
+    if (!p)
+    {
+        p = rho_walk(&state, max_iterations, checkpoint_path);
+        iterations = state.iterations;
+        // Only a walk stopped by --max-iter can go on: a closed cycle would close again on resume
+        if (checkpoint_path && p)
+            remove(checkpoint_path);   // factor found or cycle closed: nothing left to resume
+        else if (checkpoint_path && !save_checkpoint(checkpoint_path, &state))
+            fprintf(stderr, "Warning: could not write checkpoint %s\n", checkpoint_path);
+        if (p == n)
+        {
+            printf("Rho cycle closed without a split after %" PRIu64 " iterations\n", iterations);
+            p = 0;
+        }
+    }
     clock_t end = clock();
     double time_spent = (double)(end - start) / CLOCKS_PER_SEC;
     
@@ -73,7 +73,7 @@ void setprimes(uint16_t e, uint16_t *p, uint16_t *q, uint32_t *n, uint32_t *phi)
 			*q = getprime();
 		while(*p == *q);
 		
-		*n = *p * *q;
+		*n = (uint32_t)*p * *q;
 		*phi = *n - *p - *q + 1;
 	} while (gcd(e, *phi) != 1);
 }
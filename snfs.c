@@ -1,11 +1,29 @@
 /*
  * Toy Special Number Field Sieve (SNFS) factorization
  * Usage:
- *   ./snfs <n> [e] [degree] [B] [K]
+ *   ./snfs <n> [e] [degree] [B] [K] [--checkpoint FILE] [--resume FILE]
+ *          [--special-q Q0 Q1] [--relations FILE] [--lp-bound L] [--cofactor-bits M]
+ *          [--threads T]
  *   ./snfs --demo
+ *   ./snfs --bench-mulmod
+ *   ./snfs --bench-hints
+ *   ./snfs --bench-sieve
+ *   ./snfs --bench-lattice
+ *   ./snfs --bench-bucket
+ *   ./snfs --bench-poly
+ *   ./snfs --bench-lp
+ *   ./snfs --bench-cofactor
+ *   ./snfs --bench-resieve
+ *   ./snfs --bench-filter
+ *   ./snfs --bench-lanczos
+ *   ./snfs --bench-merge
+ *   ./snfs --bench-m4ri
+ *   ./snfs --bench-threads
  *
- * Focus: educational, small semiprimes with special form n ~= m^degree + 1.
- * Defaults: degree=8, B=200 (factor base bound), K=5000 (search bound for k in 1-D sieve).
+ * Focus: educational, small semiprimes of special form n = a b^k +- c.
+ * Defaults: degree=0 (polynomial selection picks f = c_d x^d + c_0 and g = x - m over
+ * degrees 4..8), B=200 (factor base bound), K=5000 (sieve area: coprime (a, b) with
+ * a in [-A, A), 1 <= b <= A, 2 A^2 ~= K).
  */
 
 #include <stdio.h>
@@ -15,6 +33,14 @@
 #include <string.h>
 #include <math.h>
 #include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
 
 typedef unsigned __int128 u128;
 typedef __int128 i128;
@@ -32,41 +58,6 @@ u128 gcd_u128(u128 a, u128 b)
     return a;
 }
 
-// Prevent overflow by using double-and-add
-u128 mul_mod(u128 a, u128 b, u128 mod)
-{
-    u128 res = 0;
-    a %= mod;
-    while (b)
-    {
-        if (b & 1)
-        {
-            res += a;
-            if (res >= mod)
-                res -= mod;
-        }
-        a <<= 1;
-        if (a >= mod)
-            a -= mod;
-        b >>= 1;
-    }
-    return res % mod;
-}
-
-u128 pow_mod(u128 base, u128 exp, u128 mod)
-{
-    u128 result = 1;
-    base %= mod;
-    while (exp)
-    {
-        if (exp & 1)
-            result = mul_mod(result, base, mod);
-        base = mul_mod(base, base, mod);
-        exp >>= 1;
-    }
-    return result;
-}
-
 u128 pow_u128(u128 base, int exp)
 {
     u128 res = 1;
@@ -128,6 +119,14 @@ u128 mod_inverse_u128(u128 e, u128 phi)
     return (u128)t;
 }
 
+static int bit_length_u128(u128 x)
+{
+    uint64_t hi = (uint64_t)(x >> 64);
+    if (hi)
+        return 128 - __builtin_clzll(hi);
+    return x ? 64 - __builtin_clzll((uint64_t)x) : 0;
+}
+
 // Integer d-th root: largest x with x^d <= n
 u128 int_root(u128 n, int d)
 {
@@ -149,356 +148,6920 @@ u128 int_root(u128 n, int d)
     return ans;
 }
 
-// ============ Prime generation ============
+// ============ Special forms ============
+
+#define SF_MAX_C 65536   // |c| bound for n = m^d +- c to count as special
 
-#define MAX_FB 6000   // max primes in factor base (primes <= ~60000)
-#define LP_BOUND 100000000
+typedef struct {
+    u128 m;
+    int d;
+    int sign;        // +1: n = m^d + c, -1: n = m^d - c
+    uint64_t c;
+} SpecialForm;
 
-int generate_primes(int limit, uint32_t primes[MAX_FB])
+// m^d, or 0 if it does not fit in 128 bits
+static u128 pow_u128_checked(u128 m, int d)
 {
-    int count = 0;
-    char *is_prime = calloc(limit + 1, 1);
-    if (!is_prime)
-        return 0;
-    for (int i = 2; i <= limit; i++)
-        is_prime[i] = 1;
-    for (int p = 2; p * p <= limit; p++)
-    {
-        if (is_prime[p])
-        {
-            for (int j = p * p; j <= limit; j += p)
-                is_prime[j] = 0;
-        }
-    }
-    for (int i = 2; i <= limit && count < MAX_FB; i++)
+    u128 r = 1;
+    for (int i = 0; i < d; i++)
     {
-        if (is_prime[i])
-            primes[count++] = (uint32_t)i;
+        if (m && r > ~(u128)0 / m)
+            return 0;
+        r *= m;
     }
-    free(is_prime);
-    return count;
+    return r;
 }
 
-// ============ Relation / matrix handling ============
-
-#define MAX_REL 12000
-#define MAX_EXP 8   // exponent counters stored in uint8_t
-
-typedef struct {
-    int a_offset;                // k such that a = m + k
-    uint8_t r_exp[MAX_FB];       // exponents on rational side
-    uint8_t a_exp[MAX_FB];       // exponents on algebraic side
-} Relation;
-
-static Relation relations[MAX_REL];
-static int relation_count = 0;
-
-// Bit matrix helpers
-static uint64_t row_bits[MAX_REL][(2 * MAX_FB + 63) / 64];
-static uint64_t combo_bits[MAX_REL][(MAX_REL + 63) / 64];
-static int pivot_col[MAX_REL];
-static int matrix_rows = 0;
-
-static int first_set_bit(uint64_t *row, int words)
+/*
+ * Look for n = m^d +- c with d >= 3, m >= 2 and 1 <= c <= SF_MAX_C. The
+ * largest d wins, so 2^k +- c is reported with m = 2 and 614^8 + 1 as
+ * 614^8 rather than 376996^4.
+ */
+static int detect_special_form(u128 n, SpecialForm *sf)
 {
-    for (int w = 0; w < words; w++)
+    for (int d = 127; d >= 3; d--)
     {
-        if (row[w])
+        u128 m = (u128)powl((long double)n, 1.0L / d);
+        if (m < 1)
+            m = 1;
+        // powl is only a guess: step m so that m^d <= n < (m + 1)^d
+        while (m > 1 && (pow_u128_checked(m, d) == 0 || pow_u128_checked(m, d) > n))
+            m--;
+        while (pow_u128_checked(m + 1, d) != 0 && pow_u128_checked(m + 1, d) <= n)
+            m++;
+        u128 lo = pow_u128_checked(m, d);
+        u128 hi = pow_u128_checked(m + 1, d);
+        if (lo == 0 || lo > n)
+            continue;
+        if (m >= 2 && n - lo >= 1 && n - lo <= SF_MAX_C)
         {
-            int offset = __builtin_ctzll(row[w]);
-            return w * 64 + offset;
+            *sf = (SpecialForm){m, d, +1, (uint64_t)(n - lo)};
+            return 1;
+        }
+        if (hi != 0 && hi - n >= 1 && hi - n <= SF_MAX_C)
+        {
+            *sf = (SpecialForm){m + 1, d, -1, (uint64_t)(hi - n)};
+            return 1;
         }
     }
-    return -1;
-}
-
-static void xor_rows(uint64_t *dst, uint64_t *src, int words)
-{
-    for (int i = 0; i < words; i++)
-        dst[i] ^= src[i];
-}
-
-static int row_is_zero(uint64_t *row, int words)
-{
-    for (int i = 0; i < words; i++)
-        if (row[i])
-            return 0;
-    return 1;
+    return 0;
 }
 
-// Attempt to insert row; if dependent, returns 1 and fills dependency mask
-static int insert_row(uint64_t *row, uint64_t *combo, int col_words, int combo_words, uint64_t *out_dep)
+// 2^k +- c with the same bounds; cheap enough to run per modulus
+static int detect_pow2_form(u128 n, int *k, uint64_t *c, int *sign)
 {
-    for (int r = 0; r < matrix_rows; r++)
+    int bits = bit_length_u128(n);
+    if (bits < 4 || bits > 127)
+        return 0;
+    u128 below = (u128)1 << (bits - 1), above = (u128)1 << bits;
+    if (n - below >= 1 && n - below <= SF_MAX_C)
     {
-        int pc = pivot_col[r];
-        int word = pc / 64;
-        int bit = pc % 64;
-        if (row[word] & ((uint64_t)1 << bit))
-        {
-            xor_rows(row, row_bits[r], col_words);
-            xor_rows(combo, combo_bits[r], combo_words);
-        }
+        *k = bits - 1;
+        *c = (uint64_t)(n - below);
+        *sign = +1;
+        return 1;
     }
-    if (row_is_zero(row, col_words))
+    if (above - n <= SF_MAX_C)
     {
-        memcpy(out_dep, combo, combo_words * sizeof(uint64_t));
-        return 1; // dependency found
+        *k = bits;
+        *c = (uint64_t)(above - n);
+        *sign = -1;
+        return 1;
     }
-    int pc = first_set_bit(row, col_words);
-    if (pc < 0)
-        return 0;
-    memcpy(row_bits[matrix_rows], row, col_words * sizeof(uint64_t));
-    memcpy(combo_bits[matrix_rows], combo, combo_words * sizeof(uint64_t));
-    pivot_col[matrix_rows] = pc;
-    matrix_rows++;
     return 0;
 }
 
-// ============ SNFS core ============
+static void print_special_form(const SpecialForm *sf)
+{
+    print_u128(sf->m);
+    printf("^%d %c %" PRIu64, sf->d, (sf->sign > 0) ? '+' : '-', sf->c);
+}
 
-// Factor a value using the factor base; fill exp counters; return 1 if fully smooth
-static int is_prime_u64(uint64_t x)
+#define SF_MAX_BASE 1000   // bases b tried for n = a b^k + c
+#define SF_MAX_A 1000
+
+typedef struct {
+    uint64_t a;
+    u128 b;
+    int k;
+    int64_t c;       // signed: n = a b^k + c
+} PowerForm;
+
+static int is_perfect_power(uint64_t b)
 {
-    if (x < 2) return 0;
-    if (x % 2 == 0) return x == 2;
-    for (uint64_t i = 3; i * i <= x; i += 2)
+    for (int e = 2; ((uint64_t)1 << e) <= b; e++)
     {
-        if (x % i == 0)
-            return 0;
+        uint64_t r = (uint64_t)llround(pow((double)b, 1.0 / e));
+        for (uint64_t x = (r > 1) ? r - 1 : 1; x <= r + 1; x++)
+        {
+            if (pow_u128_checked(x, e) == b)
+                return 1;
+        }
     }
-    return 1;
+    return 0;
 }
 
-static int factor_with_fb(u128 value, uint32_t *primes, int *fb_size, uint8_t *exp_out)
+// Small n match many forms by chance; keep the max with the smallest a |c|
+static void power_form_keep(PowerForm *out, int *count, int max, const PowerForm *pf)
 {
-    for (int i = 0; i < *fb_size; i++)
+    double weight = (double)pf->a * fabs((double)pf->c);
+    if (*count < max)
     {
-        uint32_t p = primes[i];
-        while ((value % p) == 0)
-        {
-            value /= p;
-            if (exp_out[i] < 250)
-                exp_out[i]++; // keep small
-        }
+        out[(*count)++] = *pf;
+        return;
     }
-    if (value == 1)
-        return 1;
-    
-    // Large-prime variant (single extra prime <= LP_BOUND)
-    if (value <= LP_BOUND && *fb_size < MAX_FB && is_prime_u64((uint64_t)value))
+    int worst = 0;
+    for (int i = 1; i < max; i++)
     {
-        primes[*fb_size] = (uint32_t)value;
-        exp_out[*fb_size] = 1;
-        (*fb_size)++;
-        return 1;
+        if ((double)out[i].a * fabs((double)out[i].c) > (double)out[worst].a * fabs((double)out[worst].c))
+            worst = i;
     }
-    return 0;
+    if (weight < (double)out[worst].a * fabs((double)out[worst].c))
+        out[worst] = *pf;
 }
 
-// Build dependency -> compute square congruence
-static u128 attempt_dependency(uint64_t *dep_mask, int dep_words, uint32_t *primes, int fb_size, u128 n)
+/*
+ * Forms n = a b^k + c with a <= SF_MAX_A, 1 <= |c| <= SF_MAX_C and b up to
+ * SF_MAX_BASE (perfect powers left to their root), plus the m^d +- c of
+ * detect_special_form, whose m may be larger. For each b only the largest
+ * k is kept: 13 * 13^7 + 1 is 13^8 + 1. Returns how many went to out[].
+ */
+static int detect_power_forms(u128 n, PowerForm *out, int max)
 {
-    uint32_t total_r[MAX_FB] = {0};
-    uint32_t total_a[MAX_FB] = {0};
-    
-    for (int i = 0; i < relation_count; i++)
+    int count = 0;
+    for (uint64_t b = 2; b <= SF_MAX_BASE; b++)
     {
-        int word = i / 64;
-        int bit = i % 64;
-        if (!(dep_mask[word] & ((uint64_t)1 << bit)))
+        if (is_perfect_power(b))
             continue;
-        for (int j = 0; j < fb_size; j++)
-        {
-            total_r[j] += relations[i].r_exp[j];
-            total_a[j] += relations[i].a_exp[j];
-        }
-    }
-    
-    u128 x = 1;
-    u128 y = 1;
-    for (int j = 0; j < fb_size; j++)
-    {
-        if (total_r[j])
+        PowerForm best = {0, 0, 0, 0};
+        u128 bk = b;
+        for (int k = 1; bk <= n / b; k++)
         {
-            u128 exp = total_r[j] / 2;
-            x = mul_mod(x, pow_mod(primes[j], exp, n), n);
+            bk *= b;
+            u128 a = n / bk;
+            for (u128 ac = a; ac <= a + 1; ac++)
+            {
+                u128 prod = ac * bk;
+                u128 diff = (prod > n) ? prod - n : n - prod;
+                if (ac >= 1 && ac <= SF_MAX_A && diff >= 1 && diff <= SF_MAX_C)
+                    best = (PowerForm){(uint64_t)ac, b, k + 1, (prod > n) ? -(int64_t)diff : (int64_t)diff};
+            }
         }
-        if (total_a[j])
+        while (best.a && best.a % b == 0)
         {
-            u128 exp = total_a[j] / 2;
-            y = mul_mod(y, pow_mod(primes[j], exp, n), n);
+            best.a /= b;
+            best.k++;
         }
+        if (best.a)
+            power_form_keep(out, &count, max, &best);
     }
-    
-    u128 diff = (x > y) ? (x - y) : (y - x);
-    u128 g = gcd_u128(diff, n);
-    if (g > 1 && g < n)
-        return g;
-    
-    u128 sum = x + y;
-    if (sum >= n)
-        sum -= n;
-    g = gcd_u128(sum, n);
-    if (g > 1 && g < n)
-        return g;
-    
-    return 0;
+    SpecialForm sf;
+    if (detect_special_form(n, &sf) && sf.m > SF_MAX_BASE)
+    {
+        PowerForm pf = {1, sf.m, sf.d, sf.sign * (int64_t)sf.c};
+        power_form_keep(out, &count, max, &pf);
+    }
+    return count;
 }
 
-static uint64_t gcd_u64(uint64_t a, uint64_t b)
+// ============ Modular arithmetic ============
+
+/*
+ * mul_mod and pow_mod dispatch on the modulus:
+ *   odd n < 2^127         Montgomery (two-limb CIOS, R = 2^128)
+ *   even n = 2^k +- c     fold: x = H 2^k + L == L -+ c H (mod n)
+ *   other even n < 2^126  Barrett with mu = floor(4^k / n), k = bits(n)
+ *   otherwise             double-and-add (mul_mod_slow)
+ * The fold also works for odd 2^k +- c, but on x86-64 the CIOS product is
+ * still ~1.6x faster in the rho walk, so it only stands in for Barrett (see
+ * --bench-mulmod). The context for the last modulus seen is cached, so
+ * callers keep the plain (a, b, mod) signatures.
+ */
+
+#define MONT_MAX_BITS 127      // keeps 2n < 2^128 in the CIOS result
+#define BARRETT_MAX_BITS 126   // keeps mu and x >> (k - 1) under 2^127
+#define FOLD_MIN_BITS 64       // two folds then suffice for c <= SF_MAX_C
+
+enum { MOD_AUTO = -1, MOD_SLOW, MOD_MONT, MOD_BARRETT, MOD_FOLD };
+
+typedef struct {
+    u128 n;
+    int kind;
+    uint64_t ninv;     // Montgomery: -n^-1 mod 2^64
+    u128 r2;           // Montgomery: R^2 mod n
+    u128 mu;           // Barrett: floor(2^(2k) / n)
+    int k;             // Barrett: bit length of n; fold: n = 2^k +- c
+    uint64_t c;        // fold
+    int sign;          // fold: +1 for 2^k + c, -1 for 2^k - c
+    u128 mask;         // fold: 2^k - 1
+} ModCtx;
+
+static int mulmod_engine = MOD_AUTO;   // --bench-mulmod forces one, see set_mulmod_engine
+
+// Reference implementation: double-and-add. The adds compare against
+// mod - a instead of overflowing, so any mod up to 2^128 - 1 works.
+u128 mul_mod_slow(u128 a, u128 b, u128 mod)
 {
-    while (b != 0)
+    u128 res = 0;
+    a %= mod;
+    while (b)
     {
-        uint64_t t = b;
-        b = a % b;
-        a = t;
+        if (b & 1)
+            res = (res >= mod - a) ? res - (mod - a) : res + a;
+        a = (a >= mod - a) ? a - (mod - a) : a + a;
+        b >>= 1;
     }
-    return a;
+    return res;
 }
 
-// ============ Fallback: simple Pollard rho for u128 (educational only) ============
-static u128 rho_func(u128 x, u128 c, u128 n)
+// Full 256-bit product (hi, lo) of two 128-bit values
+static inline void mul_128x128(u128 a, u128 b, u128 *hi, u128 *lo)
 {
-    return (mul_mod(x, x, n) + c) % n;
+    uint64_t a0 = (uint64_t)a, a1 = (uint64_t)(a >> 64);
+    uint64_t b0 = (uint64_t)b, b1 = (uint64_t)(b >> 64);
+    u128 p00 = (u128)a0 * b0;
+    u128 p01 = (u128)a0 * b1;
+    u128 p10 = (u128)a1 * b0;
+    u128 p11 = (u128)a1 * b1;
+    u128 mid = (p00 >> 64) + (uint64_t)p01 + (uint64_t)p10;
+    *lo = (mid << 64) | (uint64_t)p00;
+    *hi = p11 + (p01 >> 64) + (p10 >> 64) + (mid >> 64);
 }
 
-static u128 pollard_rho_u128(u128 n)
+static void mod_ctx_init(ModCtx *M, u128 n)
 {
-    if ((n & 1) == 0)
-        return 2;
-    u128 c = 1;
-    for (int attempt = 0; attempt < 5; attempt++, c += 2)
+    memset(M, 0, sizeof(*M));
+    M->n = n;
+    M->kind = MOD_SLOW;
+    int bits = bit_length_u128(n);
+    if (mulmod_engine == MOD_SLOW || n < 3)
+        return;
+    
+    int fold_k, fold_sign;
+    uint64_t fold_c;
+    int fold_ok = detect_pow2_form(n, &fold_k, &fold_c, &fold_sign) && fold_k >= FOLD_MIN_BITS;
+    int mont_ok = (n & 1) && bits <= MONT_MAX_BITS;
+    
+    if (fold_ok && (mulmod_engine == MOD_FOLD || (!mont_ok && mulmod_engine == MOD_AUTO)))
     {
-        u128 x = 2, y = 2, d = 1;
-        for (int i = 0; i < 200000; i++)
-        {
-            x = rho_func(x, c, n);
-            y = rho_func(rho_func(y, c, n), c, n);
-            u128 diff = (x > y) ? (x - y) : (y - x);
-            d = gcd_u128(diff, n);
-            if (d > 1 && d < n)
-                return d;
-        }
+        M->k = fold_k;
+        M->c = fold_c;
+        M->sign = fold_sign;
+        M->mask = ((u128)1 << fold_k) - 1;
+        M->kind = MOD_FOLD;
     }
-    return 0;
-}
-
-u128 snfs_factor(u128 n, int degree, int fb_bound, int window)
-{
-    uint32_t primes[MAX_FB];
-    int fb_size = generate_primes(fb_bound, primes);
-    if (fb_size == 0)
+    else if (mont_ok && mulmod_engine != MOD_BARRETT)
     {
-        fprintf(stderr, "Error: factor base generation failed\n");
-        return 0;
+        // Newton iteration doubles the correct low bits: 1 -> 2 -> ... -> 64
+        uint64_t n0 = (uint64_t)n, inv = n0;
+        for (int i = 0; i < 5; i++)
+            inv *= 2 - n0 * inv;
+        M->ninv = -inv;
+        u128 r = (0 - n) % n;                  // 2^128 mod n
+        M->r2 = mul_mod_slow(r, r, n);         // once per modulus
+        M->kind = MOD_MONT;
     }
-    
-    relation_count = 0;
-    matrix_rows = 0;
-    int col_words = (fb_size + 63) / 64; // only algebraic side counted in parity
-    int combo_words = (MAX_REL + 63) / 64;
-    
-    u128 m = int_root(n > 1 ? n - 1 : n, degree); // approximate
-    
-    uint64_t dep_mask[(MAX_REL + 63) / 64];
-    int target_rel = fb_size + 16; // small overshoot to force a dependency sooner
-    
-    for (int k = 1; k <= window; k++)
+    else if (bits <= BARRETT_MAX_BITS)
     {
-        if (relation_count >= MAX_REL || relation_count >= target_rel)
-            break;
-        
-        u128 a = m + (u128)k;
-        u128 algebraic = pow_u128(a, degree) + 1; // f(a) = a^d + 1
-        
-        Relation rel;
-        memset(&rel, 0, sizeof(rel));
-        rel.a_offset = k;
-        
-        // Rational side fixed to 1 (all exponents 0)
-        memset(rel.r_exp, 0, sizeof(rel.r_exp));
-        if (!factor_with_fb(algebraic, primes, &fb_size, rel.a_exp))
-            continue;
-        
-        // Build row parity bits: algebraic columns [0, fb_size)
-        uint64_t row[col_words];
-        memset(row, 0, sizeof(row));
-        for (int i = 0; i < fb_size; i++)
+        // mu = floor(2^(2k) / n) by shift-and-subtract long division
+        M->k = bits;
+        u128 rem = 0, q = 0;
+        for (int i = 2 * bits; i >= 0; i--)
         {
-            if (rel.a_exp[i] % 2 == 1)
+            rem = (rem << 1) | (i == 2 * bits);
+            q <<= 1;
+            if (rem >= n)
             {
-                row[i / 64] |= (uint64_t)1 << (i % 64);
+                rem -= n;
+                q |= 1;
             }
         }
-        
-        // Save relation
-        relations[relation_count] = rel;
-        
-        // Build combo bits (identity row)
-        uint64_t combo[combo_words];
-        memset(combo, 0, sizeof(combo));
-        combo[relation_count / 64] |= (uint64_t)1 << (relation_count % 64);
-        
-        if (insert_row(row, combo, col_words, combo_words, dep_mask))
-        {
-            u128 factor = attempt_dependency(dep_mask, combo_words, primes, fb_size, n);
-            if (factor > 1 && factor < n)
-                return factor;
-        }
-        relation_count++;
+        M->mu = q;
+        M->kind = MOD_BARRETT;
     }
+}
+
+/*
+ * Montgomery product a * b * 2^-128 mod n (CIOS over two 64-bit limbs).
+ * Inputs are in [0, n); the output is too.
+ */
+static inline u128 mont_mul(u128 a, u128 b, const ModCtx *M)
+{
+    uint64_t a0 = (uint64_t)a, a1 = (uint64_t)(a >> 64);
+    uint64_t b0 = (uint64_t)b, b1 = (uint64_t)(b >> 64);
+    uint64_t n0 = (uint64_t)M->n, n1 = (uint64_t)(M->n >> 64);
+    uint64_t t0, t1, t2, m;
+    u128 c;
     
-    return 0;
+    // i = 0: t = a * b0, then add m * n and drop the low limb
+    c = (u128)a0 * b0;
+    t0 = (uint64_t)c;
+    c = (u128)a1 * b0 + (c >> 64);
+    t1 = (uint64_t)c;
+    t2 = (uint64_t)(c >> 64);
+    m = t0 * M->ninv;
+    c = (u128)m * n0 + t0;
+    c = (u128)m * n1 + t1 + (c >> 64);
+    t0 = (uint64_t)c;
+    c = (u128)t2 + (c >> 64);
+    t1 = (uint64_t)c;
+    t2 = (uint64_t)(c >> 64);
+    
+    // i = 1: t += a * b1, then add m * n and drop the low limb
+    c = (u128)a0 * b1 + t0;
+    t0 = (uint64_t)c;
+    c = (u128)a1 * b1 + t1 + (c >> 64);
+    t1 = (uint64_t)c;
+    t2 += (uint64_t)(c >> 64);
+    m = t0 * M->ninv;
+    c = (u128)m * n0 + t0;
+    c = (u128)m * n1 + t1 + (c >> 64);
+    t0 = (uint64_t)c;
+    c = (u128)t2 + (c >> 64);
+    t1 = (uint64_t)c;
+    
+    u128 r = ((u128)t1 << 64) | t0;
+    return (r >= M->n) ? r - M->n : r;
 }
 
-// ============ CLI / demo ============
+// x mod n for x = (hi, lo) < n^2 (HAC 14.42 with base 2)
+static inline u128 barrett_reduce(u128 hi, u128 lo, const ModCtx *M)
+{
+    int k = M->k;
+    u128 q1 = (hi << (129 - k)) | (lo >> (k - 1));
+    u128 q2_hi, q2_lo;
+    mul_128x128(q1, M->mu, &q2_hi, &q2_lo);
+    u128 q3 = (q2_hi << (127 - k)) | (q2_lo >> (k + 1));
+    u128 r = lo - q3 * M->n;   // true remainder < 3n, so the low 128 bits suffice
+    while (r >= M->n)
+        r -= M->n;
+    return r;
+}
 
-void run_demo()
+// x mod n for x = (hi, lo) < n^2, n = 2^k +- c with 64 <= k and c <= 2^16.
+// Two folds x = H 2^k + L -> L -+ c H leave less than 2^k + 2^35, so one
+// correction finishes it.
+static inline u128 fold_reduce(u128 hi, u128 lo, const ModCtx *M)
 {
-    const char *demo_n_str = "815730722"; // 13^8 + 1 (small, finishes fast)
-    u128 n = parse_u128(demo_n_str);
-    int degree = 8;
-    int fb = 200;
-    int K = 5000; // search bound for k
-    
-    printf("SNFS Demo (toy) on n = ");
-    print_u128(n);
-    printf(" (degree=%d, B=%d, K=%d)\n\n", degree, fb, K);
+    int k = M->k;
+    u128 H = (hi << (128 - k)) | (lo >> k);
+    u128 L = lo & M->mask;
     
-    clock_t start = clock();
-    u128 p = snfs_factor(n, degree, fb, K);
-    clock_t mid = clock();
-    double elapsed = (double)(mid - start) / CLOCKS_PER_SEC;
+    // c H < 2^(k + 19): split it again at 2^k
+    u128 t_lo = (u128)(uint64_t)H * M->c;
+    u128 t_hi = (u128)(uint64_t)(H >> 64) * M->c;
+    u128 cH_lo = t_lo + (t_hi << 64);
+    u128 cH_hi = (t_hi >> 64) + (cH_lo < t_lo);
+    u128 H2 = (cH_hi << (128 - k)) | (cH_lo >> k);
+    u128 L2 = cH_lo & M->mask;
+    u128 cH2 = (u128)(uint64_t)H2 * M->c;   // < 2^35
     
-    if (p == 0 || p == n)
+    if (M->sign < 0)
     {
-        printf("SNFS toy failed, trying Pollard rho fallback...\n");
-        p = pollard_rho_u128(n);
+        // 2^k == c: x == L + c H == L + L2 + c H2 < 2^(k+1) + 2^35
+        u128 r = L + L2;
+        r = (r >= M->n) ? r - M->n : r;
+        r += cH2;
+        return (r >= M->n) ? r - M->n : r;
     }
-    clock_t end = clock();
-    double elapsed_total = (double)(end - start) / CLOCKS_PER_SEC;
-    
-    if (p == 0 || p == n)
+    // 2^k == -c: x == L - c H == L - L2 + c H2, in (-2^k, 2^k + 2^35)
+    i128 r = (i128)L - (i128)L2 + (i128)cH2;
+    if (r < 0)
+        r += (i128)M->n;
+    else if (r >= (i128)M->n)
+        r -= (i128)M->n;
+    return (u128)r;
+}
+
+static ModCtx mod_cache;
+static int mod_cache_valid = 0;
+
+static const ModCtx *mod_ctx(u128 n)
+{
+    if (!mod_cache_valid || mod_cache.n != n)
     {
-        printf("Failed to factor.\n");
-        return;
+        mod_ctx_init(&mod_cache, n);
+        mod_cache_valid = 1;
     }
-    u128 q = n / p;
-    
-    printf("Factors:\n  p = ");
-    print_u128(p);
-    printf("\n  q = ");
-    print_u128(q);
-    printf("\nSNFS time: %.4fs, total with fallback: %.4fs\n", elapsed, elapsed_total);
+    return &mod_cache;
 }
 
-int main(int argc, char *argv[])
+// MOD_AUTO picks per modulus as described above; the others are for benchmarks
+static void set_mulmod_engine(int kind)
 {
-    if (argc < 2)
+    mulmod_engine = kind;
+    mod_cache_valid = 0;
+}
+
+// Into / out of the context's representation (identity unless Montgomery)
+static inline u128 mod_to(u128 a, const ModCtx *M)
+{
+    if (a >= M->n)
+        a %= M->n;
+    return (M->kind == MOD_MONT) ? mont_mul(a, M->r2, M) : a;
+}
+
+static inline u128 mod_from(u128 a, const ModCtx *M)
+{
+    return (M->kind == MOD_MONT) ? mont_mul(a, 1, M) : a;
+}
+
+// Product of two values already in the context's representation
+static inline u128 mod_mul(u128 a, u128 b, const ModCtx *M)
+{
+    if (M->kind == MOD_MONT)
+        return mont_mul(a, b, M);
+    if (M->kind == MOD_BARRETT || M->kind == MOD_FOLD)
     {
-        printf("Usage: %s <n> [e] [degree] [B] [K]\n", argv[0]);
-        printf("       %s --demo\n", argv[0]);
+        u128 hi, lo;
+        mul_128x128(a, b, &hi, &lo);
+        return (M->kind == MOD_FOLD) ? fold_reduce(hi, lo, M) : barrett_reduce(hi, lo, M);
+    }
+    return mul_mod_slow(a, b, M->n);
+}
+
+static inline u128 mod_add(u128 a, u128 b, const ModCtx *M)
+{
+    u128 s = a + b;
+    return (s >= M->n || s < a) ? s - M->n : s;
+}
+
+u128 mul_mod(u128 a, u128 b, u128 mod)
+{
+    const ModCtx *M = mod_ctx(mod);
+    // (a R) * b * R^-1 = a b: one conversion instead of two
+    if (b >= mod)
+        b %= mod;
+    if (M->kind == MOD_MONT)
+        return mont_mul(mod_to(a, M), b, M);
+    return mod_mul((a >= mod) ? a % mod : a, b, M);
+}
+
+u128 pow_mod(u128 base, u128 exp, u128 mod)
+{
+    if (mod == 1)
+        return 0;
+    const ModCtx *M = mod_ctx(mod);
+    u128 result = mod_to(1, M);
+    base = mod_to(base, M);
+    while (exp)
+    {
+        if (exp & 1)
+            result = mod_mul(result, base, M);
+        base = mod_mul(base, base, M);
+        exp >>= 1;
+    }
+    return mod_from(result, M);
+}
+
+// ============ Prime generation ============
+
+#define LP_BOUND 100000000       // default for lp_bound
+#define COFACTOR_BITS 30         // default for cofactor_bits
+
+/*
+ * Large primes are at most lp_bound (--lp-bound). A sieve survivor may
+ * leave up to 2^cofactor_bits per side (--cofactor-bits) after the
+ * factor base, for the large primes plus unsieved prime powers.
+ */
+static uint32_t lp_bound = LP_BOUND;
+static int cofactor_bits = COFACTOR_BITS;
+
+int generate_primes(int limit, uint32_t *primes, int max_count)
+{
+    int count = 0;
+    char *is_prime = calloc(limit + 1, 1);
+    if (!is_prime)
+        return 0;
+    for (int i = 2; i <= limit; i++)
+        is_prime[i] = 1;
+    for (int p = 2; p * p <= limit; p++)
+    {
+        if (is_prime[p])
+        {
+            for (int j = p * p; j <= limit; j += p)
+                is_prime[j] = 0;
+        }
+    }
+    for (int i = 2; i <= limit && count < max_count; i++)
+    {
+        if (is_prime[i])
+            primes[count++] = (uint32_t)i;
+    }
+    free(is_prime);
+    return count;
+}
+
+// ============ Algebraic factor base ============
+
+/*
+ * The algebraic side factors into prime ideals of Z[x]/(f), not into
+ * primes. f is a binomial c_d x^d + c_0 (x^d + 1 before polynomial
+ * selection). Above p <= B the ideals that matter have degree one: the
+ * pairs (p, r) with f(r) == 0 (mod p), plus r = p for the projective root
+ * when p | c_d. A coprime pair (a, b) with p | F(a, b) = c_d a^d + c_0 b^d
+ * lies over exactly one of them, r == a / b (mod p) (p when p | b), and
+ * that ideal is its matrix column. The ideals are stored
+ * structure-of-arrays (p, r, log p), grouped by prime, and kept from job to
+ * job: the same polynomial and primes reuse them instead of finding every
+ * root again.
+ */
+
+#define MAX_DEGREE 12
+
+// f(x) = cd x^d + c0 and g(x) = x - m, with f(m) == 0 (mod n)
+typedef struct {
+    int degree;
+    int64_t cd, c0;
+    u128 m;
+} SnfsPoly;
+
+typedef struct {
+    int degree;                  // 0 while nothing is cached
+    int64_t cd, c0;
+    int prime_count;             // built for primes[0, prime_count)
+    uint32_t last_prime;
+    int ideal_count, capacity;
+    uint32_t *first;             // ideals over primes[k] are [first[k], first[k + 1])
+    uint32_t *p, *r;
+    uint8_t *logp;               // round(log2 p)
+} AlgebraicFB;
+
+static AlgebraicFB alg_fb;
+
+static uint64_t gcd_u64(uint64_t a, uint64_t b)
+{
+    while (b != 0)
+    {
+        uint64_t t = b;
+        b = a % b;
+        a = t;
+    }
+    return a;
+}
+
+static uint64_t powmod_u64(uint64_t b, uint64_t e, uint64_t p)
+{
+    uint64_t r = 1;
+    b %= p;
+    while (e)
+    {
+        if (e & 1)
+            r = r * b % p;
+        b = b * b % p;
+        e >>= 1;
+    }
+    return r;
+}
+
+// c mod p in [0, p)
+static uint64_t mod_i64(int64_t c, uint32_t p)
+{
+    int64_t r = c % (int64_t)p;
+    return (uint64_t)((r < 0) ? r + p : r);
+}
+
+/*
+ * Roots of x^d == t (mod p), t != 0, p odd and < 2^32. Split
+ * p - 1 = v w, where v collects the primes of g = gcd(d, p - 1). On the
+ * order-w part x -> x^d is a bijection, so that component of a root is
+ * t_w^(d^-1 mod w). On the order-v part, gamma generates; Pohlig-Hellman
+ * gives the log L of t_v, and those components are gamma^k with
+ * d k == L (mod v), one per residue of k mod v / g. No roots unless
+ * t^((p-1)/g) == 1.
+ */
+static int roots_xd_eq(uint32_t p, int d, uint64_t t, uint32_t *roots)
+{
+    uint64_t g = gcd_u64((uint64_t)d, p - 1);
+    if (powmod_u64(t, (p - 1) / g, p) != 1)
+        return 0;
+    uint64_t v = 1, w = p - 1;
+    uint32_t qs[4];
+    int nq = 0;
+    for (uint32_t q = 2, rest = (uint32_t)g; q <= rest; q++)
+    {
+        if (rest % q)
+            continue;
+        while (rest % q == 0)
+            rest /= q;
+        qs[nq++] = q;
+        while (w % q == 0)
+        {
+            w /= q;
+            v *= q;
+        }
+    }
+    // t = t_v t_w with t_v = t^(w (w^-1 mod v)) and t_w = t^(v (v^-1 mod w))
+    uint64_t t_v = (v == 1) ? 1 : powmod_u64(t, (uint64_t)((u128)w * mod_inverse_u128(w % v, v) % (p - 1)), p);
+    uint64_t t_w = (w == 1) ? 1 : powmod_u64(t, (uint64_t)((u128)v * mod_inverse_u128(v % w, w) % (p - 1)), p);
+    uint64_t x_w = (w == 1) ? 1 : powmod_u64(t_w, (uint64_t)mod_inverse_u128(d % w, w), p);
+    if (g == 1)
+    {
+        roots[0] = (uint32_t)x_w;
+        return 1;
+    }
+    
+    // gamma = c^w has order v iff c^((p-1)/q) != 1 for each prime q | v
+    uint64_t gamma = 1;
+    for (uint64_t c = 2; c < p; c++)
+    {
+        int full_order = 1;
+        for (int i = 0; i < nq && full_order; i++)
+            full_order = (powmod_u64(c, (p - 1) / qs[i], p) != 1);
+        if (full_order)
+        {
+            gamma = powmod_u64(c, w, p);
+            break;
+        }
+    }
+    
+    // log_gamma t_v, one prime power of v at a time, then CRT
+    uint64_t L = 0, L_mod = 1;
+    for (int i = 0; i < nq; i++)
+    {
+        uint64_t q = qs[i], qe = 1;
+        int e = 0;
+        while (v % (qe * q) == 0)
+        {
+            qe *= q;
+            e++;
+        }
+        uint64_t base = powmod_u64(gamma, v / qe, p);     // order q^e
+        uint64_t target = powmod_u64(t_v, v / qe, p);
+        uint64_t unit = powmod_u64(base, qe / q, p);      // order q
+        uint64_t base_inv = powmod_u64(base, p - 2, p);
+        uint64_t x = 0, qi = 1;
+        for (int k = 0; k < e; k++, qi *= q)
+        {
+            uint64_t h = target * powmod_u64(base_inv, x, p) % p;
+            h = powmod_u64(h, qe / (qi * q), p);
+            uint64_t digit = 0, u = 1;
+            while (u != h && digit < q)
+            {
+                u = u * unit % p;
+                digit++;
+            }
+            x += digit * qi;
+        }
+        // CRT: fold L == x (mod qe) into L (mod L_mod)
+        uint64_t step = (x + qe - L % qe) % qe * mod_inverse_u128(L_mod % qe, qe) % qe;
+        L += L_mod * step;
+        L_mod *= qe;
+    }
+    
+    // d k == L (mod v): k0 = (L / g) (d / g)^-1 mod v / g, then k0 + j v / g
+    uint64_t vg = v / g;
+    uint64_t k0 = (vg == 1) ? 0 : (L / g) % vg * mod_inverse_u128((d / g) % vg, vg) % vg;
+    uint64_t z = powmod_u64(gamma, k0, p) * x_w % p, zeta = powmod_u64(gamma, vg, p);
+    for (uint64_t j = 0; j < g; j++, z = z * zeta % p)
+        roots[j] = (uint32_t)z;
+    return (int)g;
+}
+
+/*
+ * Roots of f mod p (p < 2^32), p itself standing for the projective root
+ * when p | c_d. None when p divides both coefficients.
+ */
+static int poly_roots_mod(const SnfsPoly *f, uint32_t p, uint32_t *roots)
+{
+    uint64_t cd = mod_i64(f->cd, p), c0 = mod_i64(f->c0, p);
+    if (cd == 0)
+    {
+        if (c0 == 0)
+            return 0;
+        roots[0] = p;
+        return 1;
+    }
+    if (c0 == 0)
+    {
+        roots[0] = 0;
+        return 1;
+    }
+    uint64_t t = (p - c0) * powmod_u64(cd, p - 2, p) % p;
+    if (p == 2)
+    {
+        roots[0] = 1;
+        return 1;
+    }
+    return roots_xd_eq(p, f->degree, t, roots);
+}
+
+/*
+ * Ideals over primes[0, fb_size) for f, reusing the cached table when it
+ * was built for the same polynomial and primes. Returns 0 out of memory.
+ */
+static int alg_fb_build(const uint32_t *primes, int fb_size, const SnfsPoly *f)
+{
+    if (fb_size > 0 && alg_fb.degree == f->degree && alg_fb.cd == f->cd && alg_fb.c0 == f->c0 &&
+        alg_fb.prime_count == fb_size && alg_fb.last_prime == primes[fb_size - 1])
+        return 1;
+    
+    alg_fb.degree = 0;
+    alg_fb.ideal_count = 0;
+    free(alg_fb.first);
+    alg_fb.first = malloc((fb_size + 1) * sizeof(uint32_t));
+    if (!alg_fb.first)
+        return 0;
+    for (int k = 0; k < fb_size; k++)
+    {
+        uint32_t roots[MAX_DEGREE];
+        int nroots = poly_roots_mod(f, primes[k], roots);
+        if (alg_fb.ideal_count + nroots > alg_fb.capacity)
+        {
+            int cap = alg_fb.capacity ? 2 * alg_fb.capacity : 4096;
+            uint32_t *gp = realloc(alg_fb.p, cap * sizeof(uint32_t));
+            if (gp)
+                alg_fb.p = gp;
+            uint32_t *gr = realloc(alg_fb.r, cap * sizeof(uint32_t));
+            if (gr)
+                alg_fb.r = gr;
+            uint8_t *gl = realloc(alg_fb.logp, cap);
+            if (gl)
+                alg_fb.logp = gl;
+            if (!gp || !gr || !gl)
+                return 0;
+            alg_fb.capacity = cap;
+        }
+        alg_fb.first[k] = alg_fb.ideal_count;
+        uint8_t logp = (uint8_t)(log2((double)primes[k]) + 0.5);
+        for (int t = 0; t < nroots; t++)
+        {
+            alg_fb.p[alg_fb.ideal_count] = primes[k];
+            alg_fb.r[alg_fb.ideal_count] = roots[t];
+            alg_fb.logp[alg_fb.ideal_count] = logp;
+            alg_fb.ideal_count++;
+        }
+    }
+    alg_fb.first[fb_size] = alg_fb.ideal_count;
+    alg_fb.prime_count = fb_size;
+    alg_fb.last_prime = (fb_size > 0) ? primes[fb_size - 1] : 0;
+    alg_fb.cd = f->cd;
+    alg_fb.c0 = f->c0;
+    alg_fb.degree = f->degree;
+    return 1;
+}
+
+// a / b mod p, or p itself when p | b
+static uint32_t ratio_mod(int64_t a, int64_t b, uint32_t p)
+{
+    uint64_t bm = (uint64_t)(b % p + p) % p;
+    if (bm == 0)
+        return p;
+    uint64_t am = (uint64_t)(a % p + p) % p;
+    return (uint32_t)(am * powmod_u64(bm, p - 2, p) % p);
+}
+
+// Ideal over primes[k] that (a, b) lies over, or -1 if there is none
+static int alg_ideal_of(int k, int64_t a, int64_t b)
+{
+    uint32_t lo = alg_fb.first[k], hi = alg_fb.first[k + 1];
+    if (hi - lo == 1)
+        return (int)lo;   // the only candidate; saves the inversion
+    if (hi == lo)
+        return -1;
+    uint32_t r = ratio_mod(a, b, alg_fb.p[lo]);
+    for (uint32_t t = lo; t < hi; t++)
+        if (alg_fb.r[t] == r)
+            return (int)t;
+    return -1;
+}
+
+// ============ Job arena ============
+
+/*
+ * Everything a factoring job owns (factor base, relations, their
+ * factorizations, the matrix) is bump-allocated from one arena and handed
+ * back in one go by job_end, so nothing is sized at compile time and a
+ * small job touches only what it uses. Chunks start at ARENA_CHUNK and
+ * grow with the job up to ARENA_MAX_CHUNK; memory comes back zeroed.
+ */
+#define ARENA_CHUNK (64 * 1024)
+#define ARENA_MAX_CHUNK (64 << 20)
+
+typedef struct ArenaChunk {
+    struct ArenaChunk *next;
+    size_t used, size;
+    uint64_t data[];
+} ArenaChunk;
+
+typedef struct {
+    ArenaChunk *head;
+    size_t reserved;             // bytes obtained from calloc
+} Arena;
+
+static void *arena_alloc(Arena *A, size_t bytes)
+{
+    bytes = (bytes + 15) & ~(size_t)15;
+    ArenaChunk *c = A->head;
+    if (!c || c->size - c->used < bytes)
+    {
+        size_t size = (A->reserved < ARENA_MAX_CHUNK) ? A->reserved : ARENA_MAX_CHUNK;
+        if (size < ARENA_CHUNK)
+            size = ARENA_CHUNK;
+        if (size < bytes)
+            size = bytes;
+        c = calloc(1, sizeof(ArenaChunk) + size);
+        if (!c)
+            return NULL;
+        c->next = A->head;
+        c->used = 0;
+        c->size = size;
+        A->head = c;
+        A->reserved += size;
+    }
+    void *p = (unsigned char *)c->data + c->used;
+    c->used += bytes;
+    return p;
+}
+
+/*
+ * Doubling for arrays that grow during a job: copy into a block twice the
+ * size. The old block is only reclaimed by arena_release, which at most
+ * doubles what the array itself needs.
+ */
+static void *arena_grow(Arena *A, void *old, size_t old_bytes, size_t new_bytes)
+{
+    void *p = arena_alloc(A, new_bytes);
+    if (p && old_bytes)
+        memcpy(p, old, old_bytes);
+    return p;
+}
+
+static void arena_release(Arena *A)
+{
+    while (A->head)
+    {
+        ArenaChunk *next = A->head->next;
+        free(A->head);
+        A->head = next;
+    }
+    A->reserved = 0;
+}
+
+// ============ Relation / matrix handling ============
+
+#define LP_NONE 0xFFFFFFFFu
+
+typedef struct {
+    uint32_t index;              // into primes[]
+    uint32_t exp;
+} PrimePower;
+
+typedef struct {
+    int64_t a, b;                // a - b m and F(a, b)
+    uint8_t r_sign, a_sign;      // 1 when that side is negative
+    uint16_t a_count, r_count;   // factors[first..] holds a_count algebraic, then r_count rational
+    uint32_t first;
+    uint32_t lp[2];              // large primes, 0 if unused
+    uint32_t lp_root[2];         // a / b mod lp[k] for an algebraic ideal, LP_NONE on the rational side
+} Relation;
+
+/*
+ * Per-job sizes, fixed by job_begin from the runtime B. Columns are the
+ * rational and algebraic sign, then rational prime i at 2 + 2i and
+ * algebraic ideal i at 3 + 2i, so they only reach twice the larger side.
+ * Large primes are not columns: they cancel inside the cycles of the
+ * large-prime graph. rel_capacity is the row count that must give a
+ * dependency.
+ */
+static Arena job_arena;
+static uint32_t *job_primes;
+static int job_fb_size, rel_capacity;
+static int col_words, combo_words;
+
+/*
+ * The relation store is thread-local. The main thread's is the job's;
+ * a sieving worker (see Parallel sieving) fills its own, in its own arena,
+ * and hands it over whole.
+ */
+static _Thread_local Arena *store_arena = &job_arena;
+static _Thread_local Relation *relations;
+static _Thread_local int relation_count, relations_allocated;
+
+/*
+ * Sparse factorizations of all relations, appended in order. Relations
+ * refer to it by offset, so growing it never leaves a stale pointer behind.
+ */
+static _Thread_local PrimePower *factors;
+static _Thread_local uint32_t factors_used, factors_capacity;
+
+/*
+ * Row r of the matrix stands for the r-th unit kept by filtering: a full
+ * relation, or the relations of one cycle. Row r has no combination bits
+ * past r, and rows it is reduced against are older and narrower still, so
+ * each row keeps its parity words and just that many combination words.
+ */
+typedef struct {
+    uint64_t *bits;
+    int pivot;
+    int parity_words, combo_words;
+} MatrixRow;
+
+static MatrixRow *matrix;
+static int matrix_rows, matrix_allocated;
+
+// Scratch for solve_matrix / attempt_dependency, allocated once per job:
+// a full-width row is col_words parity words, then combo_words combination words
+static uint64_t *scratch_row, *dep_mask;
+static uint32_t *dep_totals;    // algebraic [0, ideal_count), then rational [0, job_fb_size)
+
+static int factors_push(uint32_t index, uint32_t exp)
+{
+    if (factors_used == factors_capacity)
+    {
+        uint32_t cap = factors_capacity ? 2 * factors_capacity : 4096;
+        PrimePower *grown = arena_grow(store_arena, factors, factors_used * sizeof(PrimePower), cap * sizeof(PrimePower));
+        if (!grown)
+            return 0;
+        factors = grown;
+        factors_capacity = cap;
+    }
+    factors[factors_used].index = index;
+    factors[factors_used].exp = exp;
+    factors_used++;
+    return 1;
+}
+
+// Slot for the next relation, or NULL when out of memory
+static Relation *relation_slot(void)
+{
+    if (relation_count == relations_allocated)
+    {
+        int cap = relations_allocated ? 2 * relations_allocated : 256;
+        Relation *grown = arena_grow(store_arena, relations, relation_count * sizeof(Relation), cap * sizeof(Relation));
+        if (!grown)
+            return NULL;
+        relations = grown;
+        relations_allocated = cap;
+    }
+    return &relations[relation_count];
+}
+
+// ============ Large-prime graph ============
+
+/*
+ * A partial relation carries one or two large primes, on either side: a
+ * rational q or an algebraic ideal (q, a / b mod q). Each large prime is
+ * a vertex and the relation an edge between its two, vertex 0 standing
+ * in for the missing end of a single large prime. The edges of a cycle
+ * meet every vertex on it twice, so the product of their relations has
+ * each large prime squared and enters the matrix like a full relation.
+ *
+ * Vertices are found through a hash table keyed on the large prime.
+ * Union-find over them tells whether a new edge closes a cycle; the edges
+ * that join two components form a spanning forest, and the forest path
+ * between the new edge's ends is the rest of its cycle.
+ */
+
+typedef struct {
+    uint32_t to, rel, next;      // edges 2k and 2k + 1 are the two directions of one
+} ForestEdge;
+
+static int large_prime_max = 2;  // large primes a relation may carry; --bench-lp lowers it
+
+static uint64_t *lp_keys;        // open addressing, 0 = empty
+static uint32_t *lp_ids;
+static uint32_t lp_table_size, lp_vertex_count, lp_vertex_capacity;
+
+// Per vertex: union-find parent, first forest edge, and the path search's marks
+static uint32_t *uf_parent, *forest_head, *bfs_mark, *bfs_edge, *bfs_queue;
+static uint32_t bfs_epoch;
+
+static ForestEdge *forest;
+static uint32_t forest_used, forest_capacity;
+
+// Unit k of the matrix is relations unit_members[unit_first[k] .. unit_first[k + 1])
+static uint32_t *unit_first, *unit_members;
+static uint32_t unit_count, members_used, members_capacity;
+
+// What the relations added up to; partial[k] carry k + 1 large primes
+static uint32_t full_count, partial_count[2], cycle_count;
+
+/*
+ * Rational q, or the algebraic ideal (q, r); never 0. q takes the high
+ * word whole. An ideal's root is below q, so a rational prime puts q
+ * itself in the low word and cannot meet an ideal of the same q.
+ */
+static uint64_t lp_key(uint32_t q, uint32_t r)
+{
+    return (uint64_t)q << 32 | ((r == LP_NONE) ? q : r);
+}
+
+static int grow_u32(uint32_t **array, uint32_t used, uint32_t cap)
+{
+    uint32_t *grown = arena_grow(&job_arena, *array, used * sizeof(uint32_t), cap * sizeof(uint32_t));
+    if (!grown)
+        return 0;
+    *array = grown;
+    return 1;
+}
+
+// A new vertex of its own component, or LP_NONE when out of memory
+static uint32_t lp_vertex_new(void)
+{
+    uint32_t v = lp_vertex_count;
+    if (v == lp_vertex_capacity)
+    {
+        uint32_t cap = lp_vertex_capacity ? 2 * lp_vertex_capacity : 1024;
+        if (!grow_u32(&uf_parent, v, cap) || !grow_u32(&forest_head, v, cap) || !grow_u32(&bfs_mark, v, cap) ||
+            !grow_u32(&bfs_edge, v, cap) || !grow_u32(&bfs_queue, v, cap))
+            return LP_NONE;
+        lp_vertex_capacity = cap;
+    }
+    uf_parent[v] = v;
+    forest_head[v] = LP_NONE;
+    bfs_mark[v] = 0;
+    lp_vertex_count++;
+    return v;
+}
+
+static int lp_table_alloc(uint32_t size)
+{
+    lp_keys = arena_alloc(&job_arena, size * sizeof(uint64_t));
+    lp_ids = arena_alloc(&job_arena, size * sizeof(uint32_t));
+    lp_table_size = size;
+    return lp_keys && lp_ids;
+}
+
+// Vertex of the large prime with this key, added on first sight
+static uint32_t lp_vertex(uint64_t key)
+{
+    uint64_t h = key * 0x9E3779B97F4A7C15ULL;
+    uint32_t slot = (uint32_t)(h >> 32) & (lp_table_size - 1);
+    for (; lp_keys[slot]; slot = (slot + 1) & (lp_table_size - 1))
+    {
+        if (lp_keys[slot] == key)
+            return lp_ids[slot];
+    }
+    uint32_t v = lp_vertex_new();
+    if (v == LP_NONE)
+        return LP_NONE;
+    lp_keys[slot] = key;
+    lp_ids[slot] = v;
+    
+    // Keep the table at most half full; the old one stays in the arena
+    if (2 * lp_vertex_count > lp_table_size)
+    {
+        uint64_t *old_keys = lp_keys;
+        uint32_t *old_ids = lp_ids, old_size = lp_table_size;
+        if (!lp_table_alloc(2 * old_size))
+            return LP_NONE;
+        for (uint32_t i = 0; i < old_size; i++)
+        {
+            if (!old_keys[i])
+                continue;
+            uint32_t s = (uint32_t)((old_keys[i] * 0x9E3779B97F4A7C15ULL) >> 32) & (lp_table_size - 1);
+            while (lp_keys[s])
+                s = (s + 1) & (lp_table_size - 1);
+            lp_keys[s] = old_keys[i];
+            lp_ids[s] = old_ids[i];
+        }
+    }
+    return v;
+}
+
+static uint32_t uf_find(uint32_t v)
+{
+    while (uf_parent[v] != v)
+    {
+        uf_parent[v] = uf_parent[uf_parent[v]];   // path halving
+        v = uf_parent[v];
+    }
+    return v;
+}
+
+static int members_push(uint32_t rel)
+{
+    if (members_used == members_capacity)
+    {
+        uint32_t cap = members_capacity ? 2 * members_capacity : 4096;
+        if (!grow_u32(&unit_members, members_used, cap))
+            return 0;
+        members_capacity = cap;
+    }
+    unit_members[members_used++] = rel;
+    return 1;
+}
+
+static int forest_link(uint32_t u, uint32_t v, uint32_t rel)
+{
+    if (forest_used + 2 > forest_capacity)
+    {
+        uint32_t cap = forest_capacity ? 2 * forest_capacity : 4096;
+        ForestEdge *grown = arena_grow(&job_arena, forest, forest_used * sizeof(ForestEdge), cap * sizeof(ForestEdge));
+        if (!grown)
+            return 0;
+        forest = grown;
+        forest_capacity = cap;
+    }
+    forest[forest_used] = (ForestEdge){v, rel, forest_head[u]};
+    forest_head[u] = forest_used++;
+    forest[forest_used] = (ForestEdge){u, rel, forest_head[v]};
+    forest_head[v] = forest_used++;
+    return 1;
+}
+
+// Append the relations on the forest path from u to v (same tree) to the members
+static int forest_path(uint32_t u, uint32_t v)
+{
+    uint32_t epoch = ++bfs_epoch, head = 0, tail = 0;
+    bfs_mark[u] = epoch;
+    bfs_queue[tail++] = u;
+    while (head < tail && bfs_mark[v] != epoch)
+    {
+        uint32_t x = bfs_queue[head++];
+        for (uint32_t e = forest_head[x]; e != LP_NONE; e = forest[e].next)
+        {
+            uint32_t y = forest[e].to;
+            if (bfs_mark[y] == epoch)
+                continue;
+            bfs_mark[y] = epoch;
+            bfs_edge[y] = e;
+            bfs_queue[tail++] = y;
+        }
+    }
+    for (uint32_t x = v; x != u; x = forest[bfs_edge[x] ^ 1].to)
+    {
+        if (!members_push(forest[bfs_edge[x]].rel))
+            return 0;
+    }
+    return 1;
+}
+
+static int lp_graph_init(void)
+{
+    lp_vertex_count = lp_vertex_capacity = 0;
+    uf_parent = forest_head = bfs_mark = bfs_edge = bfs_queue = NULL;
+    bfs_epoch = 0;
+    forest = NULL;
+    forest_used = forest_capacity = 0;
+    unit_members = NULL;
+    unit_count = members_used = members_capacity = 0;
+    full_count = partial_count[0] = partial_count[1] = cycle_count = 0;
+    unit_first = arena_alloc(&job_arena, (rel_capacity + 1) * sizeof(uint32_t));
+    return unit_first && lp_table_alloc(4096) && lp_vertex_new() == 0;
+}
+
+/*
+ * Put relations[relation_count] into the graph and count it. Returns 1
+ * when it completes a unit for the matrix (a full relation, or the cycle
+ * it closes) as unit unit_count - 1, 0 when it only joined two components,
+ * -1 when out of memory.
+ */
+static int lp_graph_add(void)
+{
+    uint32_t i = (uint32_t)relation_count++;
+    const Relation *rel = &relations[i];
+    int large = (rel->lp[0] != 0) + (rel->lp[1] != 0);
+    uint32_t start = members_used;
+    if (large == 0)
+        full_count++;
+    else
+    {
+        partial_count[large - 1]++;
+        uint32_t u = lp_vertex(lp_key(rel->lp[0], rel->lp_root[0]));
+        uint32_t v = (large == 2) ? lp_vertex(lp_key(rel->lp[1], rel->lp_root[1])) : 0;
+        if (u == LP_NONE || v == LP_NONE)
+            return -1;
+        uint32_t ru = uf_find(u), rv = uf_find(v);
+        if (ru != rv)
+        {
+            uf_parent[ru] = rv;
+            return forest_link(u, v, i) ? 0 : -1;
+        }
+        if (!forest_path(u, v))
+            return -1;
+        cycle_count++;
+    }
+    if (!members_push(i))
+        return -1;
+    unit_first[unit_count] = start;
+    unit_first[++unit_count] = members_used;
+    return 1;
+}
+
+// ============ Jobs and the matrix ============
+
+/*
+ * Start a job with the primes up to fb_bound and the ideals of f above
+ * them. Returns the number of base primes (0 on failure).
+ */
+static int job_begin(int fb_bound, const SnfsPoly *f)
+{
+    // pi(x) < 1.26 x / ln x for x > 1
+    int bound = (fb_bound > 16) ? (int)(1.26 * fb_bound / log((double)fb_bound)) + 16 : 16;
+    uint32_t *base = malloc(bound * sizeof(uint32_t));
+    if (!base)
+        return 0;
+    int fb_base = generate_primes(fb_bound, base, bound);
+    
+    arena_release(&job_arena);
+    if (fb_base == 0 || !alg_fb_build(base, fb_base, f))
+    {
+        free(base);
+        return 0;
+    }
+    job_fb_size = fb_base;
+    rel_capacity = fb_base + alg_fb.ideal_count + 18;
+    int widest = (fb_base > alg_fb.ideal_count) ? fb_base : alg_fb.ideal_count;
+    col_words = (2 * widest + 2 + 63) / 64;
+    combo_words = (rel_capacity + 63) / 64;
+    job_primes = arena_alloc(&job_arena, fb_base * sizeof(uint32_t));
+    scratch_row = arena_alloc(&job_arena, (col_words + combo_words) * sizeof(uint64_t));
+    dep_mask = arena_alloc(&job_arena, combo_words * sizeof(uint64_t));
+    dep_totals = arena_alloc(&job_arena, (alg_fb.ideal_count + fb_base) * sizeof(uint32_t));
+    if (!job_primes || !scratch_row || !dep_mask || !dep_totals || !lp_graph_init())
+    {
+        free(base);
+        arena_release(&job_arena);
+        return 0;
+    }
+    memcpy(job_primes, base, fb_base * sizeof(uint32_t));
+    free(base);
+    
+    relations = NULL;
+    relation_count = relations_allocated = 0;
+    factors = NULL;
+    factors_used = factors_capacity = 0;
+    matrix = NULL;
+    matrix_rows = matrix_allocated = 0;
+    return fb_base;
+}
+
+static void job_end(void)
+{
+    arena_release(&job_arena);
+    job_primes = NULL;
+    relations = NULL;
+    factors = NULL;
+    matrix = NULL;
+    scratch_row = dep_mask = NULL;
+    dep_totals = NULL;
+    lp_keys = NULL;
+    lp_ids = uf_parent = forest_head = bfs_mark = bfs_edge = bfs_queue = NULL;
+    forest = NULL;
+    unit_first = unit_members = NULL;
+}
+
+static int first_set_bit(uint64_t *row, int words)
+{
+    for (int w = 0; w < words; w++)
+    {
+        if (row[w])
+        {
+            int offset = __builtin_ctzll(row[w]);
+            return w * 64 + offset;
+        }
+    }
+    return -1;
+}
+
+static void xor_rows(uint64_t *dst, uint64_t *src, int words)
+{
+    for (int i = 0; i < words; i++)
+        dst[i] ^= src[i];
+}
+
+static int row_is_zero(uint64_t *row, int words)
+{
+    for (int i = 0; i < words; i++)
+        if (row[i])
+            return 0;
+    return 1;
+}
+
+/*
+ * Reduce a full-width row against the matrix. If it becomes zero, returns 1
+ * with the combination in out_dep; otherwise keeps the first parity_words
+ * and combo_words of it as a new pivot row. -1 when out of memory.
+ */
+static int insert_row(uint64_t *row, int parity_words, int combo_used, uint64_t *out_dep)
+{
+    uint64_t *combo = row + col_words;
+    for (int r = 0; r < matrix_rows; r++)
+    {
+        const MatrixRow *mr = &matrix[r];
+        if (row[mr->pivot / 64] & ((uint64_t)1 << (mr->pivot % 64)))
+        {
+            xor_rows(row, mr->bits, mr->parity_words);
+            xor_rows(combo, mr->bits + mr->parity_words, mr->combo_words);
+        }
+    }
+    if (row_is_zero(row, parity_words))
+    {
+        memcpy(out_dep, combo, combo_words * sizeof(uint64_t));
+        return 1; // dependency found
+    }
+    int pc = first_set_bit(row, parity_words);
+    if (pc < 0)
+        return 0;
+    if (matrix_rows == matrix_allocated)
+    {
+        int cap = matrix_allocated ? 2 * matrix_allocated : 256;
+        MatrixRow *grown = arena_grow(&job_arena, matrix, matrix_rows * sizeof(MatrixRow), cap * sizeof(MatrixRow));
+        if (!grown)
+            return -1;
+        matrix = grown;
+        matrix_allocated = cap;
+    }
+    // Rows are allocated one by one, so a grown index never copies row data
+    uint64_t *kept = arena_alloc(&job_arena, (parity_words + combo_used) * sizeof(uint64_t));
+    if (!kept)
+        return -1;
+    memcpy(kept, row, parity_words * sizeof(uint64_t));
+    memcpy(kept + parity_words, combo, combo_used * sizeof(uint64_t));
+    MatrixRow *mr = &matrix[matrix_rows++];
+    mr->bits = kept;
+    mr->pivot = pc;
+    mr->parity_words = parity_words;
+    mr->combo_words = combo_used;
+    return 0;
+}
+
+// ============ (a, b) sieve ============
+
+/*
+ * Relations come from coprime pairs (a, b), b > 0, where both sides are
+ * smooth:
+ *   rational   a - b m
+ *   algebraic  F(a, b) = b^d f(a / b) = c_d a^d + c_0 b^d   (f(m) == 0 mod n)
+ * Pairs are sieved in lattice coordinates (a, b) = i (a0, b0) + j (a1, b1),
+ * i in [-I, I), 1 <= j <= J, one line of fixed j at a time and both sides
+ * per line. The plain region a in [-A, A), 1 <= b <= A is the identity
+ * lattice; a special-q lattice (below) keeps only pairs with q | F(a, b).
+ */
+
+#define SIEVE_BLOCK 32768   // i values per block; both byte arrays stay in L2
+#define LAT_SKIP 0xFFFFFFFFu       // p divides no point (or every point) of the lattice
+#define LAT_J_ONLY 0xFFFFFFFEu     // p divides exactly the points with p | j
+
+typedef struct {
+    int64_t a0, b0, a1, b1;   // reduced basis
+    uint32_t q;               // special q, 1 for the identity lattice
+    double log_q;
+    int64_t j0;               // lines j0 + 1, j0 + 2, ...: 0 but for a strip of a region
+} Lattice;
+
+/*
+ * Per-prime (rational) and per-ideal (algebraic) tables, grown by
+ * sieve_init. Everything that depends on the lattice or the block is
+ * thread-local, so sieving threads share only the first two.
+ */
+static uint8_t *fb_logp;                   // round(log2 p)
+static uint32_t *fb_mmod;                  // m mod p
+static int sieve_capacity;
+static _Thread_local uint32_t *lat_root_r;   // p | a - b m  <=>  i == R j (mod p)
+static _Thread_local uint32_t *lat_root_a;   // the same for ideal (p, r): p | a - b r
+static _Thread_local int root_capacity, ideal_capacity;
+static _Thread_local int64_t sieve_hits_a[SIEVE_BLOCK];   // (a, b) of the survivors, b > 0
+static _Thread_local int64_t sieve_hits_b[SIEVE_BLOCK];
+
+// Grow this thread's lattice root tables to fb_size primes and their ideals
+static int lattice_tables(int fb_size)
+{
+    if (fb_size > root_capacity)
+    {
+        free(lat_root_r);
+        lat_root_r = malloc(fb_size * sizeof(uint32_t));
+        root_capacity = lat_root_r ? fb_size : 0;
+        if (!lat_root_r)
+            return 0;
+    }
+    if (alg_fb.ideal_count > ideal_capacity)
+    {
+        free(lat_root_a);
+        lat_root_a = malloc(alg_fb.ideal_count * sizeof(uint32_t));
+        ideal_capacity = lat_root_a ? alg_fb.ideal_count : 0;
+        if (!lat_root_a)
+            return 0;
+    }
+    return 1;
+}
+
+// Returns 0 if the tables cannot be grown to fb_size
+static int sieve_init(const uint32_t *primes, int fb_size, const SnfsPoly *f)
+{
+    if (!alg_fb_build(primes, fb_size, f))
+        return 0;
+    if (fb_size > sieve_capacity)
+    {
+        // Contents are rebuilt below, so free and allocate rather than realloc
+        free(fb_logp);
+        free(fb_mmod);
+        fb_logp = malloc(fb_size);
+        fb_mmod = malloc(fb_size * sizeof(uint32_t));
+        sieve_capacity = 0;
+        if (!fb_logp || !fb_mmod)
+            return 0;
+        sieve_capacity = fb_size;
+    }
+    if (!lattice_tables(fb_size))
+        return 0;
+    for (int i = 0; i < fb_size; i++)
+    {
+        fb_logp[i] = (uint8_t)(log2((double)primes[i]) + 0.5);
+        fb_mmod[i] = (uint32_t)(f->m % primes[i]);
+    }
+    return 1;
+}
+
+// Bits of the larger coefficient of f
+static int poly_coef_bits(const SnfsPoly *f)
+{
+    uint64_t cd = (f->cd < 0) ? -(uint64_t)f->cd : (uint64_t)f->cd;
+    uint64_t c0 = (f->c0 < 0) ? -(uint64_t)f->c0 : (uint64_t)f->c0;
+    return bit_length_u128((cd > c0) ? cd : c0);
+}
+
+// Half-width of a square region with ~area positions; |F(a, b)| < 2^126
+static int64_t sieve_half_width(int area, const SnfsPoly *f)
+{
+    int64_t A = (int64_t)sqrt(area / 2.0);
+    int64_t cap = (int64_t)pow(2.0, (double)(125 - poly_coef_bits(f)) / f->degree);
+    if (A > cap)
+        A = cap;
+    return (A < 1) ? 1 : A;
+}
+
+static void lattice_identity(Lattice *L)
+{
+    L->a0 = 1;
+    L->b0 = 0;
+    L->a1 = 0;
+    L->b1 = 1;
+    L->q = 1;
+    L->log_q = 0.0;
+    L->j0 = 0;
+}
+
+/*
+ * Basis of {(a, b) : a == r b (mod q)}, i.e. (q, 0) and (r, 1), reduced by
+ * Lagrange's algorithm so both vectors are about sqrt(q) long.
+ */
+static void lattice_reduce(uint32_t q, uint32_t r, Lattice *L)
+{
+    int64_t ua = q, ub = 0, va = r, vb = 1;
+    for (;;)
+    {
+        int64_t nu = ua * ua + ub * ub, nv = va * va + vb * vb;
+        if (nu < nv)
+        {
+            int64_t ta = ua, tb = ub;
+            ua = va;
+            ub = vb;
+            va = ta;
+            vb = tb;
+            nv = nu;
+        }
+        int64_t k = llround((double)(ua * va + ub * vb) / (double)nv);
+        if (k == 0)
+            break;
+        ua -= k * va;
+        ub -= k * vb;
+        if (ua * ua + ub * ub >= nv)
+            break;
+    }
+    L->a0 = ua;
+    L->b0 = ub;
+    L->a1 = va;
+    L->b1 = vb;
+    L->q = q;
+    L->log_q = log2((double)q);
+    L->j0 = 0;
+}
+
+/*
+ * p | a - rho b at (a, b) = i (a0, b0) + j (a1, b1) iff
+ * i alpha + j beta == 0 (mod p) with alpha = a0 - rho b0, beta = a1 - rho b1.
+ * rho = p is the projective root, p | b: alpha = b0, beta = b1.
+ */
+static uint32_t lattice_root(uint32_t p, uint32_t rho, const Lattice *L)
+{
+    int64_t rp = rho;
+    uint64_t alpha, beta;
+    if (rho == p)
+    {
+        alpha = (uint64_t)((L->b0 % p + p) % p);
+        beta = (uint64_t)((L->b1 % p + p) % p);
+    }
+    else
+    {
+        alpha = (uint64_t)(((L->a0 - rp * (L->b0 % p)) % p + p) % p);
+        beta = (uint64_t)(((L->a1 - rp * (L->b1 % p)) % p + p) % p);
+    }
+    if (alpha == 0)
+        return (beta == 0) ? LAT_SKIP : LAT_J_ONLY;
+    return (uint32_t)((p - beta) % p * powmod_u64(alpha, p - 2, p) % p);
+}
+
+static void lattice_roots(const uint32_t *primes, int fb_size, const Lattice *L)
+{
+    for (int i = 0; i < fb_size; i++)
+    {
+        uint32_t p = primes[i];
+        // q itself is already divided out by construction
+        lat_root_r[i] = lattice_root(p, fb_mmod[i], L);
+        for (uint32_t t = alg_fb.first[i]; t < alg_fb.first[i + 1]; t++)
+            lat_root_a[t] = (p == L->q) ? LAT_SKIP : lattice_root(p, alg_fb.r[t], L);
+    }
+}
+
+static inline void sieve_add(uint8_t *sieve, uint32_t R, uint32_t p, uint64_t jp, uint64_t start, int len, uint8_t logp)
+{
+    if (R == LAT_SKIP)
+        return;
+    if (R == LAT_J_ONLY)
+    {
+        if (jp == 0)
+            for (int x = 0; x < len; x++)
+                sieve[x] += logp;
+        return;
+    }
+    for (uint32_t pos = (uint32_t)((R * jp + p - start) % p); pos < (uint32_t)len; pos += p)
+        sieve[pos] += logp;
+}
+
+// Sieve primes[0, k_end) into one line segment: i in [i0, i0 + len) at j
+static void sieve_segment(uint8_t *sieve_r, uint8_t *sieve_a, const uint32_t *primes, int k_end, int64_t j, int64_t i0, int len)
+{
+    for (int k = 0; k < k_end; k++)
+    {
+        uint32_t p = primes[k];
+        uint64_t start = (uint64_t)(i0 % p + p) % p;   // i0 mod p
+        uint64_t jp = (uint64_t)j % p;
+        sieve_add(sieve_r, lat_root_r[k], p, jp, start, len, fb_logp[k]);
+        for (uint32_t t = alg_fb.first[k]; t < alg_fb.first[k + 1]; t++)
+            sieve_add(sieve_a, lat_root_a[t], p, jp, start, len, alg_fb.logp[t]);
+    }
+}
+
+// ============ Bucket sieve ============
+
+/*
+ * The region i in [i_lo, i_lo + W), 1 <= j <= J is laid out line after
+ * line, position P = (j - 1) W + (i - i_lo), and cut into blocks of
+ * SIEVE_BLOCK. Primes below W are sieved per line segment inside each
+ * block as before. A prime p >= W hits each line at most once, so walking
+ * it line by line wastes J steps per root and scatters writes over the
+ * whole region. Instead, one pass over those primes enumerates only their
+ * hits (Franke-Kleinjung) and pushes (offset, side, log p) into the bucket
+ * of the block each hit falls in. sieve_block then applies a block's
+ * bucket while the block is hot in L1.
+ */
+
+#define BUCKET_SIDE_A 0x100   // update = offset << 9 | side | log p
+
+typedef struct {
+    uint32_t *updates;
+    uint32_t *index;           // prime index of each update, for resieving
+    int count, capacity;
+} Bucket;
+
+static _Thread_local Bucket *buckets;
+static _Thread_local int buckets_allocated;
+static _Thread_local int bucket_first;   // primes[bucket_first..] go through the buckets
+static int bucket_sieve = 1;   // 0: every prime is line-sieved (the plain sieve)
+
+static inline void bucket_push(int64_t P, uint32_t side_logp, uint32_t k)
+{
+    Bucket *bk = &buckets[P / SIEVE_BLOCK];
+    if (bk->count == bk->capacity)
+    {
+        int cap = bk->capacity ? 2 * bk->capacity : 1024;
+        uint32_t *grown = realloc(bk->updates, cap * sizeof(uint32_t));
+        if (!grown)
+            return;   // drop the update: at worst a missed survivor
+        bk->updates = grown;
+        grown = realloc(bk->index, cap * sizeof(uint32_t));
+        if (!grown)
+            return;
+        bk->index = grown;
+        bk->capacity = cap;
+    }
+    bk->index[bk->count] = k;
+    bk->updates[bk->count++] = (uint32_t)(P % SIEVE_BLOCK) << 9 | side_logp;
+}
+
+/*
+ * Franke-Kleinjung basis of {(x, j) : x == R j (mod p)} for p >= W,
+ * 0 < R < p: (alpha, beta) and (gamma, delta) with -W < alpha <= 0 <=
+ * gamma < W, gamma - alpha >= W and beta, delta > 0. From any point of the
+ * strip 0 <= x < W the next one up is x + alpha, x + gamma or
+ * x + alpha + gamma, whichever stays in the strip.
+ */
+static void fk_basis(int64_t p, int64_t R, int64_t W, int64_t *alpha, int64_t *beta, int64_t *gamma, int64_t *delta)
+{
+    int64_t ui = -p, uj = 0, vi = R, vj = 1, k;
+    while (vi >= W)
+    {
+        k = -ui / vi;
+        ui += k * vi;
+        uj += k * vj;
+        if (ui > -W)
+        {
+            // u is short enough (ui < 0 since gcd(p, R) = 1 and vi > 1); bring v down to [W + ui, W)
+            k = (vi - W - ui) / -ui;
+            vi += k * ui;
+            vj += k * uj;
+            goto done;
+        }
+        k = vi / -ui;
+        vi += k * ui;
+        vj += k * uj;
+    }
+    // v is short enough; bring u up to (-W, vi - W]
+    k = (-W - ui) / vi + 1;
+    ui += k * vi;
+    uj += k * vj;
+done:
+    *alpha = ui;
+    *beta = uj;
+    *gamma = vi;
+    *delta = vj;
+}
+
+// Push every hit of x == R j + c (mod p) in the strip, 1 <= j <= J
+static void bucket_walk(uint32_t p, uint32_t R, int64_t c, int64_t W, int64_t J, uint32_t side_logp, uint32_t k)
+{
+    int64_t x = c, j = 0;
+    if (R == 0)
+    {
+        if (c < W)
+            for (j = 1; j <= J; j++)
+                bucket_push((j - 1) * W + x, side_logp, k);
+        return;
+    }
+    // First point: (c, 0) when it lies in the strip, else scan up (only happens off-centre)
+    while (x >= W)
+    {
+        if (++j > J)
+            return;
+        x = (x + R) % p;
+    }
+    int64_t alpha, beta, gamma, delta;
+    fk_basis(p, R, W, &alpha, &beta, &gamma, &delta);
+    for (;;)
+    {
+        if (j >= 1)
+            bucket_push((j - 1) * W + x, side_logp, k);
+        if (x >= -alpha)
+        {
+            x += alpha;
+            j += beta;
+        }
+        else if (x < W - gamma)
+        {
+            x += gamma;
+            j += delta;
+        }
+        else
+        {
+            x += alpha + gamma;
+            j += beta + delta;
+        }
+        if (j > J)
+            return;
+    }
+}
+
+/*
+ * Lay out the region (lines L->j0 + 1 to L->j0 + J) and fill the buckets
+ * of all its blocks from the lattice roots set by lattice_roots. Returns
+ * the number of blocks.
+ */
+static int bucket_fill(const uint32_t *primes, int fb_size, const Lattice *L, int64_t i_lo, int64_t W, int64_t J)
+{
+    int blocks = (int)((W * J + SIEVE_BLOCK - 1) / SIEVE_BLOCK);
+    if (blocks > buckets_allocated)
+    {
+        Bucket *grown = realloc(buckets, blocks * sizeof(Bucket));
+        if (!grown)
+        {
+            bucket_first = fb_size;
+            return blocks;
+        }
+        memset(grown + buckets_allocated, 0, (blocks - buckets_allocated) * sizeof(Bucket));
+        buckets = grown;
+        buckets_allocated = blocks;
+    }
+    for (int blk = 0; blk < blocks; blk++)
+        buckets[blk].count = 0;
+    
+    bucket_first = fb_size;
+    if (!bucket_sieve)
+        return blocks;
+    for (int k = 0; k < fb_size; k++)
+    {
+        if (primes[k] >= W)
+        {
+            bucket_first = k;
+            break;
+        }
+    }
+    
+    for (int k = bucket_first; k < fb_size; k++)
+    {
+        uint32_t p = primes[k];
+        int64_t c = ((-i_lo) % p + p) % p;   // x == R (j0 + j) - i_lo
+        uint64_t j0 = (uint64_t)L->j0 % p;
+        // j0 + J < p here, so LAT_J_ONLY (p | j) never hits
+        if (lat_root_r[k] < LAT_J_ONLY)
+            bucket_walk(p, lat_root_r[k], (int64_t)((c + lat_root_r[k] * j0) % p), W, J, fb_logp[k], k);
+        for (uint32_t t = alg_fb.first[k]; t < alg_fb.first[k + 1]; t++)
+        {
+            if (lat_root_a[t] < LAT_J_ONLY)
+                bucket_walk(p, lat_root_a[t], (int64_t)((c + lat_root_a[t] * j0) % p), W, J, BUCKET_SIDE_A | alg_fb.logp[t], k);
+        }
+    }
+    return blocks;
+}
+
+// ============ Resieving ============
+
+/*
+ * A survivor used to be trial-divided by the whole factor base, nearly
+ * all of it in vain. Once a block's survivors are known, its primes from
+ * RESIEVE_MIN up are walked again, line-sieved ones over the block's
+ * segments and bucket ones over its bucket, this time noting (survivor,
+ * prime, side) wherever a survivor is hit. factor_pair then divides by
+ * those primes, and trial-divides only below RESIEVE_MIN, where a walk
+ * costs more than the division.
+ */
+
+#define RESIEVE_MIN 32
+#define RESIEVE_SIDE_A 1           // divisor = prime index << 1 | side
+
+static int resieve = 1;            // 0: survivors are trial-divided by every prime (--bench-resieve)
+static _Thread_local int resieve_first;   // primes[resieve_first..] are resieved
+static _Thread_local uint16_t resieve_slot[SIEVE_BLOCK];   // offset -> survivor + 1, 0 elsewhere
+static _Thread_local int sieve_hits_off[SIEVE_BLOCK];
+static _Thread_local uint64_t *resieve_notes;   // survivor << 32 | divisor, in the order found
+static _Thread_local uint32_t resieve_count, resieve_capacity;
+static _Thread_local int resieve_failed;
+static _Thread_local uint32_t *hit_divisors;    // survivor h: hit_divisors[hit_first[h]..hit_first[h + 1])
+static _Thread_local uint32_t hit_divisors_capacity;
+static _Thread_local uint32_t hit_first[SIEVE_BLOCK + 1];
+static _Thread_local int resieved_hits;         // survivors of the last block that have a divisor list
+
+static inline void resieve_note(int h, uint32_t divisor)
+{
+    if (resieve_count == resieve_capacity)
+    {
+        uint32_t cap = resieve_capacity ? 2 * resieve_capacity : 4096;
+        uint64_t *grown = realloc(resieve_notes, cap * sizeof(uint64_t));
+        if (!grown)
+        {
+            resieve_failed = 1;   // the block falls back to trial division
+            return;
+        }
+        resieve_notes = grown;
+        resieve_capacity = cap;
+    }
+    resieve_notes[resieve_count++] = (uint64_t)h << 32 | divisor;
+}
+
+// sieve_add's walk, noting the survivors it lands on
+static void resieve_add(const uint16_t *slot, uint32_t R, uint32_t p, uint64_t jp, uint64_t start, int len, uint32_t divisor)
+{
+    if (R == LAT_SKIP)
+        return;
+    if (R == LAT_J_ONLY)
+    {
+        if (jp == 0)
+            for (int x = 0; x < len; x++)
+                if (slot[x])
+                    resieve_note(slot[x] - 1, divisor);
+        return;
+    }
+    for (uint32_t pos = (uint32_t)((R * jp + p - start) % p); pos < (uint32_t)len; pos += p)
+        if (slot[pos])
+            resieve_note(slot[pos] - 1, divisor);
+}
+
+// First index k < count with primes[k] >= x, else count
+static int prime_index_at_least(const uint32_t *primes, int count, uint32_t x)
+{
+    int lo = 0, hi = count;
+    while (lo < hi)
+    {
+        int mid = (lo + hi) / 2;
+        if (primes[mid] < x)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+/*
+ * Collect the divisors of block blk's survivors, whose offsets are in
+ * sieve_hits_off and marked in resieve_slot, into hit_divisors.
+ */
+static void resieve_block(const uint32_t *primes, const Lattice *L, int64_t i_lo, int64_t W, int blk, int len, int hits)
+{
+    int64_t P0 = (int64_t)blk * SIEVE_BLOCK;
+    resieve_first = prime_index_at_least(primes, alg_fb.prime_count, RESIEVE_MIN);
+    resieve_count = 0;
+    resieve_failed = 0;
+    
+    int next = 0;   // first survivor at or after the segment
+    for (int off = 0; off < len;)
+    {
+        int64_t j = L->j0 + (P0 + off) / W + 1, x = (P0 + off) % W;
+        int seg = (W - x < len - off) ? (int)(W - x) : len - off;
+        while (next < hits && sieve_hits_off[next] < off)
+            next++;
+        if (next < hits && sieve_hits_off[next] < off + seg)
+        {
+            int64_t i0 = i_lo + x;
+            for (int k = resieve_first; k < bucket_first; k++)
+            {
+                uint32_t p = primes[k];
+                uint64_t start = (uint64_t)(i0 % p + p) % p;
+                uint64_t jp = (uint64_t)j % p;
+                resieve_add(resieve_slot + off, lat_root_r[k], p, jp, start, seg, (uint32_t)k << 1);
+                for (uint32_t t = alg_fb.first[k]; t < alg_fb.first[k + 1]; t++)
+                    resieve_add(resieve_slot + off, lat_root_a[t], p, jp, start, seg, (uint32_t)k << 1 | RESIEVE_SIDE_A);
+            }
+        }
+        off += seg;
+    }
+    
+    const Bucket *bk = &buckets[blk];
+    for (int u = 0; u < bk->count; u++)
+    {
+        uint32_t upd = bk->updates[u];
+        uint16_t s = resieve_slot[upd >> 9];
+        if (s)
+            resieve_note(s - 1, bk->index[u] << 1 | ((upd & BUCKET_SIDE_A) ? RESIEVE_SIDE_A : 0));
+    }
+    
+    // The special-q ideal is skipped by the sieve but divides every norm
+    if (L->q > 1)
+    {
+        int k = prime_index_at_least(primes, alg_fb.prime_count, L->q);
+        if (k >= resieve_first && k < alg_fb.prime_count)
+            for (int h = 0; h < hits; h++)
+                resieve_note(h, (uint32_t)k << 1 | RESIEVE_SIDE_A);
+    }
+    
+    for (int h = 0; h < hits; h++)
+        resieve_slot[sieve_hits_off[h]] = 0;
+    resieved_hits = 0;
+    if (resieve_failed)
+        return;
+    if (resieve_count > hit_divisors_capacity)
+    {
+        uint32_t *grown = realloc(hit_divisors, resieve_count * sizeof(uint32_t));
+        if (!grown)
+            return;
+        hit_divisors = grown;
+        hit_divisors_capacity = resieve_count;
+    }
+    
+    // Group by survivor, keeping each one's divisors in the order found
+    memset(hit_first, 0, (hits + 1) * sizeof(uint32_t));
+    for (uint32_t e = 0; e < resieve_count; e++)
+        hit_first[(resieve_notes[e] >> 32) + 1]++;
+    for (int h = 0; h < hits; h++)
+        hit_first[h + 1] += hit_first[h];
+    for (uint32_t e = 0; e < resieve_count; e++)
+        hit_divisors[hit_first[resieve_notes[e] >> 32]++] = (uint32_t)resieve_notes[e];
+    for (int h = hits; h > 0; h--)
+        hit_first[h] = hit_first[h - 1];
+    hit_first[0] = 0;
+    resieved_hits = hits;
+}
+
+/*
+ * Sieve block blk of the region laid out by bucket_fill: small primes per
+ * line segment, then the block's bucket. Positions where both sums come
+ * within cofactor_bits of the side's size (less log q on the algebraic
+ * side) go to sieve_hits_a/b as (a, b) with b > 0; returns how many.
+ * Unless resieve is off, their divisors are then resieved.
+ */
+static int sieve_block(const uint32_t *primes, const SnfsPoly *f, const Lattice *L, int64_t i_lo, int64_t W, int64_t J, int blk)
+{
+    static _Thread_local uint8_t sieve_r[SIEVE_BLOCK], sieve_a[SIEVE_BLOCK];
+    int64_t P0 = (int64_t)blk * SIEVE_BLOCK;
+    int len = (W * J - P0 < SIEVE_BLOCK) ? (int)(W * J - P0) : SIEVE_BLOCK;
+    memset(sieve_r, 0, len);
+    memset(sieve_a, 0, len);
+    int coef_bits = poly_coef_bits(f);
+    
+    for (int off = 0; off < len;)
+    {
+        int64_t j = L->j0 + (P0 + off) / W + 1, x = (P0 + off) % W;
+        int seg = (W - x < len - off) ? (int)(W - x) : len - off;
+        sieve_segment(sieve_r + off, sieve_a + off, primes, bucket_first, j, i_lo + x, seg);
+        off += seg;
+    }
+    
+    const Bucket *bk = &buckets[blk];
+    for (int u = 0; u < bk->count; u++)
+    {
+        uint32_t upd = bk->updates[u];
+        uint8_t *sieve = (upd & BUCKET_SIDE_A) ? sieve_a : sieve_r;
+        sieve[upd >> 9] += (uint8_t)upd;
+    }
+    
+    int hits = 0;
+    for (int off = 0; off < len; off++)
+    {
+        int64_t j = L->j0 + (P0 + off) / W + 1;
+        int64_t i = i_lo + (P0 + off) % W;
+        int64_t a = i * L->a0 + j * L->a1;
+        int64_t b = i * L->b0 + j * L->b1;
+        if (b == 0)
+            continue;
+        if (b < 0)
+        {
+            a = -a;
+            b = -b;
+        }
+        int64_t bm = b * (int64_t)f->m;
+        int64_t rational = (a > bm) ? a - bm : bm - a;
+        if (sieve_r[off] < bit_length_u128((u128)rational) - cofactor_bits)
+            continue;
+        int64_t big = (a < -b || a > b) ? ((a < 0) ? -a : a) : b;
+        if (sieve_a[off] < (int)(f->degree * log2((double)big) + coef_bits - L->log_q) - cofactor_bits)
+            continue;
+        sieve_hits_a[hits] = a;
+        sieve_hits_b[hits] = b;
+        sieve_hits_off[hits] = off;
+        hits++;
+        resieve_slot[off] = (uint16_t)hits;
+    }
+    resieved_hits = 0;
+    if (resieve && hits > 0)
+        resieve_block(primes, L, i_lo, W, blk, len, hits);
+    return hits;
+}
+
+// ============ Cofactorization ============
+
+/*
+ * Dividing out the factor base leaves a cofactor c on each side, free of
+ * primes <= B. It is classed by size and primality: 1, a prime up to
+ * lp_bound, or a composite up to lp_bound^2 that may split into two large
+ * primes. A composite below SPF_LIMIT is split by a smallest prime factor
+ * table. Above that Brent's rho goes first: with Montgomery steps it took
+ * 0.7x SQUFOF's time at every size from 12- to 30-bit factors. SQUFOF,
+ * then a few stage-1 ECM curves, take over when it gives up. cofactor_bits
+ * (<= 62) caps the cofactor, so every engine works in 64-bit arithmetic.
+ */
+
+#define SPF_LIMIT (1u << 20)
+#define RHO_BATCH 64             // |x - y| products per gcd
+#define RHO_MAX_STEPS 65536
+#define SQUFOF_SLICE 256         // forward steps per multiplier before switching
+#define ECM_B1 150
+#define ECM_CURVES 12
+
+enum { COFAC_SPF, COFAC_RHO, COFAC_SQUFOF, COFAC_ECM, COFAC_ENGINES };
+
+typedef struct {
+    uint64_t calls[COFAC_ENGINES], splits[COFAC_ENGINES];
+} CofactorStats;
+
+static _Thread_local CofactorStats cofac_stats;   // of the calling thread's sieve
+static int cofactorize = 1;         // 0: composite cofactors are refused (--bench-cofactor)
+static _Thread_local uint64_t *cofactor_log;      // --bench-cofactor: composites seen, for timing
+static _Thread_local uint32_t cofactor_logged, cofactor_log_capacity;
+
+// Montgomery arithmetic mod an odd n < 2^63
+typedef struct {
+    uint64_t n;
+    uint64_t ninv;   // -n^-1 mod 2^64
+    uint64_t one;    // R mod n
+    uint64_t r2;     // R^2 mod n
+} Mont64;
+
+static void m64_init(Mont64 *M, uint64_t n)
+{
+    uint64_t inv = n;
+    for (int i = 0; i < 5; i++)
+        inv *= 2 - n * inv;   // Newton: doubles correct bits each step
+    M->n = n;
+    M->ninv = (uint64_t)0 - inv;
+    M->one = (uint64_t)(((u128)1 << 64) % n);
+    M->r2 = (uint64_t)(((u128)M->one * M->one) % n);
+}
+
+static inline uint64_t m64_mul(uint64_t a, uint64_t b, const Mont64 *M)
+{
+    u128 t = (u128)a * b;
+    uint64_t m = (uint64_t)t * M->ninv;
+    uint64_t u = (uint64_t)((t + (u128)m * M->n) >> 64);
+    return (u >= M->n) ? u - M->n : u;
+}
+
+static inline uint64_t m64_add(uint64_t a, uint64_t b, uint64_t n)
+{
+    uint64_t s = a + b;
+    return (s >= n) ? s - n : s;
+}
+
+static inline uint64_t m64_sub(uint64_t a, uint64_t b, uint64_t n)
+{
+    return (a >= b) ? a - b : a + n - b;
+}
+
+static inline uint64_t m64_to(uint64_t a, const Mont64 *M)
+{
+    return m64_mul(a % M->n, M->r2, M);
+}
+
+static inline uint64_t m64_from(uint64_t a, const Mont64 *M)
+{
+    return m64_mul(a, 1, M);
+}
+
+/*
+ * Miller-Rabin: bases 2, 7 and 61 are exact below 2^32, where every large
+ * prime lives; the first 12 primes as bases are exact for any cofactor.
+ */
+static int is_prime_u64(uint64_t x)
+{
+    static const uint64_t bases[] = {2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37};
+    static const uint64_t small_bases[] = {2, 7, 61};
+    if (x < 2)
+        return 0;
+    for (int i = 0; i < 12; i++)
+    {
+        if (x % bases[i] == 0)
+            return x == bases[i];
+    }
+    if (x < 41 * 41)
+        return 1;
+    
+    Mont64 M;
+    m64_init(&M, x);
+    uint64_t d = x - 1;
+    int s = 0;
+    while (d % 2 == 0)
+    {
+        d /= 2;
+        s++;
+    }
+    const uint64_t *base = (x >> 32) ? bases : small_bases;
+    int count = (x >> 32) ? 12 : 3;
+    uint64_t minus_one = x - M.one;
+    for (int i = 0; i < count; i++)
+    {
+        uint64_t y = M.one, b = m64_to(base[i], &M);
+        if (b == 0)
+            continue;   // x is the base itself
+        for (uint64_t k = d; k; k >>= 1)
+        {
+            if (k & 1)
+                y = m64_mul(y, b, &M);
+            b = m64_mul(b, b, &M);
+        }
+        if (y == M.one || y == minus_one)
+            continue;
+        int r = 1;
+        for (; r < s && y != minus_one; r++)
+            y = m64_mul(y, y, &M);
+        if (y != minus_one)
+            return 0;
+    }
+    return 1;
+}
+
+// Smallest prime factor of each odd composite below SPF_LIMIT, 0 for primes
+static uint16_t *spf_table;
+
+static int spf_init(void)
+{
+    if (spf_table)
+        return 1;
+    spf_table = calloc(SPF_LIMIT, sizeof(uint16_t));
+    if (!spf_table)
+        return 0;
+    for (uint32_t p = 3; p * p < SPF_LIMIT; p += 2)
+    {
+        if (spf_table[p])
+            continue;
+        for (uint32_t j = p * p; j < SPF_LIMIT; j += 2 * p)
+            if (!spf_table[j])
+                spf_table[j] = (uint16_t)p;
+    }
+    return 1;
+}
+
+// Brent's cycle finding on x^2 + c, gcds batched; a factor or 0
+static uint64_t rho_brent_u64(uint64_t n)
+{
+    Mont64 M;
+    m64_init(&M, n);
+    for (uint64_t c = 1; c <= 3; c++)
+    {
+        uint64_t cm = m64_to(c, &M), y = m64_to(2, &M), x = y, ys = y, q = M.one, g = 1;
+        uint64_t steps = 0;
+        for (uint64_t r = 1; g == 1 && steps < RHO_MAX_STEPS; r *= 2)
+        {
+            x = y;
+            for (uint64_t i = 0; i < r; i++)
+                y = m64_add(m64_mul(y, y, &M), cm, n);
+            for (uint64_t k = 0; k < r && g == 1; k += RHO_BATCH)
+            {
+                ys = y;
+                uint64_t batch = (r - k < RHO_BATCH) ? r - k : RHO_BATCH;
+                for (uint64_t i = 0; i < batch; i++)
+                {
+                    y = m64_add(m64_mul(y, y, &M), cm, n);
+                    q = m64_mul(q, m64_sub(x, y, n), &M);
+                }
+                steps += batch;
+                g = gcd_u64(q, n);
+            }
+        }
+        // The batch overshot: step again from its start one gcd at a time
+        if (g == n)
+        {
+            do
+            {
+                ys = m64_add(m64_mul(ys, ys, &M), cm, n);
+                g = gcd_u64(m64_sub(x, ys, n), n);
+            } while (g == 1);
+        }
+        if (g > 1 && g < n)
+            return g;
+    }
+    return 0;
+}
+
+// floor(sqrt(x)) for 128-bit x
+static uint64_t isqrt_u128(u128 x)
+{
+    uint64_t r = (uint64_t)sqrtl((long double)x);
+    while ((u128)r * r > x)
+        r--;
+    while ((u128)(r + 1) * (r + 1) <= x)
+        r++;
+    return r;
+}
+
+// Returns sqrt(x) if x is a perfect square, otherwise 0
+static uint64_t square_root_exact(uint64_t x)
+{
+    // Squares mod 64 can only end in these residues
+    if (!((0x0202021202030213ULL >> (x & 63)) & 1))
+        return 0;
+    uint64_t r = isqrt_u128(x);
+    return (r * r == x) ? r : 0;
+}
+
+// Gower & Wagstaff's square-free multipliers, products of 3, 5, 7, 11
+static const uint32_t squfof_multipliers[] = {
+    1, 3, 5, 7, 11, 3 * 5, 3 * 7, 3 * 11, 5 * 7, 5 * 11, 7 * 11,
+    3 * 5 * 7, 3 * 5 * 11, 3 * 7 * 11, 5 * 7 * 11, 3 * 5 * 7 * 11
+};
+#define SQUFOF_MULTIPLIERS (int)(sizeof(squfof_multipliers) / sizeof(squfof_multipliers[0]))
+
+typedef struct {
+    u128 N;              // k * n
+    int64_t P0;          // floor(sqrt(N))
+    int64_t P, Q, Qprev; // current form
+    uint64_t step;
+    uint64_t limit;
+    int active;
+} SquareForm;
+
+static void form_init(SquareForm *f, uint64_t n, uint32_t k)
+{
+    f->N = (u128)n * k;
+    f->P0 = (int64_t)isqrt_u128(f->N);
+    f->P = f->P0;
+    f->Qprev = 1;
+    f->Q = (int64_t)(f->N - (u128)f->P0 * f->P0);
+    f->step = 1;
+    // Expected cycle length is O(N^1/4); allow a generous multiple of it
+    f->limit = 4 * (uint64_t)(2.0 * sqrt(2.0 * sqrt((double)f->N)));
+    f->active = (f->Q != 0);
+}
+
+// Reverse cycle from the square form found at Q = r^2; a factor of n, maybe trivial
+static uint64_t reverse_cycle(const SquareForm *f, int64_t r, uint64_t n)
+{
+    int64_t b = (f->P0 - f->P) / r;
+    int64_t P = b * r + f->P;
+    int64_t Qprev = r;
+    int64_t Q = (int64_t)((f->N - (u128)((i128)P * P)) / (uint64_t)Qprev);
+    int64_t Pprev;
+    
+    do
+    {
+        b = (f->P0 + P) / Q;
+        Pprev = P;
+        P = b * Q - P;
+        int64_t Qnext = Qprev + b * (Pprev - P);
+        Qprev = Q;
+        Q = Qnext;
+    } while (P != Pprev);
+    
+    return gcd_u64(n, (uint64_t)P);
+}
+
+// Up to `steps` forward iterations; a proper factor of n or 0
+static uint64_t form_advance(SquareForm *f, uint64_t n, int steps)
+{
+    for (int s = 0; s < steps && f->active; s++)
+    {
+        if (f->step >= f->limit)
+        {
+            f->active = 0;
+            break;
+        }
+        int64_t b = (f->P0 + f->P) / f->Q;
+        int64_t Pnext = b * f->Q - f->P;
+        int64_t Qnext = f->Qprev + b * (f->P - Pnext);
+        f->Qprev = f->Q;
+        f->Q = Qnext;
+        f->P = Pnext;
+        f->step++;
+        
+        // Only forms at even positions are proper squares
+        if (f->step & 1)
+            continue;
+        int64_t r = (int64_t)square_root_exact((uint64_t)f->Q);
+        if (r == 0)
+            continue;
+        uint64_t d = reverse_cycle(f, r, n);
+        if (d > 1 && d < n)
+            return d;
+    }
+    return 0;
+}
+
+// SQUFOF with the multipliers racing round-robin (odd n < 2^62, not a square); a factor or 0
+static uint64_t squfof_u64(uint64_t n)
+{
+    uint64_t root = square_root_exact(n);
+    if (root)
+        return root;
+    
+    SquareForm forms[SQUFOF_MULTIPLIERS];
+    int live = 0;
+    for (int i = 0; i < SQUFOF_MULTIPLIERS; i++)
+    {
+        uint64_t g = gcd_u64(n, squfof_multipliers[i]);
+        if (g > 1 && g < n)
+            return g;
+        form_init(&forms[i], n, squfof_multipliers[i]);
+        live += forms[i].active;
+    }
+    while (live > 0)
+    {
+        live = 0;
+        for (int i = 0; i < SQUFOF_MULTIPLIERS; i++)
+        {
+            if (!forms[i].active)
+                continue;
+            uint64_t d = form_advance(&forms[i], n, SQUFOF_SLICE);
+            if (d)
+                return d;
+            live += forms[i].active;
+        }
+    }
+    return 0;
+}
+
+typedef struct {
+    uint64_t x, z;
+} CurvePoint;
+
+// [2]P, with a24 = (A + 2) / 4
+static void curve_double(CurvePoint *r, const CurvePoint *p, uint64_t a24, const Mont64 *M)
+{
+    uint64_t s = m64_add(p->x, p->z, M->n);
+    uint64_t d = m64_sub(p->x, p->z, M->n);
+    uint64_t t1 = m64_mul(s, s, M);
+    uint64_t t2 = m64_mul(d, d, M);
+    uint64_t t3 = m64_sub(t1, t2, M->n);
+    r->x = m64_mul(t1, t2, M);
+    r->z = m64_mul(t3, m64_add(t2, m64_mul(a24, t3, M), M->n), M);
+}
+
+// P + Q given P - Q
+static void curve_add(CurvePoint *r, const CurvePoint *p, const CurvePoint *q, const CurvePoint *diff, const Mont64 *M)
+{
+    uint64_t u = m64_mul(m64_sub(p->x, p->z, M->n), m64_add(q->x, q->z, M->n), M);
+    uint64_t v = m64_mul(m64_add(p->x, p->z, M->n), m64_sub(q->x, q->z, M->n), M);
+    uint64_t s = m64_add(u, v, M->n);
+    uint64_t d = m64_sub(u, v, M->n);
+    uint64_t x = m64_mul(diff->z, m64_mul(s, s, M), M);
+    uint64_t z = m64_mul(diff->x, m64_mul(d, d, M), M);
+    r->x = x;
+    r->z = z;
+}
+
+// Montgomery ladder: [k]P
+static void curve_ladder(CurvePoint *r, const CurvePoint *p, uint64_t k, uint64_t a24, const Mont64 *M)
+{
+    CurvePoint r0 = *p, r1;
+    curve_double(&r1, p, a24, M);
+    for (int i = 62 - __builtin_clzll(k); i >= 0; i--)
+    {
+        if ((k >> i) & 1)
+        {
+            curve_add(&r0, &r1, &r0, p, M);
+            curve_double(&r1, &r1, a24, M);
+        }
+        else
+        {
+            curve_add(&r1, &r1, &r0, p, M);
+            curve_double(&r0, &r0, a24, M);
+        }
+    }
+    *r = r0;
+}
+
+/*
+ * Stage 1 of ECM with B1 = ECM_B1 on Suyama curves sigma = 6, 7, ...
+ * (u = sigma^2 - 5, v = 4 sigma, x0 = u^3, z0 = v^3,
+ * a24 = (v - u)^3 (3u + v) / (16 u^3 v)); a factor or 0.
+ */
+static uint64_t ecm_tiny_u64(uint64_t n)
+{
+    static const uint8_t ecm_primes[] = {
+        2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37, 41, 43, 47, 53, 59, 61, 67, 71, 73, 79, 83, 89, 97,
+        101, 103, 107, 109, 113, 127, 131, 137, 139, 149, 0
+    };
+    Mont64 M;
+    m64_init(&M, n);
+    for (uint64_t sigma = 6; sigma < 6 + ECM_CURVES; sigma++)
+    {
+        uint64_t s = m64_to(sigma, &M);
+        uint64_t u = m64_sub(m64_mul(s, s, &M), m64_to(5, &M), n);
+        uint64_t v = m64_add(m64_add(s, s, n), m64_add(s, s, n), n);
+        uint64_t u3 = m64_mul(m64_mul(u, u, &M), u, &M);
+        uint64_t vmu = m64_sub(v, u, n);
+        uint64_t num = m64_mul(m64_mul(m64_mul(vmu, vmu, &M), vmu, &M),
+                               m64_add(m64_add(m64_add(u, u, n), u, n), v, n), &M);
+        uint64_t den = m64_from(m64_mul(m64_mul(m64_to(16, &M), u3, &M), v, &M), &M);
+        uint64_t g = gcd_u64(den, n);
+        if (g > 1 && g < n)
+            return g;
+        if (g != 1)
+            continue;
+        uint64_t a24 = m64_mul(num, m64_to((uint64_t)mod_inverse_u128(den, n), &M), &M);
+        CurvePoint P = {u3, m64_mul(m64_mul(v, v, &M), v, &M)};
+        
+        for (int i = 0; ecm_primes[i]; i++)
+        {
+            uint64_t p = ecm_primes[i], q = p;
+            while (q <= ECM_B1 / p)
+                q *= p;
+            curve_ladder(&P, &P, q, a24, &M);
+        }
+        g = gcd_u64(m64_from(P.z, &M), n);
+        if (g > 1 && g < n)
+            return g;
+    }
+    return 0;
+}
+
+/*
+ * Split cofactor c > 1 (no prime <= B) into at most max_primes primes
+ * <= lp_bound, stored in out. Returns how many, or -1 to refuse c.
+ */
+static int cofactor_split(uint64_t c, int max_primes, uint32_t out[2])
+{
+    if (max_primes < 1 || c > ((uint64_t)1 << cofactor_bits) || (c > lp_bound && max_primes < 2))
+        return -1;
+    if (is_prime_u64(c))
+    {
+        if (c > lp_bound)
+            return -1;
+        out[0] = (uint32_t)c;
+        return 1;
+    }
+    if (!cofactorize || max_primes < 2 || c / lp_bound > lp_bound)
+        return -1;
+    if (cofactor_log && cofactor_logged < cofactor_log_capacity)
+        cofactor_log[cofactor_logged++] = c;
+    
+    int engine;
+    uint64_t p = 0;
+    if (c % 2 == 0)
+    {
+        engine = COFAC_SPF;
+        p = 2;
+    }
+    else if (c < SPF_LIMIT && spf_init())
+    {
+        engine = COFAC_SPF;
+        p = spf_table[c];
+    }
+    else
+    {
+        engine = COFAC_RHO;
+        p = rho_brent_u64(c);
+    }
+    while (p == 0 && engine < COFAC_ECM)
+    {
+        cofac_stats.calls[engine++]++;
+        p = (engine == COFAC_RHO) ? rho_brent_u64(c) : (engine == COFAC_SQUFOF) ? squfof_u64(c) : ecm_tiny_u64(c);
+    }
+    cofac_stats.calls[engine]++;
+    if (p <= 1 || p >= c)
+        return -1;
+    cofac_stats.splits[engine]++;
+    
+    uint64_t q = c / p;
+    if (p > q)
+    {
+        uint64_t t = p;
+        p = q;
+        q = t;
+    }
+    if (q > lp_bound || !is_prime_u64(p) || !is_prime_u64(q))
+        return -1;
+    out[0] = (uint32_t)p;
+    out[1] = (uint32_t)q;
+    return 2;
+}
+
+// ============ SNFS core ============
+
+// Divide p out of *value as often as it goes; returns how often
+static inline uint32_t divide_out(u128 *value, uint32_t p)
+{
+    uint32_t e = 0;
+    if (!(*value >> 64))
+    {
+        uint64_t v = (uint64_t)*value;   // 64-bit division where it fits
+        while (v % p == 0)
+        {
+            v /= p;
+            e++;
+        }
+        *value = v;
+        return e;
+    }
+    while (*value % p == 0)
+    {
+        *value /= p;
+        e++;
+    }
+    return e;
+}
+
+/*
+ * Appends (index, exponent) for each prime dividing value; *count gets how
+ * many. With a resieved divisor list, only primes below resieve_first and
+ * the list's rational entries are tried. The cofactor may split into up
+ * to `large` large primes, which are appended to rel's with the rational
+ * marker LP_NONE as their root.
+ */
+static int factor_with_fb(u128 value, const uint32_t *primes, int fb_size, const uint32_t *divs, uint32_t ndivs, int large,
+                          uint16_t *count, Relation *rel)
+{
+    *count = 0;
+    int trial = (divs && resieve_first < fb_size) ? resieve_first : fb_size;
+    for (int i = 0; i < trial; i++)
+    {
+        uint32_t e = divide_out(&value, primes[i]);
+        if (!e)
+            continue;
+        if (!factors_push(i, e))
+            return 0;
+        (*count)++;
+    }
+    for (uint32_t d = 0; d < ndivs; d++)
+    {
+        if (divs[d] & RESIEVE_SIDE_A)
+            continue;
+        uint32_t i = divs[d] >> 1;
+        uint32_t e = divide_out(&value, primes[i]);
+        if (!e)
+            continue;   // already divided out
+        if (!factors_push(i, e))
+            return 0;
+        (*count)++;
+    }
+    if (value == 1)
+        return 1;
+    
+    uint32_t lp[2];
+    int k = (value >> 64) ? -1 : cofactor_split((uint64_t)value, large, lp);
+    if (k < 0)
+        return 0;
+    for (int j = 0; j < k; j++)
+    {
+        int slot = (rel->lp[0] != 0);
+        rel->lp[slot] = lp[j];
+        rel->lp_root[slot] = LP_NONE;
+    }
+    return 1;
+}
+
+// Divide job_primes[k] out of *norm and append its ideal above (a, b), if it divides
+static inline int divide_ideal(u128 *norm, uint32_t k, int64_t a, int64_t b, uint16_t *count)
+{
+    uint32_t e = divide_out(norm, job_primes[k]);
+    if (!e)
+        return 1;   // not a divisor, or already divided out
+    int t = alg_ideal_of(k, a, b);
+    if (t < 0 || !factors_push(t, e))
+        return 0;
+    (*count)++;
+    return 1;
+}
+
+/*
+ * Algebraic side: appends (ideal, exponent) for each ideal of alg_fb that
+ * norm = |F(a, b)| is divisible by, trying the primes as factor_with_fb
+ * does. The cofactor may split into up to `large` large primes q, kept as
+ * the ideals (q, a / b mod q) in rel.
+ */
+static int factor_algebraic(u128 norm, int64_t a, int64_t b, const uint32_t *divs, uint32_t ndivs, int large,
+                            uint16_t *count, Relation *rel)
+{
+    *count = 0;
+    int trial = (divs && resieve_first < alg_fb.prime_count) ? resieve_first : alg_fb.prime_count;
+    for (int k = 0; k < trial; k++)
+        if (!divide_ideal(&norm, k, a, b, count))
+            return 0;
+    for (uint32_t d = 0; d < ndivs; d++)
+        if ((divs[d] & RESIEVE_SIDE_A) && !divide_ideal(&norm, divs[d] >> 1, a, b, count))
+            return 0;
+    if (norm == 1)
+        return 1;
+    
+    uint32_t lp[2];
+    int k = (norm >> 64) ? -1 : cofactor_split((uint64_t)norm, large, lp);
+    if (k < 0)
+        return 0;
+    for (int j = 0; j < k; j++)
+    {
+        uint32_t r = ratio_mod(a, b, lp[j]);
+        if (r == lp[j])
+            return 0;   // projective: q | b
+        rel->lp[j] = lp[j];
+        rel->lp_root[j] = r;
+    }
+    return 1;
+}
+
+/*
+ * Factor both sides of (a, b) into rel, with at most large_prime_max
+ * large primes between them. hit is (a, b)'s index among the last
+ * block's survivors, whose resieved divisors stand in for trial division,
+ * or -1. If a side fails, the factor list is put back. Returns 1 for a
+ * full or partial relation.
+ */
+static int factor_pair(int64_t a, int64_t b, const SnfsPoly *f, const uint32_t *primes, int fb_size, int hit, Relation *rel)
+{
+    uint64_t abs_a = (a < 0) ? -(uint64_t)a : (uint64_t)a;
+    if (poly_coef_bits(f) + f->degree * bit_length_u128((abs_a > (uint64_t)b) ? abs_a : (uint64_t)b) > 125)
+        return 0;
+    
+    // F(a, b) = c_d a^d + c_0 b^d, each term below 2^125
+    i128 ad = (i128)pow_u128(abs_a, f->degree) * f->cd, bd = (i128)pow_u128((uint64_t)b, f->degree) * f->c0;
+    if (a < 0 && f->degree % 2 == 1)
+        ad = -ad;
+    i128 F = ad + bd;
+    int norm_neg = (F < 0);
+    u128 norm = norm_neg ? (u128)(-F) : (u128)F;
+    i128 r = (i128)a - (i128)b * (i128)f->m;
+    u128 rational = (r < 0) ? (u128)(-r) : (u128)r;
+    if (norm == 0 || rational == 0)
+        return 0;
+    
+    const uint32_t *divs = NULL;
+    uint32_t ndivs = 0;
+    if (hit >= 0 && hit < resieved_hits)
+    {
+        divs = hit_divisors + hit_first[hit];
+        ndivs = hit_first[hit + 1] - hit_first[hit];
+    }
+    
+    rel->first = factors_used;
+    rel->lp[0] = rel->lp[1] = 0;
+    if (!factor_algebraic(norm, a, b, divs, ndivs, large_prime_max, &rel->a_count, rel) ||
+        !factor_with_fb(rational, primes, fb_size, divs, ndivs, large_prime_max - (rel->lp[0] != 0) - (rel->lp[1] != 0),
+                        &rel->r_count, rel))
+    {
+        factors_used = rel->first;
+        return 0;
+    }
+    rel->a = a;
+    rel->b = b;
+    rel->r_sign = (r < 0);
+    rel->a_sign = (uint8_t)norm_neg;
+    return 1;
+}
+
+static int compare_u32(const void *x, const void *y)
+{
+    uint32_t a = *(const uint32_t *)x, b = *(const uint32_t *)y;
+    return (a > b) - (a < b);
+}
+
+// Multiply acc by q^(k / 2) for each run of k equal primes in the sorted list
+static u128 square_root_of_list(u128 acc, uint32_t *list, uint32_t len, u128 n)
+{
+    qsort(list, len, sizeof(uint32_t), compare_u32);
+    for (uint32_t i = 0, j; i < len; i = j)
+    {
+        for (j = i; j < len && list[j] == list[i]; j++)
+            ;
+        acc = mul_mod(acc, pow_mod(list[i], (j - i) / 2, n), n);
+    }
+    return acc;
+}
+
+// Build dependency -> compute square congruence
+static u128 attempt_dependency(uint32_t *primes, int fb_size, u128 n)
+{
+    uint32_t *total_a = dep_totals, *total_r = dep_totals + alg_fb.ideal_count;
+    memset(total_a, 0, alg_fb.ideal_count * sizeof(uint32_t));
+    memset(total_r, 0, fb_size * sizeof(uint32_t));
+    
+    // Large primes come in pairs over a dependency; collect them to halve
+    uint32_t members = 0;
+    for (uint32_t k = 0; k < unit_count; k++)
+        if (dep_mask[k / 64] & ((uint64_t)1 << (k % 64)))
+            members += unit_first[k + 1] - unit_first[k];
+    uint32_t *lp_list = malloc(4 * (members + 1) * sizeof(uint32_t));
+    if (!lp_list)
+        return 0;
+    uint32_t *lp_alg = lp_list + 2 * (members + 1), lp_r_count = 0, lp_a_count = 0;
+    
+    for (uint32_t k = 0; k < unit_count; k++)
+    {
+        if (!(dep_mask[k / 64] & ((uint64_t)1 << (k % 64))))
+            continue;
+        for (uint32_t m = unit_first[k]; m < unit_first[k + 1]; m++)
+        {
+            const Relation *rel = &relations[unit_members[m]];
+            const PrimePower *f = &factors[rel->first];
+            for (int j = 0; j < rel->a_count; j++)
+                total_a[f[j].index] += f[j].exp;
+            for (int j = rel->a_count; j < rel->a_count + rel->r_count; j++)
+                total_r[f[j].index] += f[j].exp;
+            for (int t = 0; t < 2 && rel->lp[t]; t++)
+            {
+                if (rel->lp_root[t] == LP_NONE)
+                    lp_list[lp_r_count++] = rel->lp[t];
+                else
+                    lp_alg[lp_a_count++] = rel->lp[t];
+            }
+        }
+    }
+    
+    u128 x = 1;
+    u128 y = 1;
+    for (int j = 0; j < fb_size; j++)
+    {
+        if (total_r[j])
+        {
+            u128 exp = total_r[j] / 2;
+            x = mul_mod(x, pow_mod(primes[j], exp, n), n);
+        }
+    }
+    x = square_root_of_list(x, lp_list, lp_r_count, n);
+    // Stand-in for the algebraic square root: the norms of the ideals
+    for (int j = 0; j < alg_fb.ideal_count; j++)
+    {
+        if (total_a[j])
+        {
+            u128 exp = total_a[j] / 2;
+            y = mul_mod(y, pow_mod(alg_fb.p[j], exp, n), n);
+        }
+    }
+    y = square_root_of_list(y, lp_alg, lp_a_count, n);
+    free(lp_list);
+    
+    u128 diff = (x > y) ? (x - y) : (y - x);
+    u128 g = gcd_u128(diff, n);
+    if (g > 1 && g < n)
+        return g;
+    
+    u128 sum = x + y;
+    if (sum >= n)
+        sum -= n;
+    g = gcd_u128(sum, n);
+    if (g > 1 && g < n)
+        return g;
+    
+    return 0;
+}
+
+// ============ Fallback: simple Pollard rho for u128 (educational only) ============
+
+#define RHO_ATTEMPTS 5               // c = 1, 3, 5, 7, 9
+#define RHO_STEPS 200000             // steps per c
+#define GCD_BATCH 128                // |x - y| values multiplied per gcd
+#define CLOCK_CHECK_MASK 0x3FFF      // look at the clock every 16384 steps
+#define CHECKPOINT_MIN_SECONDS 10.0
+#define CHECKPOINT_OVERHEAD 1000.0   // wait >= 1000x the last write: < 0.1% overhead
+#define CHECKPOINT_MAGIC "RHO128C2"
+#define RHO_HINTED_START 0x9E3779B97F4A7C15ULL   // arbitrary; not a small power
+
+typedef struct {
+    u128 n;
+    u128 x, y;              // tortoise and hare
+    u128 c;                 // f(x) = x^power + c
+    u128 q;                 // product of |x - y| since the last gcd
+    uint64_t iteration;     // steps taken with the current c
+    uint64_t total;         // steps over all c
+    uint32_t attempt;       // which c we are on
+    uint32_t power;         // 2, or the hint modulus k when every p == 1 (mod k)
+} RhoState128;
+
+typedef struct {
+    char magic[8];
+    RhoState128 state;
+} RhoCheckpoint128;
+
+static double wall_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Write to FILE.tmp, fsync, then rename over FILE so a crash never leaves a torn file
+static int save_rho_checkpoint(const char *path, const RhoState128 *s)
+{
+    char tmp[1024];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    FILE *fp = fopen(tmp, "wb");
+    if (!fp)
+        return 0;
+    
+    RhoCheckpoint128 ck;
+    memset(&ck, 0, sizeof(ck));
+    memcpy(ck.magic, CHECKPOINT_MAGIC, sizeof(ck.magic));
+    ck.state = *s;
+    int ok = fwrite(&ck, sizeof(ck), 1, fp) == 1 && fflush(fp) == 0 && fsync(fileno(fp)) == 0;
+    ok = (fclose(fp) == 0) && ok;
+    return ok && rename(tmp, path) == 0;
+}
+
+static int load_rho_checkpoint(const char *path, RhoState128 *s)
+{
+    FILE *fp = fopen(path, "rb");
+    if (!fp)
+        return 0;
+    RhoCheckpoint128 ck;
+    int ok = fread(&ck, sizeof(ck), 1, fp) == 1 &&
+             memcmp(ck.magic, CHECKPOINT_MAGIC, sizeof(ck.magic)) == 0;
+    fclose(fp);
+    if (ok)
+        *s = ck.state;
+    return ok;
+}
+
+static void rho_start_attempt(RhoState128 *s, uint32_t attempt)
+{
+    // x^k + c with k = 2d sends m, and any power of it, to 1 + c: a start
+    // of 2 is a fixed point for 2^d +- 1. Hinted walks start elsewhere.
+    u128 start = (s->power == 2) ? 2 : RHO_HINTED_START % s->n;
+    s->attempt = attempt;
+    s->c = 1 + 2 * (u128)attempt;
+    s->x = start;
+    s->y = start;
+    s->q = 1;
+    s->iteration = 0;
+}
+
+static void rho_init_u128(RhoState128 *s, u128 n, uint32_t power)
+{
+    s->n = n;
+    s->power = (power >= 2) ? power : 2;
+    s->total = 0;
+    rho_start_attempt(s, 0);
+}
+
+/*
+ * x^power + c. With p == 1 (mod k), x -> x^k maps the p - 1 units onto
+ * (p - 1) / k values, so the walk on x^k + c collides about sqrt(k - 1)
+ * times sooner, for log2(k) times the multiplies per step.
+ */
+static inline u128 rho_func(u128 x, u128 c, uint32_t power, const ModCtx *M)
+{
+    if (power == 2)
+        return mod_add(mod_mul(x, x, M), c, M);
+    int top = 31 - __builtin_clz(power);
+    u128 r = x;
+    for (int b = top - 1; b >= 0; b--)
+    {
+        r = mod_mul(r, r, M);
+        if ((power >> b) & 1)
+            r = mod_mul(r, x, M);
+    }
+    return mod_add(r, c, M);
+}
+
+/*
+ * Floyd walk with the gcd batched over GCD_BATCH steps (one u128 gcd costs
+ * far more than the extra multiply). A batch that overshoots to gcd = n is
+ * replayed step by step. The walk runs in Montgomery form (xR is the same
+ * sequence as x, and R is a unit, so gcds are unchanged); the state in *s
+ * and in checkpoints stays in plain form. State is checkpointed at batch
+ * boundaries when checkpoint_path is set.
+ */
+static u128 pollard_rho_u128_walk(RhoState128 *s, const char *checkpoint_path)
+{
+    u128 n = s->n;
+    if ((n & 1) == 0)
+        return 2;
+    ModCtx M = *mod_ctx(n);   // private copy: the cache is keyed on the last modulus used
+    double next_checkpoint = wall_seconds() + CHECKPOINT_MIN_SECONDS;
+    
+    for (; s->attempt < RHO_ATTEMPTS; rho_start_attempt(s, s->attempt + 1))
+    {
+        u128 x = mod_to(s->x, &M), y = mod_to(s->y, &M);
+        u128 c = mod_to(s->c, &M), q = mod_to(s->q, &M);
+        u128 one = mod_to(1, &M);
+        
+        while (s->iteration < RHO_STEPS)
+        {
+            u128 x0 = x, y0 = y;
+            for (int i = 0; i < GCD_BATCH; i++)
+            {
+                x = rho_func(x, c, s->power, &M);
+                y = rho_func(rho_func(y, c, s->power, &M), c, s->power, &M);
+                u128 diff = (x > y) ? (x - y) : (y - x);
+                q = mod_mul(q, diff, &M);
+            }
+            s->iteration += GCD_BATCH;
+            s->total += GCD_BATCH;
+            
+            u128 d = gcd_u128(q, n);
+            if (d == 1)
+            {
+                q = one;
+                if (checkpoint_path && (s->iteration & CLOCK_CHECK_MASK) == 0 &&
+                    wall_seconds() >= next_checkpoint)
+                {
+                    s->x = mod_from(x, &M);
+                    s->y = mod_from(y, &M);
+                    s->q = 1;
+                    double start = wall_seconds();
+                    if (!save_rho_checkpoint(checkpoint_path, s))
+                        fprintf(stderr, "Warning: could not write checkpoint %s\n", checkpoint_path);
+                    double wait = (wall_seconds() - start) * CHECKPOINT_OVERHEAD;
+                    next_checkpoint = wall_seconds() + ((wait > CHECKPOINT_MIN_SECONDS) ? wait : CHECKPOINT_MIN_SECONDS);
+                }
+                continue;
+            }
+            
+            // Replay the batch one gcd per step
+            x = x0;
+            y = y0;
+            for (int i = 0; i < GCD_BATCH; i++)
+            {
+                x = rho_func(x, c, s->power, &M);
+                y = rho_func(rho_func(y, c, s->power, &M), c, s->power, &M);
+                u128 diff = (x > y) ? (x - y) : (y - x);
+                d = gcd_u128(diff, n);
+                if (d > 1 && d < n)
+                    return d;
+                if (d == n)
+                    break;
+            }
+            break;   // cycle closed without a split: next c
+        }
+    }
+    return 0;
+}
+
+static u128 pollard_rho_u128(u128 n)
+{
+    RhoState128 s;
+    rho_init_u128(&s, n, 2);
+    return pollard_rho_u128_walk(&s, NULL);
+}
+
+// ============ Fallback: factor hints, hinted trial division and p - 1 ============
+
+#define TD_CANDIDATES (1 << 16)   // trial divisions per run, hinted or not
+#define PM1_B1 100000             // p - 1 stage 1 bound
+
+typedef struct {
+    uint32_t modulus;    // every odd prime p | n has p == 1 (mod modulus); 2 = nothing known
+    u128 algebraic;      // proper factor read off the form, or 0
+} FactorHint;
+
+/*
+ * What the special form tells us before any search. For n = m^d + 1 each
+ * odd prime q | d gives the algebraic factor m^(d/q) + 1, and for
+ * n = m^d - 1 each prime q | d gives m^(d/q) - 1. When none exists (d a
+ * power of two for +1; m = 2 and d prime for -1) every prime factor p
+ * has multiplicative order 2d, resp. d, of m, hence p == 1 (mod 2d).
+ */
+static FactorHint hint_from_form(u128 n, const SpecialForm *sf)
+{
+    FactorHint h = {2, 0};
+    if (!sf || sf->c != 1)
+        return h;
+    
+    int d = sf->d, rest = d;
+    for (int q = 2; q <= rest; q++)
+    {
+        if (rest % q)
+            continue;
+        while (rest % q == 0)
+            rest /= q;
+        if (sf->sign > 0 && q == 2)
+            continue;   // m^(d/2) + 1 does not divide m^d + 1
+        u128 v = pow_u128_checked(sf->m, d / q);
+        u128 g = gcd_u128(n, (sf->sign > 0) ? v + 1 : v - 1);
+        if (g > 1 && g < n)
+        {
+            h.algebraic = g;
+            return h;
+        }
+    }
+    h.modulus = 2 * (uint32_t)d;
+    return h;
+}
+
+/*
+ * Trial division by the first TD_CANDIDATES numbers p == 1 (mod k), or
+ * by odd numbers when k = 2, so a hint of k = 16 reaches 8x further for
+ * the same number of divisions. Returns the factor, or 0 with *bound set
+ * to the last candidate tried.
+ */
+static u128 trial_divide_hinted(u128 n, uint32_t k, uint64_t *bound)
+{
+    if ((n & 1) == 0)
+        return 2;
+    uint64_t p = (k == 2) ? 3 : 1 + (uint64_t)k;
+    for (int i = 0; i < TD_CANDIDATES; i++, p += k)
+    {
+        if ((u128)p * p > n)
+            break;
+        if (n % p == 0)
+            return p;
+    }
+    *bound = p - k;
+    return 0;
+}
+
+/*
+ * Pollard p - 1, stage 1: a = 3^(k E) with E = prod q^floor(log_q B1)
+ * over primes q <= B1 and k the hint modulus. Finds p when (p - 1) / k
+ * is B1-powersmooth. Powers of two up to B1 are in E already, so k only
+ * adds something when it carries an odd prime or a 2-power above B1.
+ */
+static u128 pm1_u128(u128 n, uint32_t B1, uint32_t k)
+{
+    if ((n & 1) == 0)
+        return 2;
+    char *composite = calloc(B1 + 1, 1);
+    if (!composite)
+        return 0;
+    
+    u128 a = pow_mod(3, k, n);
+    for (uint32_t q = 2; q <= B1; q++)
+    {
+        if (composite[q])
+            continue;
+        for (uint64_t j = (uint64_t)q * q; j <= B1; j += q)
+            composite[j] = 1;
+        uint64_t qe = q;
+        while (qe <= B1 / q)
+            qe *= q;
+        a = pow_mod(a, qe, n);
+    }
+    free(composite);
+    
+    u128 g = gcd_u128((a + n - 1) % n, n);
+    return (g > 1 && g < n) ? g : 0;
+}
+
+// ============ Block Lanczos ============
+
+/*
+ * Montgomery's block Lanczos over GF(2), 64 vectors at a time. The
+ * matrix M has a row per unit and a column per live prime or ideal, and
+ * a dependency is a block x of rows with M^T x = 0. The iteration runs on
+ * the symmetric A = M M^T: from a random block Y it solves A X = A Y, so
+ * that X - Y lies in the null space of A. Combining that with the last
+ * Lanczos block, against their images under M^T, gives up to 64 null
+ * vectors of M^T. Each step is one sparse product with A, a gather per
+ * column (M^T) and then a gather per row (M), plus a few passes of
+ * 64 x 64 block products over n words; la_threads workers split every
+ * pass by rows or columns.
+ */
+
+#define MAX_THREADS 256
+#define LANCZOS_MIN_ROWS 256       // smaller matrices go to Gaussian elimination
+#define LANCZOS_TRIES 3            // random starts before giving up
+
+typedef struct {
+    uint32_t rows, cols;
+    const uint32_t *row_first, *row_cols;   // row r: columns row_cols[row_first[r] ..]
+    uint32_t *col_first, *col_rows;         // column c: rows col_rows[col_first[c] ..]
+} SparseMatrix;
+
+static int la_threads = 1;         // --threads; the CLI defaults to every core
+static uint32_t lanczos_rows = LANCZOS_MIN_ROWS;   // UINT32_MAX: always Gaussian (--bench-filter, --bench-lanczos)
+
+static int default_threads(void)
+{
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cpus < 1)
+        return 1;
+    return (cpus > MAX_THREADS) ? MAX_THREADS : (int)cpus;
+}
+
+// Fill in the column view of a matrix given by rows; 0 when out of memory
+static int sparse_transpose(SparseMatrix *M)
+{
+    uint32_t nnz = M->row_first[M->rows];
+    M->col_first = calloc(M->cols + 1, sizeof(uint32_t));
+    M->col_rows = malloc((nnz + 1) * sizeof(uint32_t));
+    if (!M->col_first || !M->col_rows)
+        return 0;
+    for (uint32_t e = 0; e < nnz; e++)
+        M->col_first[M->row_cols[e] + 1]++;
+    for (uint32_t c = 0; c < M->cols; c++)
+        M->col_first[c + 1] += M->col_first[c];
+    for (uint32_t r = 0; r < M->rows; r++)
+        for (uint32_t e = M->row_first[r]; e < M->row_first[r + 1]; e++)
+            M->col_rows[M->col_first[M->row_cols[e]]++] = r;
+    for (uint32_t c = M->cols; c > 0; c--)
+        M->col_first[c] = M->col_first[c - 1];
+    M->col_first[0] = 0;
+    return 1;
+}
+
+static void sparse_free(SparseMatrix *M)
+{
+    free((void *)M->row_first);
+    free((void *)M->row_cols);
+    free(M->col_first);
+    free(M->col_rows);
+}
+
+/*
+ * Worker pool for the passes over n: the caller is worker 0, and each
+ * pass runs its job on a slice of the rows (or columns) per worker,
+ * between two barriers. The operands live in the pool.
+ */
+typedef struct {
+    void (*job)(int t);
+    int threads, stop;
+    pthread_barrier_t start, end;
+    pthread_t tid[MAX_THREADS];
+    const SparseMatrix *M;
+    const uint64_t *in, *y, *y2;
+    uint64_t *tmp, *out;
+    uint32_t n;
+    uint64_t tab[8][256];          // mul_nx64_64x64_acc: v m by byte of v
+    uint64_t (*part)[2][64];       // mul_64xn_nx64: x^T y per worker
+} LanczosPool;
+
+static LanczosPool la_pool;
+
+// Slice t of [0, total) for the pool's threads
+static void pool_slice(uint32_t total, int t, uint32_t *lo, uint32_t *hi)
+{
+    *lo = (uint32_t)((uint64_t)total * t / la_pool.threads);
+    *hi = (uint32_t)((uint64_t)total * (t + 1) / la_pool.threads);
+}
+
+static void *pool_worker(void *arg)
+{
+    int t = (int)(intptr_t)arg;
+    LanczosPool *P = &la_pool;
+    for (;;)
+    {
+        pthread_barrier_wait(&P->start);
+        if (P->stop)
+            return NULL;
+        P->job(t);
+        pthread_barrier_wait(&P->end);
+    }
+}
+
+static void pool_run(void (*job)(int t))
+{
+    LanczosPool *P = &la_pool;
+    P->job = job;
+    if (P->threads > 1)
+        pthread_barrier_wait(&P->start);
+    job(0);
+    if (P->threads > 1)
+        pthread_barrier_wait(&P->end);
+}
+
+static void pool_stop(void)
+{
+    LanczosPool *P = &la_pool;
+    if (P->threads > 1)
+    {
+        P->stop = 1;
+        pthread_barrier_wait(&P->start);
+        for (int t = 1; t < P->threads; t++)
+            pthread_join(P->tid[t], NULL);
+        pthread_barrier_destroy(&P->start);
+        pthread_barrier_destroy(&P->end);
+    }
+    free(P->part);
+    P->part = NULL;
+    P->threads = 1;
+}
+
+// Start threads - 1 workers (fewer if some fail to start); returns 0 when out of memory
+static int pool_start(const SparseMatrix *M, int threads)
+{
+    LanczosPool *P = &la_pool;
+    P->M = M;
+    P->stop = 0;
+    P->threads = (threads > 1) ? threads : 1;
+    P->part = malloc((size_t)P->threads * sizeof(*P->part));
+    if (!P->part)
+        return 0;
+    if (P->threads == 1)
+        return 1;
+    pthread_barrier_init(&P->start, NULL, P->threads);
+    pthread_barrier_init(&P->end, NULL, P->threads);
+    for (int t = 1; t < P->threads; t++)
+    {
+        if (pthread_create(&P->tid[t], NULL, pool_worker, (void *)(intptr_t)t) != 0)
+        {
+            // Stop those that started and go on alone
+            P->stop = 1;
+            for (int u = 1; u < t; u++)
+                pthread_barrier_wait(&P->start);
+            for (int u = 1; u < t; u++)
+                pthread_join(P->tid[u], NULL);
+            pthread_barrier_destroy(&P->start);
+            pthread_barrier_destroy(&P->end);
+            P->threads = 1;
+            P->stop = 0;
+            break;
+        }
+    }
+    return 1;
+}
+
+// y = A x in two passes: tmp = M^T in a column at a time, then out = M tmp a row at a time
+static void spmv_columns(int t)
+{
+    const LanczosPool *P = &la_pool;
+    const SparseMatrix *M = P->M;
+    uint32_t c0, c1;
+    pool_slice(M->cols, t, &c0, &c1);
+    for (uint32_t c = c0; c < c1; c++)
+    {
+        uint64_t acc = 0;
+        for (uint32_t e = M->col_first[c]; e < M->col_first[c + 1]; e++)
+            acc ^= P->in[M->col_rows[e]];
+        P->tmp[c] = acc;
+    }
+}
+
+static void spmv_rows(int t)
+{
+    const LanczosPool *P = &la_pool;
+    const SparseMatrix *M = P->M;
+    uint32_t r0, r1;
+    pool_slice(M->rows, t, &r0, &r1);
+    for (uint32_t r = r0; r < r1; r++)
+    {
+        uint64_t acc = 0;
+        for (uint32_t e = M->row_first[r]; e < M->row_first[r + 1]; e++)
+            acc ^= P->tmp[M->row_cols[e]];
+        P->out[r] = acc;
+    }
+}
+
+// out = A in, or only tmp = M^T in when out is NULL
+static void spmv(const uint64_t *in, uint64_t *tmp, uint64_t *out)
+{
+    la_pool.in = in;
+    la_pool.tmp = tmp;
+    la_pool.out = out;
+    pool_run(spmv_columns);
+    if (out)
+        pool_run(spmv_rows);
+}
+
+// c = a b for 64 x 64 blocks, row i of a as the bits of a[i]; c may be a or b
+static void mul_64x64(const uint64_t *a, const uint64_t *b, uint64_t *c)
+{
+    uint64_t t[64];
+    for (int i = 0; i < 64; i++)
+    {
+        uint64_t acc = 0;
+        for (uint64_t x = a[i]; x; x &= x - 1)
+            acc ^= b[__builtin_ctzll(x)];
+        t[i] = acc;
+    }
+    memcpy(c, t, sizeof(t));
+}
+
+static void mul_acc_job(int t)
+{
+    LanczosPool *P = &la_pool;
+    uint32_t r0, r1;
+    pool_slice(P->n, t, &r0, &r1);
+    for (uint32_t r = r0; r < r1; r++)
+    {
+        uint64_t x = P->in[r];
+        P->out[r] ^= P->tab[0][x & 255] ^ P->tab[1][(x >> 8) & 255] ^ P->tab[2][(x >> 16) & 255] ^
+                     P->tab[3][(x >> 24) & 255] ^ P->tab[4][(x >> 32) & 255] ^ P->tab[5][(x >> 40) & 255] ^
+                     P->tab[6][(x >> 48) & 255] ^ P->tab[7][x >> 56];
+    }
+}
+
+// y += v m for an n x 64 block v, through a 256-entry table per byte of v
+static void mul_nx64_64x64_acc(const uint64_t *v, const uint64_t *m, uint64_t *y, uint32_t n)
+{
+    LanczosPool *P = &la_pool;
+    for (int k = 0; k < 8; k++)
+    {
+        P->tab[k][0] = 0;
+        for (int b = 1; b < 256; b++)
+            P->tab[k][b] = P->tab[k][b & (b - 1)] ^ m[8 * k + __builtin_ctz(b)];
+    }
+    P->in = v;
+    P->out = y;
+    P->n = n;
+    pool_run(mul_acc_job);
+}
+
+// Sum y's rows into a table by each byte of x, then read x^T y off the table a bit at a time
+static void mul_64xn_job(int t)
+{
+    LanczosPool *P = &la_pool;
+    uint64_t tab[8][256][2];
+    uint32_t r0, r1;
+    pool_slice(P->n, t, &r0, &r1);
+    memset(tab, 0, sizeof(tab));
+    for (uint32_t r = r0; r < r1; r++)
+    {
+        uint64_t xr = P->in[r], yr = P->y[r], y2r = P->y2 ? P->y2[r] : 0;
+        for (int k = 0; k < 8; k++)
+        {
+            uint64_t *e = tab[k][(xr >> (8 * k)) & 255];
+            e[0] ^= yr;
+            e[1] ^= y2r;
+        }
+    }
+    for (int k = 0; k < 8; k++)
+    {
+        for (int i = 0; i < 8; i++)
+        {
+            uint64_t acc = 0, acc2 = 0;
+            for (int b = 1; b < 256; b++)
+            {
+                if (b >> i & 1)
+                {
+                    acc ^= tab[k][b][0];
+                    acc2 ^= tab[k][b][1];
+                }
+            }
+            P->part[t][0][8 * k + i] = acc;
+            P->part[t][1][8 * k + i] = acc2;
+        }
+    }
+}
+
+// c = x^T y for n x 64 blocks, and c2 = x^T y2 in the same pass unless y2 is NULL
+static void mul_64xn_nx64(const uint64_t *x, const uint64_t *y, uint64_t *c, const uint64_t *y2, uint64_t *c2, uint32_t n)
+{
+    LanczosPool *P = &la_pool;
+    P->in = x;
+    P->y = y;
+    P->y2 = y2;
+    P->n = n;
+    pool_run(mul_64xn_job);
+    for (int i = 0; i < 64; i++)
+    {
+        uint64_t acc = 0, acc2 = 0;
+        for (int t = 0; t < P->threads; t++)
+        {
+            acc ^= P->part[t][0][i];
+            acc2 ^= P->part[t][1][i];
+        }
+        c[i] = acc;
+        if (c2)
+            c2[i] = acc2;
+    }
+}
+
+/*
+ * Pick the columns S of this block that make S^T t S invertible, taking
+ * every column the last block left out, and put that inverse in w (zero
+ * outside S). Gauss-Jordan on [t | I], as in Montgomery's paper. Returns
+ * |S| with S in s[0 ..], or 0 when the iteration broke down.
+ */
+static int lanczos_choose(const uint64_t *t, int *s, const int *last_s, int last_dim, uint64_t *w)
+{
+    uint64_t m[64][2], mask = 0;
+    for (int i = 0; i < 64; i++)
+    {
+        m[i][0] = t[i];
+        m[i][1] = (uint64_t)1 << i;
+    }
+    // Columns not in last_s first, last_s at the back
+    for (int i = 0; i < last_dim; i++)
+    {
+        mask |= (uint64_t)1 << last_s[i];
+        s[63 - i] = last_s[i];
+    }
+    for (int i = 0, j = 0; i < 64; i++)
+        if (!(mask >> i & 1))
+            s[j++] = i;
+    
+    int dim = 0;
+    for (int i = 0; i < 64; i++)
+    {
+        uint64_t bit = (uint64_t)1 << s[i];
+        uint64_t *row = m[s[i]];
+        int half = 0, j;
+        for (j = i; j < 64 && !(m[s[j]][0] & bit); j++)
+            ;
+        if (j == 64)
+        {
+            // No pivot in t: use the identity half and drop the column
+            half = 1;
+            for (j = i; j < 64 && !(m[s[j]][1] & bit); j++)
+                ;
+            if (j == 64)
+                return 0;
+        }
+        uint64_t r0 = m[s[j]][0], r1 = m[s[j]][1];
+        m[s[j]][0] = row[0];
+        m[s[j]][1] = row[1];
+        row[0] = r0;
+        row[1] = r1;
+        for (j = 0; j < 64; j++)
+        {
+            if (m[s[j]] != row && (m[s[j]][half] & bit))
+            {
+                m[s[j]][0] ^= row[0];
+                m[s[j]][1] ^= row[1];
+            }
+        }
+        if (half)
+            row[0] = row[1] = 0;
+        else
+            s[dim++] = s[i];
+    }
+    for (int i = 0; i < 64; i++)
+        w[i] = m[i][1];
+    
+    // The recurrence needs every column in this block or the last
+    mask = 0;
+    for (int i = 0; i < dim; i++)
+        mask |= (uint64_t)1 << s[i];
+    for (int i = 0; i < last_dim; i++)
+        mask |= (uint64_t)1 << last_s[i];
+    return (mask == ~(uint64_t)0) ? dim : 0;
+}
+
+/*
+ * x and v are n x 64 blocks with images bx = M^T x and bv = M^T v. Find
+ * the combinations of their 128 columns whose image is zero: eliminate
+ * the 128 image vectors against each other, tracking which went into
+ * each. Writes the nonzero null vectors to deps as bit columns; returns
+ * how many (at most 64), or -1 when out of memory.
+ */
+static int lanczos_combine(const uint64_t *x, const uint64_t *v, const uint64_t *bx, const uint64_t *bv,
+                           uint32_t n, uint32_t cols, uint64_t *deps)
+{
+    uint32_t words = (cols + 63) / 64;
+    uint64_t *vec = calloc((size_t)128 * words, sizeof(uint64_t));
+    if (!vec)
+        return -1;
+    uint64_t combo[128][2];
+    int pivot[128];
+    for (uint32_t c = 0; c < cols; c++)
+    {
+        for (int j = 0; j < 64; j++)
+        {
+            vec[(size_t)j * words + c / 64] |= (bx[c] >> j & 1) << (c % 64);
+            vec[(size_t)(64 + j) * words + c / 64] |= (bv[c] >> j & 1) << (c % 64);
+        }
+    }
+    
+    int found = 0;
+    uint64_t kernel[64][2];
+    for (int j = 0; j < 128; j++)
+    {
+        uint64_t *row = vec + (size_t)j * words;
+        combo[j][0] = (j < 64) ? (uint64_t)1 << j : 0;
+        combo[j][1] = (j < 64) ? 0 : (uint64_t)1 << (j - 64);
+        for (int i = 0; i < j; i++)
+        {
+            if (pivot[i] < 0 || !(row[pivot[i] / 64] >> (pivot[i] % 64) & 1))
+                continue;
+            const uint64_t *prev = vec + (size_t)i * words;
+            for (uint32_t w = 0; w < words; w++)
+                row[w] ^= prev[w];
+            combo[j][0] ^= combo[i][0];
+            combo[j][1] ^= combo[i][1];
+        }
+        pivot[j] = -1;
+        for (uint32_t w = 0; w < words && pivot[j] < 0; w++)
+            if (row[w])
+                pivot[j] = (int)(w * 64 + __builtin_ctzll(row[w]));
+        if (pivot[j] < 0 && found < 64)
+        {
+            kernel[found][0] = combo[j][0];
+            kernel[found][1] = combo[j][1];
+            found++;
+        }
+    }
+    free(vec);
+    
+    // Apply the combinations; a combination may still give the zero vector
+    memset(deps, 0, n * sizeof(uint64_t));
+    int kept = 0;
+    for (int k = 0; k < found; k++)
+    {
+        uint64_t any = 0, bit = (uint64_t)1 << kept;
+        for (uint32_t r = 0; r < n; r++)
+        {
+            uint64_t b = (uint64_t)(__builtin_parityll(x[r] & kernel[k][0]) ^ __builtin_parityll(v[r] & kernel[k][1]));
+            deps[r] |= b ? bit : 0;
+            any |= b;
+        }
+        kept += (any != 0);
+    }
+    return kept;
+}
+
+/*
+ * Up to 64 null vectors of M^T, as bit columns of deps (n = M->rows
+ * words). Returns how many, 0 if every start broke down, -1 when out of
+ * memory; *iterations gets the Lanczos steps of the last start.
+ */
+static int block_lanczos(const SparseMatrix *M, int threads, uint64_t *deps, uint32_t *iterations)
+{
+    uint32_t n = M->rows;
+    uint64_t *mem = malloc(((size_t)6 * n + 2 * (size_t)M->cols + 1) * sizeof(uint64_t));
+    if (!mem)
+        return -1;
+    uint64_t *x = mem, *v0 = x + n, *v[3] = {v0 + n, v0 + 2 * n, v0 + 3 * n}, *vnext = v0 + 4 * n;
+    uint64_t *tmp = v0 + 5 * n, *tmp2 = tmp + M->cols;
+    if (!pool_start(M, threads))
+    {
+        free(mem);
+        return -1;
+    }
+    
+    int result = 0;
+    uint64_t seed = 0x9E3779B97F4A7C15ULL;
+    for (int attempt = 0; attempt < LANCZOS_TRIES && result == 0; attempt++)
+    {
+        // x starts at a random Y and collects X on top; v_0 = A Y
+        for (uint32_t r = 0; r < n; r++)
+        {
+            seed ^= seed << 13;
+            seed ^= seed >> 7;
+            seed ^= seed << 17;
+            x[r] = seed;
+        }
+        spmv(x, tmp, v[0]);
+        memcpy(v0, v[0], n * sizeof(uint64_t));
+        memset(v[1], 0, n * sizeof(uint64_t));
+        memset(v[2], 0, n * sizeof(uint64_t));
+        
+        uint64_t winv[3][64], vav[2][64], vaav[2][64], vt_v0[64], d[64], e[64], f[64], f2[64];
+        memset(winv, 0, sizeof(winv));
+        memset(vav, 0, sizeof(vav));
+        memset(vaav, 0, sizeof(vaav));
+        int s[2][64], dim0 = 0, dim1 = 64;
+        for (int i = 0; i < 64; i++)
+            s[1][i] = i;
+        uint64_t mask0 = 0, mask1 = ~(uint64_t)0;
+        uint32_t steps = 0, max_steps = n / 60 + 64;
+        int broke = 0;
+        
+        for (;;)
+        {
+            steps++;
+            spmv(v[0], tmp, vnext);
+            // v^T v_0 is wanted for X below; it shares the pass over v
+            mul_64xn_nx64(v[0], vnext, vav[0], v0, vt_v0, n);
+            mul_64xn_nx64(vnext, vnext, vaav[0], NULL, NULL, n);
+            uint64_t any = 0;
+            for (int i = 0; i < 64; i++)
+                any |= vav[0][i];
+            if (!any)
+                break;   // v^T A v = 0: the iteration has run its course
+            dim0 = lanczos_choose(vav[0], s[0], s[1], dim1, winv[0]);
+            if (dim0 == 0 || steps > max_steps)
+            {
+                broke = 1;
+                break;
+            }
+            mask0 = 0;
+            for (int i = 0; i < dim0; i++)
+                mask0 |= (uint64_t)1 << s[0][i];
+            
+            // D = I + Winv_i (v^T A^2 v S S^T + v^T A v)
+            for (int i = 0; i < 64; i++)
+                d[i] = (vaav[0][i] & mask0) ^ vav[0][i];
+            mul_64x64(winv[0], d, d);
+            for (int i = 0; i < 64; i++)
+                d[i] ^= (uint64_t)1 << i;
+            // E = Winv_(i-1) v^T A v S S^T
+            mul_64x64(winv[1], vav[0], e);
+            for (int i = 0; i < 64; i++)
+                e[i] &= mask0;
+            // F = Winv_(i-2) (I + v'A v' Winv_(i-1)) (v'^T A^2 v' S' S'^T + v'^T A v') S S^T
+            mul_64x64(vav[1], winv[1], f);
+            for (int i = 0; i < 64; i++)
+                f[i] ^= (uint64_t)1 << i;
+            mul_64x64(winv[2], f, f);
+            for (int i = 0; i < 64; i++)
+                f2[i] = ((vaav[1][i] & mask1) ^ vav[1][i]) & mask0;
+            mul_64x64(f, f2, f);
+            
+            // v_(i+1) = A v S S^T + v D + v' E + v'' F
+            for (uint32_t r = 0; r < n; r++)
+                vnext[r] &= mask0;
+            mul_nx64_64x64_acc(v[0], d, vnext, n);
+            mul_nx64_64x64_acc(v[1], e, vnext, n);
+            mul_nx64_64x64_acc(v[2], f, vnext, n);
+            
+            // X += v Winv v^T v_0
+            mul_64x64(winv[0], vt_v0, d);
+            mul_nx64_64x64_acc(v[0], d, x, n);
+            
+            uint64_t *old = v[2];
+            v[2] = v[1];
+            v[1] = v[0];
+            v[0] = vnext;
+            vnext = old;
+            memcpy(winv[2], winv[1], sizeof(winv[1]));
+            memcpy(winv[1], winv[0], sizeof(winv[0]));
+            memcpy(vav[1], vav[0], sizeof(vav[0]));
+            memcpy(vaav[1], vaav[0], sizeof(vaav[0]));
+            memcpy(s[1], s[0], sizeof(s[0]));
+            mask1 = mask0;
+            dim1 = dim0;
+        }
+        *iterations = steps;
+        if (broke)
+            continue;   // broke down: start again from another Y
+        
+        // x = X + Y = X - Y
+        spmv(x, tmp, NULL);
+        spmv(v[0], tmp2, NULL);
+        result = lanczos_combine(x, v[0], tmp, tmp2, n, M->cols, deps);
+    }
+    pool_stop();
+    free(mem);
+    return result;
+}
+
+// ============ Dense elimination (M4RI) ============
+
+/*
+ * The method of four Russians for matrices that still fit densely: the
+ * rows, each followed by an identity block recording which input rows it
+ * sums, are brought to echelon form 16 columns at a time. A single scan
+ * finds up to 16 pivot rows for the block and reduces them against each
+ * other on their pivot columns. Two Gray-code tables then hold every sum
+ * of pivots 0-7 and of pivots 8-15 (255 row additions each), and every
+ * row below takes the two entries its block bits select: one pass of
+ * three-way XOR per row instead of up to 16 row additions. The rows that
+ * end with nothing left of the matrix are all its dependencies.
+ *
+ * The XOR and popcount kernels are picked once at run time: AVX-512,
+ * AVX2 or plain 64-bit words.
+ */
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define DENSE_X86 1
+#endif
+
+#define DENSE_BLOCK 16             // columns per pass: two tables of 8 pivots
+#define DENSE_MAX_BYTES (1ULL << 30)   // larger matrices go to insert_row
+
+enum { SIMD_SCALAR, SIMD_AVX2, SIMD_AVX512 };
+
+static const char *simd_names[] = {"scalar", "AVX2", "AVX-512"};
+
+// dst ^= a (^ b unless NULL), n words
+static void xor_words_scalar(uint64_t *dst, const uint64_t *a, const uint64_t *b, uint32_t n)
+{
+    if (b)
+        for (uint32_t i = 0; i < n; i++)
+            dst[i] ^= a[i] ^ b[i];
+    else
+        for (uint32_t i = 0; i < n; i++)
+            dst[i] ^= a[i];
+}
+
+static uint64_t popcount_words_scalar(const uint64_t *a, uint32_t n)
+{
+    uint64_t count = 0;
+    for (uint32_t i = 0; i < n; i++)
+        count += (uint64_t)__builtin_popcountll(a[i]);
+    return count;
+}
+
+#ifdef DENSE_X86
+__attribute__((target("avx2"))) static void xor_words_avx2(uint64_t *dst, const uint64_t *a, const uint64_t *b, uint32_t n)
+{
+    uint32_t i = 0;
+    if (b)
+    {
+        for (; i + 4 <= n; i += 4)
+        {
+            __m256i x = _mm256_xor_si256(_mm256_loadu_si256((const __m256i *)(a + i)), _mm256_loadu_si256((const __m256i *)(b + i)));
+            _mm256_storeu_si256((__m256i *)(dst + i), _mm256_xor_si256(_mm256_loadu_si256((const __m256i *)(dst + i)), x));
+        }
+        for (; i < n; i++)
+            dst[i] ^= a[i] ^ b[i];
+    }
+    else
+    {
+        for (; i + 4 <= n; i += 4)
+            _mm256_storeu_si256((__m256i *)(dst + i), _mm256_xor_si256(_mm256_loadu_si256((const __m256i *)(dst + i)),
+                                                                       _mm256_loadu_si256((const __m256i *)(a + i))));
+        for (; i < n; i++)
+            dst[i] ^= a[i];
+    }
+}
+
+// AVX2 has no vector popcount; the 64-bit instruction keeps up with the loads
+__attribute__((target("popcnt"))) static uint64_t popcount_words_popcnt(const uint64_t *a, uint32_t n)
+{
+    uint64_t count = 0;
+    for (uint32_t i = 0; i < n; i++)
+        count += (uint64_t)__builtin_popcountll(a[i]);
+    return count;
+}
+
+__attribute__((target("avx512f"))) static void xor_words_avx512(uint64_t *dst, const uint64_t *a, const uint64_t *b, uint32_t n)
+{
+    uint32_t i = 0;
+    if (b)
+    {
+        for (; i + 8 <= n; i += 8)
+        {
+            // 0x96: dst ^ a ^ b in one instruction
+            __m512i x = _mm512_ternarylogic_epi64(_mm512_loadu_si512(dst + i), _mm512_loadu_si512(a + i),
+                                                  _mm512_loadu_si512(b + i), 0x96);
+            _mm512_storeu_si512(dst + i, x);
+        }
+        if (i < n)
+        {
+            __mmask8 m = (__mmask8)((1u << (n - i)) - 1);
+            __m512i x = _mm512_ternarylogic_epi64(_mm512_maskz_loadu_epi64(m, dst + i), _mm512_maskz_loadu_epi64(m, a + i),
+                                                  _mm512_maskz_loadu_epi64(m, b + i), 0x96);
+            _mm512_mask_storeu_epi64(dst + i, m, x);
+        }
+    }
+    else
+    {
+        for (; i + 8 <= n; i += 8)
+            _mm512_storeu_si512(dst + i, _mm512_xor_si512(_mm512_loadu_si512(dst + i), _mm512_loadu_si512(a + i)));
+        if (i < n)
+        {
+            __mmask8 m = (__mmask8)((1u << (n - i)) - 1);
+            _mm512_mask_storeu_epi64(dst + i, m, _mm512_xor_si512(_mm512_maskz_loadu_epi64(m, dst + i),
+                                                                  _mm512_maskz_loadu_epi64(m, a + i)));
+        }
+    }
+}
+
+__attribute__((target("avx512f,avx512vpopcntdq"))) static uint64_t popcount_words_avx512(const uint64_t *a, uint32_t n)
+{
+    __m512i acc = _mm512_setzero_si512();
+    uint32_t i = 0;
+    for (; i + 8 <= n; i += 8)
+        acc = _mm512_add_epi64(acc, _mm512_popcnt_epi64(_mm512_loadu_si512(a + i)));
+    if (i < n)
+        acc = _mm512_add_epi64(acc, _mm512_popcnt_epi64(_mm512_maskz_loadu_epi64((__mmask8)((1u << (n - i)) - 1), a + i)));
+    return (uint64_t)_mm512_reduce_add_epi64(acc);
+}
+#endif
+
+static void (*xor_words)(uint64_t *dst, const uint64_t *a, const uint64_t *b, uint32_t n) = xor_words_scalar;
+static uint64_t (*popcount_words)(const uint64_t *a, uint32_t n) = popcount_words_scalar;
+static int simd_level = -1;        // -1: not chosen yet
+
+// The best level this CPU has
+static int simd_detect(void)
+{
+#ifdef DENSE_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512vpopcntdq"))
+        return SIMD_AVX512;
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt"))
+        return SIMD_AVX2;
+#endif
+    return SIMD_SCALAR;
+}
+
+// Use the kernels of level, or the best there are when it is above them
+static void simd_select(int level)
+{
+    int best = simd_detect();
+    simd_level = (level > best) ? best : level;
+    xor_words = xor_words_scalar;
+    popcount_words = popcount_words_scalar;
+#ifdef DENSE_X86
+    if (simd_level == SIMD_AVX2)
+    {
+        xor_words = xor_words_avx2;
+        popcount_words = popcount_words_popcnt;
+    }
+    if (simd_level == SIMD_AVX512)
+    {
+        xor_words = xor_words_avx512;
+        popcount_words = popcount_words_avx512;
+    }
+#endif
+}
+
+// Bits [c, c + 16) of a row; c is a multiple of 16, so they share a word
+static uint32_t dense_block_bits(const uint64_t *row, uint32_t c)
+{
+    return (uint32_t)(row[c / 64] >> (c % 64)) & 0xFFFF;
+}
+
+/*
+ * Every dependency among the rows of M, as combinations of rows: the
+ * i-th takes stride words at (*deps_out)[i * stride] (stride >= (rows +
+ * 63) / 64). Returns how many, or -1 when out of memory or the dense
+ * matrix would pass DENSE_MAX_BYTES.
+ */
+static int dense_nullspace(const SparseMatrix *M, uint32_t stride, uint64_t **deps_out)
+{
+    uint32_t R = M->rows, C = M->cols;
+    uint32_t mwords = (C + 63) / 64, cwords = (R + 63) / 64;
+    uint32_t W = (mwords + cwords + 7) & ~7u;   // whole 64-byte lines per row
+    uint64_t *mat = NULL, *tab = NULL, **rowp = NULL;
+    int result = -1;
+    *deps_out = NULL;
+    if (simd_level < 0)
+        simd_select(SIMD_AVX512);
+    if ((uint64_t)R * W * sizeof(uint64_t) > DENSE_MAX_BYTES)
+        return -1;
+    mat = aligned_alloc(64, ((size_t)R * W + 8) * sizeof(uint64_t));
+    tab = aligned_alloc(64, (size_t)2 * 256 * W * sizeof(uint64_t));
+    rowp = malloc((R + 1) * sizeof(uint64_t *));
+    if (!mat || !tab || !rowp)
+        goto out;
+    memset(mat, 0, (size_t)R * W * sizeof(uint64_t));
+    for (uint32_t r = 0; r < R; r++)
+    {
+        uint64_t *row = rowp[r] = mat + (size_t)r * W;
+        for (uint32_t e = M->row_first[r]; e < M->row_first[r + 1]; e++)
+            row[M->row_cols[e] / 64] ^= (uint64_t)1 << (M->row_cols[e] % 64);
+        row[mwords + r / 64] |= (uint64_t)1 << (r % 64);
+    }
+    
+    uint32_t rank = 0;
+    for (uint32_t c = 0; c < C && rank < R; c += DENSE_BLOCK)
+    {
+        uint32_t w0 = c / 64, n = W - w0;   // columns before c are done in every row left
+        uint32_t want = (C - c >= DENSE_BLOCK) ? 0xFFFF : (1u << (C - c)) - 1;
+        uint32_t pat[DENSE_BLOCK], col[DENSE_BLOCK], taken = 0;
+        int npiv = 0;
+        
+        // Pivots: rows whose block bits the pivots so far don't account for
+        for (uint32_t r = rank; r < R && taken != want; r++)
+        {
+            uint64_t *row = rowp[r];
+            uint32_t p = dense_block_bits(row, c);
+            for (int i = 0; i < npiv; i++)
+                if (p >> col[i] & 1)
+                    p ^= pat[i];
+            if (!p)
+                continue;
+            uint32_t q = dense_block_bits(row, c);
+            for (int i = 0; i < npiv; i++)
+            {
+                if (q >> col[i] & 1)
+                {
+                    xor_words(row + w0, rowp[rank + i] + w0, NULL, n);
+                    q ^= pat[i];
+                }
+            }
+            uint32_t j = (uint32_t)__builtin_ctz(p);
+            for (int i = 0; i < npiv; i++)
+            {
+                if (pat[i] >> j & 1)
+                {
+                    xor_words(rowp[rank + i] + w0, row + w0, NULL, n);
+                    pat[i] ^= p;
+                }
+            }
+            rowp[r] = rowp[rank + npiv];
+            rowp[rank + npiv] = row;
+            pat[npiv] = p;
+            col[npiv++] = j;
+            taken |= 1u << j;
+        }
+        if (!npiv)
+            continue;
+        
+        // Gray-code tables: entry g of table t is the sum of pivots 8t + k over the bits k of g
+        int tables = (npiv > 8) ? 2 : 1;
+        for (int t = 0; t < tables; t++)
+        {
+            uint64_t *T = tab + (size_t)t * 256 * W;
+            int k = (npiv - 8 * t < 8) ? npiv - 8 * t : 8;
+            memset(T, 0, n * sizeof(uint64_t));
+            for (uint32_t i = 1; i < (1u << k); i++)
+            {
+                uint32_t g = i ^ (i >> 1), prev = (i - 1) ^ ((i - 1) >> 1);
+                memcpy(T + (size_t)g * W, T + (size_t)prev * W, n * sizeof(uint64_t));
+                xor_words(T + (size_t)g * W, rowp[rank + 8 * t + __builtin_ctz(i)] + w0, NULL, n);
+            }
+        }
+        for (uint32_t r = rank + npiv; r < R; r++)
+        {
+            uint64_t *row = rowp[r];
+            uint32_t bits = dense_block_bits(row, c), idx[2] = {0, 0};
+            if (!bits)
+                continue;
+            for (int i = 0; i < npiv; i++)
+                idx[i / 8] |= (bits >> col[i] & 1) << (i % 8);
+            const uint64_t *a = idx[0] ? tab + (size_t)idx[0] * W : NULL;
+            const uint64_t *b = idx[1] ? tab + (size_t)(256 + idx[1]) * W : NULL;
+            if (a && b)
+                xor_words(row + w0, a, b, n);
+            else if (a || b)
+                xor_words(row + w0, a ? a : b, NULL, n);
+        }
+        rank += npiv;
+    }
+    
+    // The rows left have nothing of M: their identity blocks are the dependencies
+    uint64_t *deps = calloc((size_t)(R - rank) * stride + 1, sizeof(uint64_t));
+    if (!deps)
+        goto out;
+    for (uint32_t r = rank; r < R; r++)
+        memcpy(deps + (size_t)(r - rank) * stride, rowp[r] + mwords, cwords * sizeof(uint64_t));
+    *deps_out = deps;
+    result = (int)(R - rank);
+out:
+    free(mat);
+    free(tab);
+    free(rowp);
+    return result;
+}
+
+// ============ Filtering and linear algebra ============
+
+/*
+ * Relations go to the large-prime graph as they arrive; the matrix waits
+ * until sieving stops. Its rows are the units, its columns the signs,
+ * rational primes and ideals some unit has to an odd power. A relation
+ * whose (a, b) was seen before is dropped on arrival: two copies of a
+ * partial would close a cycle that squares to nothing. Before
+ * elimination the rows are filtered. A column of weight 1 can't cancel,
+ * so its row (a singleton) goes, which may leave other columns at weight
+ * 1. Then, while rows outnumber columns by more than MATRIX_EXCESS,
+ * cliques go: rows joined through columns of weight 2, heaviest first,
+ * each costing the excess at most 1.
+ */
+
+#define MATRIX_EXCESS 64           // rows over columns kept for dependencies
+#define CLIQUE_MAX_ROWS 32         // larger components are left alone
+#define MERGE_MAX_WEIGHT 8         // heavier columns are never pivoted on
+#define MERGE_MAX_ROW 64           // nor a column whose merge would grow a row past this
+
+typedef struct {
+    uint32_t rows, cols;
+    uint64_t weight;               // nonzero entries
+} MatrixShape;
+
+typedef struct {
+    uint64_t duplicates;           // relations dropped on arrival
+    MatrixShape before, after;     // around filtering
+    uint32_t singletons, cliques;  // rows removed by each
+    MatrixShape merged;            // after structured elimination
+    uint32_t merged_cols;          // columns it eliminated
+    uint32_t dependencies;
+    const char *solver;            // "M4RI", "Gaussian" (insert_row) or "Lanczos"
+    uint32_t iterations;           // Lanczos steps
+    int threads;
+    double filter_seconds, merge_seconds, la_seconds;   // merge and la (the solve): wall clock
+} MatrixStats;
+
+static MatrixStats matrix_stats;
+static int filter_matrix = 1;      // 0: every unit goes to elimination (--bench-filter)
+static int merge_matrix = 1;       // 0: solve the filtered rows as they are (--bench-merge)
+
+// Open addressing over a power of two slots from the job arena, at most half full
+static int64_t *relset_a, *relset_b;
+static uint32_t relset_size, relset_used;
+
+static int relset_alloc(uint32_t size)
+{
+    relset_size = size;
+    relset_a = arena_alloc(&job_arena, relset_size * sizeof(int64_t));
+    relset_b = arena_alloc(&job_arena, relset_size * sizeof(int64_t));
+    return relset_a && relset_b;
+}
+
+static int relset_init(void)
+{
+    uint32_t size = 1024;
+    while (size <= 2 * (uint32_t)rel_capacity)
+        size *= 2;
+    relset_used = 0;
+    return relset_alloc(size);
+}
+
+static uint32_t relset_slot(int64_t a, int64_t b)
+{
+    uint64_t h = ((uint64_t)a * 0x9E3779B97F4A7C15ULL) ^ ((uint64_t)b * 0xC2B2AE3D27D4EB4FULL);
+    uint32_t slot = (uint32_t)(h >> 32) & (relset_size - 1);
+    while (relset_b[slot] != 0 && (relset_a[slot] != a || relset_b[slot] != b))
+        slot = (slot + 1) & (relset_size - 1);
+    return slot;
+}
+
+static int relset_grow(void)
+{
+    int64_t *old_a = relset_a, *old_b = relset_b;
+    uint32_t old_size = relset_size;
+    if (!relset_alloc(2 * old_size))
+    {
+        relset_a = old_a;
+        relset_b = old_b;
+        relset_size = old_size;
+        return 0;
+    }
+    for (uint32_t i = 0; i < old_size; i++)
+    {
+        if (old_b[i] == 0)
+            continue;
+        uint32_t slot = relset_slot(old_a[i], old_b[i]);
+        relset_a[slot] = old_a[i];
+        relset_b[slot] = old_b[i];
+    }
+    return 1;
+}
+
+// Returns 1 if (a, b) was already present, otherwise records it
+static int relset_insert(int64_t a, int64_t b)
+{
+    // Partial relations are kept too, so the set doubles as they come in
+    if (2 * (relset_used + 1) > relset_size && !relset_grow())
+        return 0;   // out of memory: stop deduplicating rather than fill up
+    uint32_t slot = relset_slot(a, b);
+    if (relset_b[slot] != 0)
+        return 1;
+    relset_a[slot] = a;
+    relset_b[slot] = b;
+    relset_used++;
+    return 0;
+}
+
+// Start the matrix stage of a job: no relations seen, nothing filtered
+static int matrix_begin(void)
+{
+    memset(&matrix_stats, 0, sizeof(matrix_stats));
+    return relset_init();
+}
+
+/*
+ * Add relations[relation_count] to the large-prime graph, unless its
+ * (a, b) was seen before: then it is dropped and 0 returned.
+ */
+static int consume_relation(void)
+{
+    Relation *rel = &relations[relation_count];
+    if (relset_insert(rel->a, rel->b))
+    {
+        factors_used = rel->first;
+        matrix_stats.duplicates++;
+        return 0;
+    }
+    lp_graph_add();
+    return 1;
+}
+
+// Rational primes and algebraic ideals are columns; overshoot a little to force a dependency sooner
+static int relations_full(void)
+{
+    return unit_count >= (uint32_t)rel_capacity;
+}
+
+/*
+ * Column lists of the units, each sorted and holding only the columns the
+ * unit has to an odd power: unit k is cols[first[k] .. first[k + 1]).
+ * Returns cols (NULL when out of memory); both are malloc'ed.
+ */
+static uint32_t *unit_columns(uint32_t **first_out)
+{
+    uint64_t bound = 0;
+    for (uint32_t m = 0; m < members_used; m++)
+    {
+        const Relation *rel = &relations[unit_members[m]];
+        bound += rel->a_count + rel->r_count + 2;
+    }
+    uint32_t *first = malloc((unit_count + 1) * sizeof(uint32_t));
+    uint32_t *cols = malloc((bound + 1) * sizeof(uint32_t));
+    if (!first || !cols)
+    {
+        free(first);
+        free(cols);
+        return NULL;
+    }
+    
+    uint32_t used = 0;
+    first[0] = 0;
+    for (uint32_t k = 0; k < unit_count; k++)
+    {
+        uint32_t start = used;
+        for (uint32_t m = unit_first[k]; m < unit_first[k + 1]; m++)
+        {
+            const Relation *rel = &relations[unit_members[m]];
+            const PrimePower *f = &factors[rel->first];
+            for (int j = 0; j < rel->a_count + rel->r_count; j++)
+                if (f[j].exp % 2)
+                    cols[used++] = 2 + 2 * f[j].index + (j < rel->a_count);
+            if (rel->r_sign)
+                cols[used++] = 0;
+            if (rel->a_sign)
+                cols[used++] = 1;
+        }
+        // Sorted, a column seen an even number of times cancels
+        qsort(cols + start, used - start, sizeof(uint32_t), compare_u32);
+        uint32_t kept = start;
+        for (uint32_t i = start, j; i < used; i = j)
+        {
+            for (j = i; j < used && cols[j] == cols[i]; j++)
+                ;
+            if ((j - i) % 2)
+                cols[kept++] = cols[i];
+        }
+        used = kept;
+        first[k + 1] = used;
+    }
+    *first_out = first;
+    return cols;
+}
+
+typedef struct {
+    const uint32_t *first, *cols;            // unit -> columns
+    const uint32_t *col_first, *col_units;   // column -> units
+    uint32_t *weight;                        // live units per column
+    uint32_t *stack, stack_used;             // columns that fell to weight 1
+    uint8_t *alive;
+    uint32_t units, ncols, rows, live_cols;
+} Filter;
+
+static void filter_drop(Filter *F, uint32_t k)
+{
+    F->alive[k] = 0;
+    F->rows--;
+    for (uint32_t e = F->first[k]; e < F->first[k + 1]; e++)
+    {
+        uint32_t c = F->cols[e];
+        if (--F->weight[c] == 0)
+            F->live_cols--;
+        else if (F->weight[c] == 1)
+            F->stack[F->stack_used++] = c;
+    }
+}
+
+// Drop singletons until none are left; returns how many
+static uint32_t filter_singletons(Filter *F)
+{
+    uint32_t dropped = 0;
+    while (F->stack_used)
+    {
+        uint32_t c = F->stack[--F->stack_used];
+        if (F->weight[c] != 1)
+            continue;
+        for (uint32_t e = F->col_first[c]; e < F->col_first[c + 1]; e++)
+        {
+            if (F->alive[F->col_units[e]])
+            {
+                filter_drop(F, F->col_units[e]);
+                dropped++;
+                break;
+            }
+        }
+    }
+    return dropped;
+}
+
+static uint32_t filter_find(uint32_t *parent, uint32_t k)
+{
+    while (parent[k] != k)
+    {
+        parent[k] = parent[parent[k]];
+        k = parent[k];
+    }
+    return k;
+}
+
+static int compare_u64_desc(const void *x, const void *y)
+{
+    uint64_t a = *(const uint64_t *)x, b = *(const uint64_t *)y;
+    return (a < b) - (a > b);
+}
+
+/*
+ * Drop cliques, heaviest first, until the excess is down to target.
+ * Returns the rows dropped.
+ */
+static uint32_t filter_cliques(Filter *F, uint32_t target)
+{
+    uint32_t *parent = malloc(F->units * sizeof(uint32_t));
+    uint32_t *size = calloc(F->units, sizeof(uint32_t));
+    uint32_t *head = malloc(F->units * sizeof(uint32_t));
+    uint32_t *next = malloc(F->units * sizeof(uint32_t));
+    uint64_t *order = malloc(F->units * sizeof(uint64_t));
+    uint32_t dropped = 0;
+    if (!parent || !size || !head || !next || !order)
+        goto out;
+    for (uint32_t k = 0; k < F->units; k++)
+    {
+        parent[k] = k;
+        head[k] = UINT32_MAX;
+    }
+    
+    // Join the two live units of each weight-2 column
+    for (uint32_t c = 0; c < F->ncols; c++)
+    {
+        if (F->weight[c] != 2)
+            continue;
+        uint32_t pair[2], found = 0;
+        for (uint32_t e = F->col_first[c]; e < F->col_first[c + 1] && found < 2; e++)
+            if (F->alive[F->col_units[e]])
+                pair[found++] = F->col_units[e];
+        uint32_t x = filter_find(parent, pair[0]), y = filter_find(parent, pair[1]);
+        if (x != y)
+            parent[x] = y;
+    }
+    
+    // Components by weight: score in the high bits, root in the low
+    uint32_t components = 0;
+    for (uint32_t k = 0; k < F->units; k++)
+    {
+        if (!F->alive[k])
+            continue;
+        uint32_t root = filter_find(parent, k);
+        next[k] = head[root];
+        head[root] = k;
+        size[root]++;
+    }
+    for (uint32_t k = 0; k < F->units; k++)
+    {
+        if (!size[k] || size[k] > CLIQUE_MAX_ROWS)
+            continue;
+        uint64_t weight = 0;
+        for (uint32_t u = head[k]; u != UINT32_MAX; u = next[u])
+            weight += F->first[u + 1] - F->first[u];
+        order[components++] = weight << 32 | k;
+    }
+    qsort(order, components, sizeof(uint64_t), compare_u64_desc);
+    
+    for (uint32_t i = 0; i < components && F->rows > F->live_cols + target; i++)
+    {
+        for (uint32_t u = head[(uint32_t)order[i]]; u != UINT32_MAX; u = next[u])
+        {
+            filter_drop(F, u);
+            dropped++;
+        }
+    }
+out:
+    free(parent);
+    free(size);
+    free(head);
+    free(next);
+    free(order);
+    return dropped;
+}
+
+/*
+ * Filter the units behind unit_columns' lists: alive[k] says whether unit
+ * k stays and weight[c] gets each column's weight over the survivors.
+ * With filter_matrix off it only counts. Returns 0 when out of memory,
+ * leaving every unit alive.
+ */
+static int filter_units(const uint32_t *first, const uint32_t *cols, uint32_t ncols, uint8_t *alive, uint32_t *weight)
+{
+    MatrixStats *ms = &matrix_stats;
+    memset(alive, 1, unit_count);
+    memset(weight, 0, ncols * sizeof(uint32_t));
+    for (uint32_t e = 0; e < first[unit_count]; e++)
+        weight[cols[e]]++;
+    Filter F = {first, cols, NULL, NULL, weight, NULL, 0, alive, unit_count, ncols, unit_count, 0};
+    for (uint32_t c = 0; c < ncols; c++)
+        F.live_cols += (weight[c] != 0);
+    ms->before.rows = F.rows;
+    ms->before.cols = F.live_cols;
+    ms->before.weight = first[unit_count];
+    ms->after = ms->before;
+    if (!filter_matrix)
+        return 1;
+    
+    // Transpose: col_units[col_first[c] ..] are the units with column c
+    uint32_t *col_first = calloc(ncols + 1, sizeof(uint32_t));
+    uint32_t *col_units = malloc((first[unit_count] + 1) * sizeof(uint32_t));
+    uint32_t *stack = malloc(ncols * sizeof(uint32_t));
+    if (!col_first || !col_units || !stack)
+    {
+        free(col_first);
+        free(col_units);
+        free(stack);
+        return 0;
+    }
+    for (uint32_t e = 0; e < first[unit_count]; e++)
+        col_first[cols[e] + 1]++;
+    for (uint32_t c = 0; c < ncols; c++)
+        col_first[c + 1] += col_first[c];
+    for (uint32_t k = 0; k < unit_count; k++)
+        for (uint32_t e = first[k]; e < first[k + 1]; e++)
+            col_units[col_first[cols[e]]++] = k;
+    for (uint32_t c = ncols; c > 0; c--)
+        col_first[c] = col_first[c - 1];
+    col_first[0] = 0;
+    F.col_first = col_first;
+    F.col_units = col_units;
+    F.stack = stack;
+    
+    for (uint32_t c = 0; c < ncols; c++)
+        if (weight[c] == 1)
+            stack[F.stack_used++] = c;
+    ms->singletons = filter_singletons(&F);
+    // Dropping a clique can leave singletons, and those can leave new cliques
+    for (int pass = 0; pass < 4 && F.rows > F.live_cols + MATRIX_EXCESS; pass++)
+    {
+        uint32_t dropped = filter_cliques(&F, MATRIX_EXCESS);
+        if (!dropped)
+            break;
+        ms->cliques += dropped;
+        ms->singletons += filter_singletons(&F);
+    }
+    
+    ms->after.rows = F.rows;
+    ms->after.cols = F.live_cols;
+    ms->after.weight = 0;
+    for (uint32_t k = 0; k < unit_count; k++)
+        if (alive[k])
+            ms->after.weight += first[k + 1] - first[k];
+    free(col_first);
+    free(col_units);
+    free(stack);
+    return 1;
+}
+
+/*
+ * Structured Gaussian elimination of the filtered rows. A column of
+ * weight w goes by adding its lightest row to the other w - 1 rows and
+ * dropping that row: one row and one column less, the excess kept. At
+ * weight 2 this never adds entries; heavier columns fill in, so only
+ * columns up to MERGE_MAX_WEIGHT are pivoted on, lightest first, and no
+ * row grows past MERGE_MAX_ROW entries. Each row carries the units it is
+ * the sum of, which is all the dependency step needs.
+ */
+
+typedef struct {
+    uint32_t *cols, *units;        // sorted; units NULL once the row is dropped
+    uint32_t ncols, nunits;
+} MergeRow;
+
+// out = a + b over GF(2) for sorted lists; returns its length
+static uint32_t xor_sorted(const uint32_t *a, uint32_t na, const uint32_t *b, uint32_t nb, uint32_t *out)
+{
+    uint32_t i = 0, j = 0, k = 0;
+    while (i < na && j < nb)
+    {
+        if (a[i] < b[j])
+            out[k++] = a[i++];
+        else if (a[i] > b[j])
+            out[k++] = b[j++];
+        else
+        {
+            i++;
+            j++;
+        }
+    }
+    while (i < na)
+        out[k++] = a[i++];
+    while (j < nb)
+        out[k++] = b[j++];
+    return k;
+}
+
+// r += p, unless r would pass MERGE_MAX_ROW or memory runs out: then 0 and r is unchanged
+static int merge_add(MergeRow *r, const MergeRow *p)
+{
+    uint32_t *cols = malloc((r->ncols + p->ncols + 1) * sizeof(uint32_t));
+    uint32_t *units = malloc((r->nunits + p->nunits + 1) * sizeof(uint32_t));
+    uint32_t ncols = (cols && units) ? xor_sorted(r->cols, r->ncols, p->cols, p->ncols, cols) : UINT32_MAX;
+    if (ncols > MERGE_MAX_ROW)
+    {
+        free(cols);
+        free(units);
+        return 0;
+    }
+    r->nunits = xor_sorted(r->units, r->nunits, p->units, p->nunits, units);
+    free(r->cols);
+    free(r->units);
+    r->cols = cols;
+    r->units = units;
+    r->ncols = ncols;
+    return 1;
+}
+
+static void merge_drop(MergeRow *r)
+{
+    free(r->cols);
+    free(r->units);
+    r->cols = r->units = NULL;
+}
+
+/*
+ * Merge rows[0 .. nrows) over columns below ncols in rounds: each round
+ * lists the rows of every column, then pivots on the columns whose rows
+ * no earlier pivot of the round touched. Returns the columns eliminated
+ * (0 when out of memory, leaving the rows as they are).
+ */
+static uint32_t merge_rows(MergeRow *rows, uint32_t nrows, uint32_t ncols)
+{
+    uint32_t *col_first = malloc((ncols + 1) * sizeof(uint32_t));
+    uint32_t *order = malloc((ncols + 1) * sizeof(uint32_t));
+    uint8_t *touched = malloc(nrows + 1);
+    uint32_t *col_rows = NULL, eliminated = 0;
+    uint64_t col_capacity = 0;
+    if (!col_first || !order || !touched)
+        goto out;
+    
+    for (;;)
+    {
+        uint64_t nnz = 0;
+        for (uint32_t k = 0; k < nrows; k++)
+            if (rows[k].units)
+                nnz += rows[k].ncols;
+        if (nnz + 1 > col_capacity)
+        {
+            free(col_rows);
+            col_capacity = 2 * nnz + 1;
+            if (!(col_rows = malloc(col_capacity * sizeof(uint32_t))))
+                goto out;
+        }
+        memset(col_first, 0, (ncols + 1) * sizeof(uint32_t));
+        for (uint32_t k = 0; k < nrows; k++)
+            for (uint32_t e = 0; rows[k].units && e < rows[k].ncols; e++)
+                col_first[rows[k].cols[e] + 1]++;
+        // Pivot columns by weight, lightest first
+        uint32_t count = 0;
+        for (uint32_t w = 1; w <= MERGE_MAX_WEIGHT; w++)
+            for (uint32_t c = 0; c < ncols; c++)
+                if (col_first[c + 1] == w)
+                    order[count++] = c;
+        for (uint32_t c = 0; c < ncols; c++)
+            col_first[c + 1] += col_first[c];
+        for (uint32_t k = 0; k < nrows; k++)
+            for (uint32_t e = 0; rows[k].units && e < rows[k].ncols; e++)
+                col_rows[col_first[rows[k].cols[e]]++] = k;
+        for (uint32_t c = ncols; c > 0; c--)
+            col_first[c] = col_first[c - 1];
+        col_first[0] = 0;
+        
+        memset(touched, 0, nrows);
+        uint32_t round = 0;
+        for (uint32_t i = 0; i < count; i++)
+        {
+            const uint32_t *list = col_rows + col_first[order[i]];
+            uint32_t w = col_first[order[i] + 1] - col_first[order[i]], pivot = list[0];
+            int clear = 1;
+            for (uint32_t j = 0; j < w; j++)
+            {
+                clear &= !touched[list[j]];
+                if (rows[list[j]].ncols < rows[pivot].ncols)
+                    pivot = list[j];
+            }
+            if (!clear)
+                continue;
+            uint32_t merged = 0;
+            for (uint32_t j = 0; j < w; j++)
+            {
+                touched[list[j]] = 1;
+                if (list[j] != pivot)
+                    merged += merge_add(&rows[list[j]], &rows[pivot]);
+            }
+            // A row that would have grown too far keeps the column, and the pivot with it
+            if (merged == w - 1)
+            {
+                merge_drop(&rows[pivot]);
+                round++;
+            }
+        }
+        eliminated += round;
+        if (round == 0)
+            break;
+    }
+out:
+    free(col_first);
+    free(order);
+    free(touched);
+    free(col_rows);
+    return eliminated;
+}
+
+/*
+ * Drop the rows merged away (rows[] is compacted, *nrows updated) and
+ * build M over the columns some row still has, renumbered. M owns its
+ * arrays; 0 when out of memory.
+ */
+static int merge_to_sparse(MergeRow *rows, uint32_t *nrows, uint32_t ncols, SparseMatrix *M)
+{
+    uint32_t *renumber = calloc(ncols + 1, sizeof(uint32_t));
+    uint32_t kept = 0;
+    uint64_t nnz = 0;
+    memset(M, 0, sizeof(*M));
+    if (!renumber)
+        return 0;
+    for (uint32_t k = 0; k < *nrows; k++)
+    {
+        if (!rows[k].units)
+            continue;
+        rows[kept++] = rows[k];
+        nnz += rows[k].ncols;
+        for (uint32_t e = 0; e < rows[k].ncols; e++)
+            renumber[rows[k].cols[e]] = 1;
+    }
+    *nrows = kept;
+    for (uint32_t c = 0; c < ncols; c++)
+        renumber[c] = renumber[c] ? M->cols++ : UINT32_MAX;
+    
+    uint32_t *row_first = malloc((kept + 1) * sizeof(uint32_t));
+    uint32_t *row_cols = malloc((nnz + 1) * sizeof(uint32_t));
+    M->row_first = row_first;
+    M->row_cols = row_cols;
+    if (row_first && row_cols)
+    {
+        M->rows = kept;
+        row_first[0] = 0;
+        for (uint32_t k = 0; k < kept; k++)
+        {
+            row_first[k + 1] = row_first[k] + rows[k].ncols;
+            for (uint32_t e = 0; e < rows[k].ncols; e++)
+                row_cols[row_first[k] + e] = renumber[rows[k].cols[e]];
+        }
+    }
+    free(renumber);
+    return row_first && row_cols;
+}
+
+/*
+ * Gaussian elimination of M's rows, built in scratch_row; the
+ * combination of rows behind each dependent row goes to *deps_out.
+ */
+static void solve_gaussian(const SparseMatrix *M, uint64_t **deps_out)
+{
+    MatrixStats *ms = &matrix_stats;
+    uint64_t *dep = malloc(combo_words * sizeof(uint64_t)), *deps = NULL;
+    *deps_out = NULL;
+    if (!dep)
+        return;
+    int parity_words = (int)(M->cols + 63) / 64;
+    uint32_t dep_capacity = 0;
+    matrix_rows = 0;
+    for (uint32_t r = 0; r < M->rows; r++)
+    {
+        uint64_t *row = scratch_row;
+        memset(row, 0, (col_words + combo_words) * sizeof(uint64_t));
+        for (uint32_t e = M->row_first[r]; e < M->row_first[r + 1]; e++)
+            row[M->row_cols[e] / 64] |= (uint64_t)1 << (M->row_cols[e] % 64);
+        uint64_t *combo = row + col_words;
+        combo[r / 64] |= (uint64_t)1 << (r % 64);
+        int dependent = insert_row(row, parity_words, r / 64 + 1, dep);
+        if (dependent < 0)
+            break;
+        if (dependent == 0)
+            continue;
+        if (ms->dependencies == dep_capacity)
+        {
+            uint32_t cap = dep_capacity ? 2 * dep_capacity : 64;
+            uint64_t *grown = realloc(deps, (size_t)cap * combo_words * sizeof(uint64_t));
+            if (!grown)
+                break;
+            deps = grown;
+            dep_capacity = cap;
+        }
+        memcpy(deps + (size_t)ms->dependencies++ * combo_words, dep, combo_words * sizeof(uint64_t));
+    }
+    free(dep);
+    *deps_out = deps;
+}
+
+/*
+ * Block Lanczos on M; dependencies come back as combinations of rows
+ * like solve_gaussian's, or *deps_out stays NULL when out of memory or
+ * if the iteration found nothing.
+ */
+static void solve_lanczos(SparseMatrix *M, uint64_t **deps_out)
+{
+    MatrixStats *ms = &matrix_stats;
+    uint64_t *found = malloc((M->rows + 1) * sizeof(uint64_t)), *deps = NULL;
+    *deps_out = NULL;
+    if (!found || !sparse_transpose(M))
+        goto out;
+    ms->threads = la_threads;
+    int count = block_lanczos(M, la_threads, found, &ms->iterations);
+    if (count <= 0 || !(deps = calloc((size_t)count * combo_words, sizeof(uint64_t))))
+        goto out;
+    for (uint32_t r = 0; r < M->rows; r++)
+        for (uint64_t x = found[r]; x; x &= x - 1)
+            deps[(size_t)__builtin_ctzll(x) * combo_words + r / 64] |= (uint64_t)1 << (r % 64);
+    ms->dependencies = (uint32_t)count;
+    *deps_out = deps;
+out:
+    free(found);
+}
+
+/*
+ * The matrix stage: filter the units, merge the rows left over their
+ * live columns (renumbered) by structured elimination, solve, and try
+ * each dependency in turn.
+ * Matrices of lanczos_rows rows or more with MATRIX_EXCESS spare rows go
+ * to block Lanczos, which tends to break down on singletons or a thin
+ * excess; the rest (and any Lanczos gives up on) go to dense M4RI
+ * elimination, or to insert_row when that is out of memory. Returns a
+ * factor of n, or 0.
+ */
+static u128 solve_matrix(u128 n, uint32_t *primes, int fb_size)
+{
+    MatrixStats *ms = &matrix_stats;
+    ms->singletons = ms->cliques = ms->dependencies = ms->iterations = ms->merged_cols = 0;
+    ms->threads = 1;
+    clock_t start = clock();
+    uint32_t ncols = 64 * (uint32_t)col_words;
+    uint32_t *first = NULL, *cols = unit_columns(&first);
+    uint32_t *weight = malloc(ncols * sizeof(uint32_t));
+    uint8_t *alive = malloc(unit_count + 1);
+    MergeRow *rows = calloc(unit_count + 1, sizeof(MergeRow));
+    SparseMatrix M = {0, 0, NULL, NULL, NULL, NULL};
+    uint32_t nrows = 0;
+    uint64_t *deps = NULL;
+    u128 factor = 0;
+    if (!cols || !weight || !alive || !rows || !filter_units(first, cols, ncols, alive, weight))
+        goto out;
+    ms->filter_seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+    double mid = wall_seconds();
+    
+    // Live columns keep their order, renumbered from 0; a row per live unit
+    uint32_t live = 0;
+    for (uint32_t c = 0; c < ncols; c++)
+        weight[c] = weight[c] ? live++ : UINT32_MAX;
+    for (uint32_t k = 0; k < unit_count; k++)
+    {
+        if (!alive[k])
+            continue;
+        MergeRow *row = &rows[nrows++];
+        row->ncols = first[k + 1] - first[k];
+        row->nunits = 1;
+        row->cols = malloc((row->ncols + 1) * sizeof(uint32_t));
+        row->units = malloc(sizeof(uint32_t));
+        if (!row->cols || !row->units)
+            goto out;
+        for (uint32_t e = 0; e < row->ncols; e++)
+            row->cols[e] = weight[cols[first[k] + e]];
+        row->units[0] = k;
+    }
+    if (merge_matrix)
+        ms->merged_cols = merge_rows(rows, nrows, live);
+    ms->merge_seconds = wall_seconds() - mid;
+    
+    if (!merge_to_sparse(rows, &nrows, live, &M))
+        goto out;
+    ms->merged.rows = M.rows;
+    ms->merged.cols = M.cols;
+    ms->merged.weight = M.row_first[M.rows];
+    
+    double solve = wall_seconds();
+    if (filter_matrix && M.rows >= lanczos_rows && M.rows >= M.cols + MATRIX_EXCESS)
+    {
+        ms->solver = "Lanczos";
+        solve_lanczos(&M, &deps);
+    }
+    if (!deps)
+    {
+        ms->solver = "M4RI";
+        ms->threads = 1;
+        ms->iterations = 0;
+        int count = dense_nullspace(&M, (uint32_t)combo_words, &deps);
+        ms->dependencies = (count > 0) ? (uint32_t)count : 0;
+    }
+    if (!deps)
+    {
+        ms->solver = "Gaussian";
+        solve_gaussian(&M, &deps);
+    }
+    ms->la_seconds = wall_seconds() - solve;
+    
+    // Rows back to units: a unit in two rows of a dependency cancels
+    for (uint32_t d = 0; d < ms->dependencies && !factor; d++)
+    {
+        const uint64_t *combo = deps + (size_t)d * combo_words;
+        memset(dep_mask, 0, combo_words * sizeof(uint64_t));
+        for (uint32_t r = 0; r < M.rows; r++)
+            if (combo[r / 64] & ((uint64_t)1 << (r % 64)))
+                for (uint32_t u = 0; u < rows[r].nunits; u++)
+                    dep_mask[rows[r].units[u] / 64] ^= (uint64_t)1 << (rows[r].units[u] % 64);
+        factor = attempt_dependency(primes, fb_size, n);
+    }
+out:
+    for (uint32_t k = 0; rows && k < nrows; k++)
+        merge_drop(&rows[k]);
+    free(rows);
+    free(first);
+    free(cols);
+    free(weight);
+    free(alive);
+    sparse_free(&M);
+    free(deps);
+    return (factor > 1 && factor < n) ? factor : 0;
+}
+
+// ============ Parallel sieving ============
+
+/*
+ * sieve_threads >= 1 hands the sieve to that many worker threads. The
+ * work comes in units that a worker claims with one atomic add, so no
+ * two sieve the same pairs: a strip of lines of the (a, b) region, a
+ * block long (a line at least), or the lattice of one special-q ideal
+ * (q, r). Short units keep the lines sieved close to the ones the serial
+ * sieve would cover, as the yield falls with b, and they keep small what
+ * the workers have in hand, which is thrown away when the matrix fills.
+ *
+ * Lattice roots, buckets, resieve lists and survivors are thread-local,
+ * and so is the relation store: a worker factors into its own, and every
+ * SIEVE_BATCH relations, and at the end of each unit, pushes the whole
+ * store as a batch onto a lock-free stack. The calling thread only
+ * merges. It takes the stack in one exchange and adds the batches, oldest
+ * first, to the job's store through consume_relation. Once relations_full
+ * it raises a flag that stops the workers after their current block.
+ * Merging is cheap, so the caller sleeps SIEVE_POLL_NS between looks; a
+ * caller that sieved too would only look between its own blocks, and
+ * with more threads than cores that can be long after the matrix filled.
+ * For the same reason a worker waits before its next block while the
+ * stack holds SIEVE_BACKLOG batches per worker: the merging thread gets
+ * one share of the cores like any other, and unchecked the workers would
+ * sieve far past the point where the matrix is full.
+ */
+
+#define SIEVE_BATCH 256             // relations a worker collects before handing them over
+#define SIEVE_POLL_NS 100000        // the merging thread's sleep when the stack is empty
+#define SIEVE_BACKLOG 2             // batches per worker the stack holds before workers wait
+
+static int sieve_threads = 0;       // --threads; 0 runs the serial sieve (the benchmarks)
+
+typedef struct RelationBatch {
+    struct RelationBatch *next;
+    Arena arena;                    // holds rels and factors
+    Relation *rels;
+    PrimePower *factors;
+    int count;
+    uint32_t unit;                  // the unit this batch finishes, or UINT32_MAX
+} RelationBatch;
+
+typedef struct {
+    const SnfsPoly *f;
+    int fb_base;
+    int64_t half;                   // half-width: A for the region, I per special q
+    int64_t strip;                  // region lines per unit; 0 for special q
+    const uint32_t *ideal;          // special q: unit u sieves the lattice of alg_fb ideal[u]
+    uint32_t units;
+    FILE *out;                      // special q: the relations file, or NULL
+    atomic_uint next_unit;
+    atomic_int stop, active;
+    _Atomic(RelationBatch *) batches;
+    atomic_int pending;             // batches on the stack
+    atomic_uint_fast64_t survivors;
+    // The merging thread's alone
+    uint8_t *unit_done;             // merged in full before the matrix filled
+    int64_t *reach;                 // region: lines of each strip merged so far
+    uint32_t frontier;              // units below it are all done
+    int64_t lines;                  // region: lines sieved, once sieve_parallel returns
+    uint64_t relations, duplicates;
+    int failed;
+} SieveShared;
+
+// Free this thread's sieve scratch (a worker's, as it exits)
+static void sieve_thread_release(void)
+{
+    for (int i = 0; i < buckets_allocated; i++)
+    {
+        free(buckets[i].updates);
+        free(buckets[i].index);
+    }
+    free(buckets);
+    buckets = NULL;
+    buckets_allocated = 0;
+    free(resieve_notes);
+    resieve_notes = NULL;
+    resieve_count = resieve_capacity = 0;
+    free(hit_divisors);
+    hit_divisors = NULL;
+    hit_divisors_capacity = 0;
+    free(lat_root_r);
+    free(lat_root_a);
+    lat_root_r = lat_root_a = NULL;
+    root_capacity = ideal_capacity = 0;
+}
+
+// Push this thread's relation store as a batch and start an empty one
+static int sieve_hand_over(SieveShared *S, uint32_t unit)
+{
+    RelationBatch *bt = malloc(sizeof(RelationBatch));
+    if (!bt)
+        return 0;
+    bt->arena = *store_arena;
+    bt->rels = relations;
+    bt->factors = factors;
+    bt->count = relation_count;
+    bt->unit = unit;
+    store_arena->head = NULL;
+    store_arena->reserved = 0;
+    relations = NULL;
+    relation_count = relations_allocated = 0;
+    factors = NULL;
+    factors_used = factors_capacity = 0;
+    
+    bt->next = atomic_load(&S->batches);
+    while (!atomic_compare_exchange_weak(&S->batches, &bt->next, bt))
+        ;
+    atomic_fetch_add(&S->pending, 1);
+    return 1;
+}
+
+// Region lines in strip u
+static int64_t sieve_strip_lines(const SieveShared *S, uint32_t u)
+{
+    int64_t left = S->half - (int64_t)u * S->strip;
+    return (left < S->strip) ? left : S->strip;
+}
+
+// Keep relations[relation_count], copied into the job's store
+static void sieve_keep(SieveShared *S)
+{
+    int64_t a = relations[relation_count].a, b = relations[relation_count].b;
+    if (!consume_relation())
+    {
+        S->duplicates++;
+        return;
+    }
+    S->relations++;
+    if (S->out)
+        fprintf(S->out, "%" PRId64 " %" PRId64 "\n", a, b);
+    // b is the line: a strip cut short counts up to its last relation merged
+    if (S->strip && (b - 1) % S->strip + 1 > S->reach[(b - 1) / S->strip])
+        S->reach[(b - 1) / S->strip] = (b - 1) % S->strip + 1;
+}
+
+// Unit u is merged in full; mark the special q done in order
+static void sieve_unit_done(SieveShared *S, uint32_t u)
+{
+    if (relations_full())
+        return;
+    S->unit_done[u] = 1;
+    // A q is written as done with its last root and every q below it, so a resume skips nothing unsieved
+    for (; S->frontier < S->units && S->unit_done[S->frontier]; S->frontier++)
+    {
+        uint32_t q = S->ideal ? alg_fb.p[S->ideal[S->frontier]] : 0;
+        if (S->out && (S->frontier + 1 == S->units || alg_fb.p[S->ideal[S->frontier + 1]] != q))
+            fprintf(S->out, "# special-q %u done\n", q);
+    }
+    if (S->out)
+        fflush(S->out);
+}
+
+// Take every batch pushed so far and merge them in the order they came; 0 if there were none
+static int sieve_merge(SieveShared *S)
+{
+    RelationBatch *bt = atomic_exchange(&S->batches, NULL), *order = NULL;
+    if (!bt)
+        return 0;
+    while (bt)
+    {
+        RelationBatch *next = bt->next;
+        atomic_fetch_sub(&S->pending, 1);
+        bt->next = order;
+        order = bt;
+        bt = next;
+    }
+    while ((bt = order) != NULL)
+    {
+        order = bt->next;
+        for (int i = 0; i < bt->count && !relations_full() && !S->failed; i++)
+        {
+            const Relation *src = &bt->rels[i];
+            Relation *rel = relation_slot();
+            if (!rel)
+            {
+                S->failed = 1;
+                break;
+            }
+            *rel = *src;
+            rel->first = factors_used;
+            for (uint32_t j = 0; j < (uint32_t)src->a_count + src->r_count && !S->failed; j++)
+                S->failed = !factors_push(bt->factors[src->first + j].index, bt->factors[src->first + j].exp);
+            if (S->failed)
+            {
+                factors_used = rel->first;
+                break;
+            }
+            sieve_keep(S);
+        }
+        if (bt->unit != UINT32_MAX)
+            sieve_unit_done(S, bt->unit);
+        arena_release(&bt->arena);
+        free(bt);
+    }
+    if (relations_full() || S->failed)
+        atomic_store(&S->stop, 1);
+    return 1;
+}
+
+/*
+ * Sieve unit u into this worker's store, handing it over every
+ * SIEVE_BATCH relations and when the unit is done. Returns 0 once the
+ * sieve is to stop.
+ */
+static int sieve_unit(SieveShared *S, uint32_t u)
+{
+    const uint32_t *primes = job_primes;
+    int64_t W = 2 * S->half, J = S->half;
+    Lattice L;
+    lattice_identity(&L);
+    if (S->strip)
+    {
+        // The identity lattice's roots were set when the worker started
+        L.j0 = (int64_t)u * S->strip;
+        J = sieve_strip_lines(S, u);
+    }
+    else
+    {
+        lattice_reduce(alg_fb.p[S->ideal[u]], alg_fb.r[S->ideal[u]], &L);
+        lattice_roots(primes, S->fb_base, &L);
+    }
+    
+    int blocks = bucket_fill(primes, S->fb_base, &L, -S->half, W, J);
+    struct timespec poll = {0, SIEVE_POLL_NS};
+    for (int blk = 0; blk < blocks; blk++)
+    {
+        while (atomic_load(&S->pending) >= SIEVE_BACKLOG * sieve_threads && !atomic_load(&S->stop))
+            nanosleep(&poll, NULL);
+        if (atomic_load(&S->stop))
+            return 0;
+        int hits = sieve_block(primes, S->f, &L, -S->half, W, J, blk);
+        atomic_fetch_add(&S->survivors, (uint_fast64_t)hits);
+        for (int h = 0; h < hits; h++)
+        {
+            int64_t a = sieve_hits_a[h], b = sieve_hits_b[h];
+            if (gcd_u64((a < 0) ? -(uint64_t)a : (uint64_t)a, (uint64_t)b) != 1)
+                continue;
+            Relation *rel = relation_slot();
+            if (!rel)
+            {
+                fprintf(stderr, "Error: out of memory for relations\n");
+                return 0;
+            }
+            if (!factor_pair(a, b, S->f, primes, S->fb_base, h, rel))
+                continue;
+            if (++relation_count >= SIEVE_BATCH && !sieve_hand_over(S, UINT32_MAX))
+                return 0;
+        }
+    }
+    return sieve_hand_over(S, u);
+}
+
+static void *sieve_worker(void *arg)
+{
+    SieveShared *S = arg;
+    Arena own = {NULL, 0};
+    store_arena = &own;
+    int ok = lattice_tables(S->fb_base);
+    if (ok && S->strip)
+    {
+        Lattice L;
+        lattice_identity(&L);
+        lattice_roots(job_primes, S->fb_base, &L);
+    }
+    while (ok && !atomic_load(&S->stop))
+    {
+        uint32_t u = atomic_fetch_add(&S->next_unit, 1);
+        if (u >= S->units)
+            break;
+        ok = sieve_unit(S, u);
+    }
+    if (!ok)
+        atomic_store(&S->stop, 1);
+    arena_release(&own);   // the part of a unit the stop cut off
+    sieve_thread_release();
+    atomic_fetch_sub(&S->active, 1);
+    return NULL;
+}
+
+/*
+ * Sieve S's units on sieve_threads workers and merge what they find,
+ * after sieve_init on this thread. Returns 0 when nothing could start.
+ */
+static int sieve_parallel(SieveShared *S)
+{
+    pthread_t tid[MAX_THREADS];
+    int started = 0;
+    S->unit_done = calloc(S->units + 1, 1);
+    S->reach = S->strip ? calloc(S->units + 1, sizeof(int64_t)) : NULL;
+    // spf_init now, so the workers' cofactorizations only ever read the table
+    if (!spf_init() || !S->unit_done || (S->strip && !S->reach))
+    {
+        free(S->unit_done);
+        free(S->reach);
+        return 0;
+    }
+    atomic_init(&S->next_unit, 0);
+    atomic_init(&S->stop, relations_full());   // relations read back may have filled it
+    atomic_init(&S->active, 0);
+    atomic_init(&S->batches, NULL);
+    atomic_init(&S->pending, 0);
+    atomic_init(&S->survivors, 0);
+    for (int t = 0; t < sieve_threads && t < MAX_THREADS; t++)
+    {
+        atomic_fetch_add(&S->active, 1);
+        if (pthread_create(&tid[started], NULL, sieve_worker, S) != 0)
+        {
+            atomic_fetch_sub(&S->active, 1);
+            break;
+        }
+        started++;
+    }
+    
+    // Merge until every worker is out, then take what they left
+    struct timespec poll = {0, SIEVE_POLL_NS};
+    while (atomic_load(&S->active) > 0)
+        if (!sieve_merge(S))
+            nanosleep(&poll, NULL);
+    for (int t = 0; t < started; t++)
+        pthread_join(tid[t], NULL);
+    sieve_merge(S);
+    for (uint32_t u = 0; S->strip && u < S->units; u++)
+        S->lines += S->unit_done[u] ? sieve_strip_lines(S, u) : S->reach[u];
+    free(S->unit_done);
+    free(S->reach);
+    S->unit_done = NULL;
+    S->reach = NULL;
+    return started > 0;
+}
+
+// ============ (a, b) region sieve ============
+
+// What a region run covered: lines 1 <= b <= rows of half-width A
+typedef struct {
+    int64_t A, rows;
+    uint64_t relations;          // full and partial
+    uint32_t full, partial[2], cycles;
+    double seconds, la_seconds;  // sieving, then the matrix stage (wall clock)
+    double cpu_seconds;          // sieving, summed over the sieve threads
+} RegionStats;
+
+// Sieve the (a, b) region of the job started by job_begin until the matrix is full
+static void sieve_region(const SnfsPoly *f, int fb_base, int area, RegionStats *st)
+{
+    uint32_t *primes = job_primes;
+    if (!matrix_begin() || !sieve_init(primes, fb_base, f))
+    {
+        fprintf(stderr, "Error: out of memory for the sieve tables\n");
+        return;
+    }
+    Lattice L;
+    lattice_identity(&L);
+    lattice_roots(primes, fb_base, &L);
+    int64_t A = sieve_half_width(area, f);
+    st->A = A;
+    if (sieve_threads > 0)
+    {
+        SieveShared S;
+        memset(&S, 0, sizeof(S));
+        S.f = f;
+        S.fb_base = fb_base;
+        S.half = A;
+        S.strip = SIEVE_BLOCK / (2 * A);
+        if (S.strip < 1)
+            S.strip = 1;
+        S.units = (uint32_t)((A + S.strip - 1) / S.strip);
+        if (!sieve_parallel(&S))
+            fprintf(stderr, "Error: out of memory for the sieve threads\n");
+        st->rows = S.lines;
+        st->relations = S.relations;
+        return;
+    }
+    int blocks = bucket_fill(primes, fb_base, &L, -A, 2 * A, A);
+    
+    for (int blk = 0; blk < blocks; blk++)
+    {
+        int hits = sieve_block(primes, f, &L, -A, 2 * A, A, blk);
+        // Lines are only counted once finished, unless the run ends inside one
+        st->rows = ((int64_t)(blk + 1) * SIEVE_BLOCK < 2 * A * A) ? (int64_t)(blk + 1) * SIEVE_BLOCK / (2 * A) : A;
+        
+        for (int h = 0; h < hits; h++)
+        {
+            if (relations_full())
+            {
+                st->rows = sieve_hits_b[h];
+                return;
+            }
+            
+            int64_t a = sieve_hits_a[h], b = sieve_hits_b[h];
+            if (gcd_u64((a < 0) ? -(uint64_t)a : (uint64_t)a, (uint64_t)b) != 1)
+                continue;
+            Relation *rel = relation_slot();
+            if (!rel)
+            {
+                fprintf(stderr, "Error: out of memory for relations\n");
+                return;
+            }
+            if (!factor_pair(a, b, f, primes, fb_base, h, rel))
+                continue;
+            st->relations += consume_relation();
+        }
+    }
+}
+
+u128 snfs_factor(u128 n, const SnfsPoly *f, int fb_bound, int area, RegionStats *st)
+{
+    memset(st, 0, sizeof(*st));
+    int fb_base = job_begin(fb_bound, f);
+    if (fb_base == 0)
+    {
+        fprintf(stderr, "Error: factor base generation failed\n");
+        return 0;
+    }
+    clock_t start = clock();
+    double wall = wall_seconds();
+    sieve_region(f, fb_base, area, st);
+    st->seconds = wall_seconds() - wall;
+    st->cpu_seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+    u128 factor = solve_matrix(n, job_primes, fb_base);
+    st->la_seconds = matrix_stats.filter_seconds + matrix_stats.merge_seconds + matrix_stats.la_seconds;
+    st->full = full_count;
+    st->partial[0] = partial_count[0];
+    st->partial[1] = partial_count[1];
+    st->cycles = cycle_count;
+    job_end();
+    return factor;
+}
+
+// ============ Special-q lattice sieve ============
+
+/*
+ * For each prime q in [q0, q1) of the factor base and each affine root r
+ * of f mod q, sieve the (i, j) square of ~area positions in the reduced
+ * lattice a == r b (mod q). Every pair found has q | F(a, b), so the
+ * algebraic side left to be smooth is q times smaller, and each q adds a
+ * fresh small region instead of growing the one square.
+ *
+ * With a relations file every relation is appended as "a b", and
+ * "# special-q <q> done" follows each finished q. A later run (same n, f,
+ * B) reads the file back into the matrix and skips the q already done, so
+ * a range can be split across runs or resumed after a kill.
+ */
+
+typedef struct {
+    uint32_t q_count, root_count;
+    uint64_t survivors, relations, duplicates;
+    double seconds, cpu_seconds;    // wall clock, and CPU summed over the sieve threads
+} SpecialQStats;
+
+/*
+ * Read relations back from path into the matrix. Sets *q_done to the
+ * largest finished special q.
+ */
+static void load_relations(const char *path, const SnfsPoly *f, uint32_t *primes, int fb_size, uint32_t *q_done)
+{
+    FILE *in = fopen(path, "r");
+    if (!in)
+        return;
+    char line[128];
+    int loaded = 0;
+    while (fgets(line, sizeof(line), in) && !relations_full())
+    {
+        long long a, b;
+        unsigned q;
+        if (sscanf(line, "# special-q %u done", &q) == 1)
+        {
+            if (q > *q_done)
+                *q_done = q;
+            continue;
+        }
+        if (sscanf(line, "%lld %lld", &a, &b) != 2 || b <= 0)
+            continue;
+        Relation *rel = relation_slot();
+        if (!rel)
+            break;
+        if (!factor_pair(a, b, f, primes, fb_size, -1, rel))
+            continue;
+        loaded += consume_relation();
+    }
+    fclose(in);
+    printf("Loaded %d relations from %s (special q <= %u done)\n", loaded, path, *q_done);
+}
+
+// Special-q sieve over the job started by job_begin, until the matrix is full
+static void sieve_special_q(const SnfsPoly *f, int fb_base, int area, uint32_t q0, uint32_t q1, const char *rel_path, SpecialQStats *st)
+{
+    uint32_t *primes = job_primes;
+    if (!matrix_begin() || !sieve_init(primes, fb_base, f))
+    {
+        fprintf(stderr, "Error: out of memory for the sieve tables\n");
+        return;
+    }
+    
+    uint32_t q_done = 0;
+    FILE *out = NULL;
+    if (rel_path)
+    {
+        load_relations(rel_path, f, primes, fb_base, &q_done);
+        out = fopen(rel_path, "a");
+        if (!out)
+            fprintf(stderr, "Warning: cannot append to %s\n", rel_path);
+    }
+    
+    int64_t I = sieve_half_width(area, f);
+    clock_t start = clock();
+    double wall = wall_seconds();
+    if (sieve_threads > 0)
+    {
+        // One unit per affine ideal (q, r), a projective one (q | b) having no lattice of this shape
+        SieveShared S;
+        uint32_t *ideal = malloc((alg_fb.ideal_count + 1) * sizeof(uint32_t));
+        memset(&S, 0, sizeof(S));
+        S.f = f;
+        S.fb_base = fb_base;
+        S.half = I;
+        S.ideal = ideal;
+        S.out = out;
+        for (int k = 0; ideal && k < fb_base; k++)
+            if (primes[k] >= q0 && primes[k] < q1 && primes[k] > q_done)
+                for (uint32_t t = alg_fb.first[k]; t < alg_fb.first[k + 1]; t++)
+                    if (alg_fb.r[t] != primes[k])
+                        ideal[S.units++] = t;
+        if (!ideal || !sieve_parallel(&S))
+            fprintf(stderr, "Error: out of memory for the sieve threads\n");
+        uint32_t claimed = (atomic_load(&S.next_unit) < S.units) ? atomic_load(&S.next_unit) : S.units;
+        for (uint32_t u = 0; u < claimed; u++)
+            st->q_count += (u == 0 || alg_fb.p[ideal[u]] != alg_fb.p[ideal[u - 1]]);
+        st->root_count = claimed;
+        st->survivors = atomic_load(&S.survivors);
+        st->relations = S.relations;
+        st->duplicates = S.duplicates;
+        free(ideal);
+        goto done;
+    }
+    for (int k = 0; k < fb_base && !relations_full(); k++)
+    {
+        uint32_t q = primes[k];
+        if (q < q0 || q >= q1 || q <= q_done || alg_fb.first[k] == alg_fb.first[k + 1])
+            continue;
+        st->q_count++;
+        
+        for (uint32_t t = alg_fb.first[k]; t < alg_fb.first[k + 1]; t++)
+        {
+            // A projective q (q | c_d) would mean q | b: not a lattice of this shape
+            if (alg_fb.r[t] == q)
+                continue;
+            Lattice L;
+            lattice_reduce(q, alg_fb.r[t], &L);
+            lattice_roots(primes, fb_base, &L);
+            st->root_count++;
+            
+            int blocks = bucket_fill(primes, fb_base, &L, -I, 2 * I, I);
+            for (int blk = 0; blk < blocks; blk++)
+            {
+                int hits = sieve_block(primes, f, &L, -I, 2 * I, I, blk);
+                st->survivors += hits;
+                
+                for (int h = 0; h < hits; h++)
+                {
+                    if (relations_full())
+                        break;
+                    int64_t a = sieve_hits_a[h], b = sieve_hits_b[h];
+                    if (gcd_u64((a < 0) ? -(uint64_t)a : (uint64_t)a, (uint64_t)b) != 1)
+                        continue;
+                    Relation *rel = relation_slot();
+                    if (!rel)
+                    {
+                        fprintf(stderr, "Error: out of memory for relations\n");
+                        goto done;
+                    }
+                    if (!factor_pair(a, b, f, primes, fb_base, h, rel))
+                        continue;
+                    // A pair divisible by two special q turns up under both
+                    if (!consume_relation())
+                    {
+                        st->duplicates++;
+                        continue;
+                    }
+                    st->relations++;
+                    if (out)
+                        fprintf(out, "%" PRId64 " %" PRId64 "\n", a, b);
+                }
+            }
+        }
+        if (out && !relations_full())
+        {
+            fprintf(out, "# special-q %u done\n", q);
+            fflush(out);
+        }
+    }
+done:
+    st->seconds = wall_seconds() - wall;
+    st->cpu_seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+    if (out)
+        fclose(out);
+}
+
+u128 snfs_factor_lattice(u128 n, const SnfsPoly *f, int fb_bound, int area, uint32_t q0, uint32_t q1, const char *rel_path, SpecialQStats *st)
+{
+    memset(st, 0, sizeof(*st));
+    int fb_base = job_begin(fb_bound, f);
+    if (fb_base == 0)
+    {
+        fprintf(stderr, "Error: factor base generation failed\n");
+        return 0;
+    }
+    sieve_special_q(f, fb_base, area, q0, q1, rel_path, st);
+    u128 factor = solve_matrix(n, job_primes, fb_base);
+    job_end();
+    return factor;
+}
+
+// ============ Polynomial selection ============
+
+/*
+ * n = a b^k + c gives one binomial pair per degree d. With k = d t + s,
+ *   f = a b^s x^d + c,            m = b^t
+ *   f = a x^d + c b^(d - s),      m = b^(t + 1)   (s > 0, f(m) = b^(d - s) n)
+ * and g = x - m either way. A candidate is scored by the relations it
+ * should give in the region it would sieve: over a grid of (a, b), the
+ * chance that |a - b m| and |F(a, b)| are both B-smooth but for one prime
+ * up to lp_bound (Dickman rho), times the number of coprime pairs. As in
+ * Murphy's E, log |F| is shifted by alpha(f), which measures how much more
+ * often than a random integer F is divisible by small primes.
+ */
+
+#define SEL_MAX_FORMS 16
+#define SEL_MAX_CANDIDATES (2 * SEL_MAX_FORMS * (MAX_DEGREE + 1))
+#define SEL_SHOW 8           // candidates listed
+#define ALPHA_BOUND 2000     // alpha sums over the primes below this
+#define YIELD_GRID 64        // samples along a; half as many along b
+#define DICKMAN_STEPS 128        // Dickman rho table points per unit of u
+#define DICKMAN_MAX_U 24
+
+typedef struct {
+    SnfsPoly f;
+    PowerForm form;
+    double alpha;            // of f; the rational side's is alpha_linear
+    double e;                // mean smoothness probability over the region
+    double predicted;        // relations in the full region
+} PolyCandidate;
+
+// x^d + 1 with m = floor((n - 1)^(1/d)); f(m) == n only for n = m^d + 1
+static SnfsPoly poly_xd_plus_1(u128 n, int degree)
+{
+    return (SnfsPoly){degree, 1, 1, int_root(n > 1 ? n - 1 : n, degree)};
+}
+
+static void format_poly(char *buf, size_t len, const SnfsPoly *f)
+{
+    char lead[32] = "";
+    if (f->cd != 1)
+        snprintf(lead, sizeof(lead), "%" PRId64 " ", f->cd);
+    snprintf(buf, len, "%sx^%d %c %" PRIu64, lead, f->degree, (f->c0 < 0) ? '-' : '+',
+             (f->c0 < 0) ? -(uint64_t)f->c0 : (uint64_t)f->c0);
+}
+
+static double dickman_rho(double u)
+{
+    static double table[DICKMAN_MAX_U * DICKMAN_STEPS + 1];
+    if (u <= 1.0)
+        return 1.0;
+    if (u >= DICKMAN_MAX_U)
+        return 0.0;
+    if (table[0] == 0.0)
+    {
+        // rho = 1 on [0, 1], then u rho'(u) = -rho(u - 1) by the trapezoid rule
+        for (int i = 0; i <= DICKMAN_STEPS; i++)
+            table[i] = 1.0;
+        for (int i = DICKMAN_STEPS + 1; i <= DICKMAN_MAX_U * DICKMAN_STEPS; i++)
+        {
+            double u1 = (double)i / DICKMAN_STEPS, u0 = u1 - 1.0 / DICKMAN_STEPS;
+            table[i] = table[i - 1] - 0.5 / DICKMAN_STEPS * (table[i - 1 - DICKMAN_STEPS] / u0 + table[i - DICKMAN_STEPS] / u1);
+        }
+    }
+    double x = u * DICKMAN_STEPS;
+    int i = (int)x;
+    return table[i] + (x - i) * (table[i + 1] - table[i]);
+}
+
+/*
+ * Chance that an integer of log size lx is e^lB-smooth apart from at most
+ * one prime up to e^lL: rho(u) plus, for each such prime q, 1/q times the
+ * chance that x / q is smooth, summed as an integral over t = ln q.
+ */
+static double semismooth_prob(double lx, double lB, double lL)
+{
+    double prob = dickman_rho(lx / lB);
+    double hi = (lL < lx) ? lL : lx;
+    if (hi <= lB)
+        return prob;
+    int steps = 32;
+    double h = (hi - lB) / steps, sum = 0.0;
+    for (int k = 0; k < steps; k++)
+    {
+        double t = lB + (k + 0.5) * h;
+        sum += dickman_rho((lx - t) / lB) / t;
+    }
+    return prob + sum * h;
+}
+
+/*
+ * alpha = sum over p < ALPHA_BOUND of (1 - q_p p / (p + 1)) ln p / (p - 1),
+ * q_p the roots of f mod p counting the projective one. Negative is good:
+ * F values then behave like integers e^alpha times smaller. f = NULL gives
+ * a linear g, q_p = 1.
+ */
+static double poly_alpha(const SnfsPoly *f)
+{
+    double alpha = 0.0;
+    for (uint32_t p = 2; p < ALPHA_BOUND; p++)
+    {
+        if (!is_prime_u64(p))
+            continue;
+        uint32_t roots[MAX_DEGREE];
+        int q = f ? poly_roots_mod(f, p, roots) : 1;
+        alpha += (1.0 - q * (double)p / (p + 1)) * log((double)p) / (p - 1);
+    }
+    return alpha;
+}
+
+/*
+ * Expected relations from the lines 1 <= b <= rows of the region a in
+ * [-A, A). *e gets the mean probability that a pair is a relation.
+ */
+static double poly_yield(const SnfsPoly *f, double alpha, int fb_bound, int64_t A, int64_t rows, double *e)
+{
+    static double alpha_g = 1e9;
+    if (alpha_g == 1e9)
+        alpha_g = poly_alpha(NULL);
+    double lB = log((double)fb_bound), lL = log((double)lp_bound);
+    double sum = 0.0;
+    for (int i = 0; i < YIELD_GRID; i++)
+    {
+        double a = -A + (i + 0.5) * 2.0 * A / YIELD_GRID;
+        for (int j = 0; j < YIELD_GRID / 2; j++)
+        {
+            double b = 0.5 + (j + 0.5) * rows / (YIELD_GRID / 2);
+            double g = fabs(a - b * (double)f->m);
+            double F = fabs(f->cd * pow(a, f->degree) + f->c0 * pow(b, f->degree));
+            sum += semismooth_prob(log((g > 1.0) ? g : 1.0) + alpha_g, lB, lL) *
+                   semismooth_prob(log((F > 1.0) ? F : 1.0) + alpha, lB, lL);
+        }
+    }
+    *e = sum / (YIELD_GRID * (YIELD_GRID / 2));
+    return *e * 6.0 / (M_PI * M_PI) * 2.0 * A * rows;
+}
+
+// Score c->f for a region run with this B and area
+static void poly_score(PolyCandidate *c, int fb_bound, int area)
+{
+    int64_t A = sieve_half_width(area, &c->f);
+    c->alpha = poly_alpha(&c->f);
+    c->predicted = poly_yield(&c->f, c->alpha, fb_bound, A, A, &c->e);
+}
+
+/*
+ * Pair number variant (0 or 1, as in the comment above) of degree d for
+ * the form, with the content of f divided out. Rejects pairs whose content
+ * is not prime to n, whose coefficients leave int64_t or whose m passes
+ * 40 bits, so b m stays in range for the sieve.
+ */
+static int poly_from_form(u128 n, const PowerForm *pf, int d, int variant, SnfsPoly *f)
+{
+    int t = pf->k / d, s = pf->k % d;
+    if (variant == 1 && s == 0)
+        return 0;
+    int e_m = variant ? t + 1 : t, e_cd = variant ? 0 : s, e_c0 = variant ? d - s : 0;
+    uint64_t abs_c = (pf->c < 0) ? -(uint64_t)pf->c : (uint64_t)pf->c;
+    u128 m = pow_u128_checked(pf->b, e_m);
+    u128 scale_d = pow_u128_checked(pf->b, e_cd), scale_0 = pow_u128_checked(pf->b, e_c0);
+    if (e_m < 1 || m == 0 || bit_length_u128(m) > 40 || scale_d == 0 || scale_0 == 0 ||
+        bit_length_u128(scale_d) + bit_length_u128(pf->a) > 62 || bit_length_u128(scale_0) + bit_length_u128(abs_c) > 62)
+        return 0;
+    uint64_t cd = (uint64_t)(scale_d * pf->a), c0 = (uint64_t)(scale_0 * abs_c);
+    // A common factor shared with n would divide every F(a, b) and no ideal
+    uint64_t common = gcd_u64(cd, c0);
+    if (gcd_u128(common, n) != 1)
+        return 0;
+    cd /= common;
+    c0 /= common;
+    
+    *f = (SnfsPoly){d, (int64_t)cd, (pf->c < 0) ? -(int64_t)c0 : (int64_t)c0, m};
+    // f(m) == 0 (mod n) by construction; check anyway
+    u128 lead = mul_mod(cd % n, pow_mod(m % n, d, n), n), tail = c0 % n;
+    u128 fm = (pf->c < 0) ? (lead + n - tail) % n : (lead + tail) % n;
+    return fm == 0;
+}
+
+static int compare_candidates(const void *x, const void *y)
+{
+    double px = ((const PolyCandidate *)x)->predicted, py = ((const PolyCandidate *)y)->predicted;
+    return (px < py) - (px > py);
+}
+
+/*
+ * Candidate pairs of degree 4..8 (or just degree, if nonzero) from every
+ * form of n, scored for B and area, best predicted yield first. cand[]
+ * needs SEL_MAX_CANDIDATES entries; *nforms gets the forms found.
+ */
+static int poly_candidates(u128 n, int degree, int fb_bound, int area, PolyCandidate *cand, int *nforms_out)
+{
+    PowerForm forms[SEL_MAX_FORMS];
+    int nforms = detect_power_forms(n, forms, SEL_MAX_FORMS);
+    int d_lo = degree ? degree : 4, d_hi = degree ? degree : 8;
+    int count = 0;
+    for (int i = 0; i < nforms; i++)
+    {
+        for (int d = d_lo; d <= d_hi; d++)
+        {
+            for (int variant = 0; variant < 2; variant++)
+            {
+                SnfsPoly f;
+                if (!poly_from_form(n, &forms[i], d, variant, &f))
+                    continue;
+                int seen = 0;
+                for (int j = 0; j < count && !seen; j++)
+                    seen = (cand[j].f.degree == d && cand[j].f.cd == f.cd && cand[j].f.c0 == f.c0 && cand[j].f.m == f.m);
+                if (seen)
+                    continue;
+                cand[count].f = f;
+                cand[count].form = forms[i];
+                poly_score(&cand[count], fb_bound, area);
+                count++;
+            }
+        }
+    }
+    qsort(cand, count, sizeof(cand[0]), compare_candidates);
+    *nforms_out = nforms;
+    return count;
+}
+
+static void print_candidate(const PolyCandidate *c)
+{
+    char form[64], poly[64];
+    const PowerForm *pf = &c->form;
+    snprintf(form, sizeof(form), "%" PRIu64 "*%" PRIu64 "^%d %c %" PRIu64, pf->a, (uint64_t)pf->b, pf->k,
+             (pf->c < 0) ? '-' : '+', (pf->c < 0) ? -(uint64_t)pf->c : (uint64_t)pf->c);
+    format_poly(poly, sizeof(poly), &c->f);
+    printf("  %-22s %-26s %14" PRIu64 " %7.2f %10.3e %10.1f", form, poly, (uint64_t)c->f.m, c->alpha, c->e, c->predicted);
+}
+
+/*
+ * Run the selection for a job with this B and area: list the leading
+ * candidates and put the winner in *best. Returns 0 if n has no usable form.
+ */
+static int select_polynomial(u128 n, int degree, int fb_bound, int area, PolyCandidate *best)
+{
+    static PolyCandidate cand[SEL_MAX_CANDIDATES];
+    int nforms;
+    int count = poly_candidates(n, degree, fb_bound, area, cand, &nforms);
+    if (count == 0)
+        return 0;
+    
+    printf("polynomial selection: %d candidates from %d forms, g = x - m, ranked by predicted relations\n", count, nforms);
+    printf("  %-22s %-26s %14s %7s %10s %10s\n", "form", "f", "m", "alpha", "E", "predicted");
+    for (int i = 0; i < count && i < SEL_SHOW; i++)
+    {
+        print_candidate(&cand[i]);
+        printf("%s\n", (i == 0) ? "  <- chosen" : "");
+    }
+    *best = cand[0];
+    return 1;
+}
+
+// ============ CLI / demo ============
+
+/*
+ * Cheap stages ahead of the (checkpointable) rho walk, all driven by the
+ * hint from the special form. Returns a factor, or 0 with *rho set up to
+ * walk x^k + c.
+ */
+static u128 fallback_stages(u128 n, const SpecialForm *sf, RhoState128 *rho)
+{
+    FactorHint hint = hint_from_form(n, sf);
+    if (hint.algebraic)
+    {
+        printf("  algebraic factor of the special form\n");
+        return hint.algebraic;
+    }
+    if (hint.modulus > 2)
+        printf("  hint: every odd prime factor is 1 mod %u\n", hint.modulus);
+    
+    uint64_t bound = 0;
+    u128 p = trial_divide_hinted(n, hint.modulus, &bound);
+    if (p)
+        return p;
+    printf("  trial division: no factor up to %" PRIu64 "\n", bound);
+    
+    p = pm1_u128(n, PM1_B1, hint.modulus);
+    if (p)
+    {
+        printf("  p - 1 (B1 = %d) found a factor\n", PM1_B1);
+        return p;
+    }
+    printf("  p - 1 (B1 = %d): no factor\n", PM1_B1);
+    
+    printf("  Pollard rho on x^%u + c\n", (hint.modulus > 2) ? hint.modulus : 2);
+    rho_init_u128(rho, n, hint.modulus);
+    return 0;
+}
+
+// The matrix stage of the last job: shape around filtering and merging, then timings
+static void print_matrix_stats(void)
+{
+    const MatrixStats *ms = &matrix_stats;
+    printf("matrix: %u x %u (%" PRIu64 " nonzeros) -> %u x %u (%" PRIu64 ") after dropping %" PRIu64
+           " duplicates, %u singletons, %u clique rows\n", ms->before.rows, ms->before.cols, ms->before.weight,
+           ms->after.rows, ms->after.cols, ms->after.weight, ms->duplicates, ms->singletons, ms->cliques);
+    printf("merged: %u columns eliminated -> %u x %u (%" PRIu64 " nonzeros)\n", ms->merged_cols, ms->merged.rows,
+           ms->merged.cols, ms->merged.weight);
+    printf("LA %.3fs: filtered %.3fs, merged %.3fs, solved %.3fs (%s",
+           ms->filter_seconds + ms->merge_seconds + ms->la_seconds, ms->filter_seconds, ms->merge_seconds, ms->la_seconds,
+           ms->solver ? ms->solver : "none");
+    if (ms->iterations)
+        printf(", %u iterations, %d thread%s", ms->iterations, ms->threads, (ms->threads == 1) ? "" : "s");
+    printf("), %u dependencies\n\n", ms->dependencies);
+}
+
+// ============ Benchmark: double-and-add vs Montgomery / Barrett / fold ============
+
+static double bench_mul_mod(u128 n, int ops)
+{
+    u128 x = n / 3 + 1, y = n / 5 + 7;
+    volatile u128 sink;
+    clock_t start = clock();
+    for (int i = 0; i < ops; i++)
+        x = mul_mod(x, y, n) + 1;
+    sink = x;
+    (void)sink;
+    return (double)(clock() - start) / CLOCKS_PER_SEC / ops;
+}
+
+// One engine's product on its own representation; -1 if it cannot take n
+static double bench_engine(u128 n, int kind, int ops)
+{
+    set_mulmod_engine(kind);
+    ModCtx M = *mod_ctx(n);
+    set_mulmod_engine(MOD_AUTO);
+    if (M.kind != kind)
+        return -1;
+    u128 x = mod_to(n / 3 + 1, &M), y = mod_to(n / 5 + 7, &M), one = mod_to(1, &M);
+    volatile u128 sink;
+    clock_t start = clock();
+    for (int i = 0; i < ops; i++)
+        x = mod_add(mod_mul(x, y, &M), one, &M);
+    sink = x;
+    (void)sink;
+    return (double)(clock() - start) / CLOCKS_PER_SEC / ops;
+}
+
+static void print_ns(double t)
+{
+    if (t < 0)
+        printf(" %10s", "-");
+    else
+        printf(" %10.1f", t * 1e9);
+}
+
+static double bench_rho(u128 n, u128 *factor)
+{
+    clock_t start = clock();
+    *factor = pollard_rho_u128(n);
+    return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+void run_bench_mulmod()
+{
+    printf("mul_mod: double-and-add vs Montgomery (odd n) / Barrett (even n)\n");
+    printf("=================================================================\n\n");
+    printf("%-6s %-5s %14s %14s %9s\n", "bits", "n", "slow ns/op", "fast ns/op", "speedup");
+    
+    int sizes[] = {40, 64, 90, 120, 126};
+    for (int i = 0; i < 5; i++)
+    {
+        u128 base = ((u128)1 << (sizes[i] - 1)) + 12345;
+        for (int odd = 1; odd >= 0; odd--)
+        {
+            u128 n = base | (u128)odd;
+            set_mulmod_engine(MOD_SLOW);
+            double slow = bench_mul_mod(n, 200000);
+            set_mulmod_engine(MOD_AUTO);
+            double fast = bench_mul_mod(n, 2000000);
+            printf("%-6d %-5s %14.1f %14.1f %8.1fx\n", sizes[i], odd ? "odd" : "even", slow * 1e9, fast * 1e9, slow / fast);
+        }
+    }
+    
+    printf("\nPollard rho (u128 fallback) on semiprimes\n");
+    printf("%-38s %12s %12s %9s\n", "n", "slow", "fast", "speedup");
+    const char *rho_tests[] = {
+        "20199795332516287488257",                  // 614^8 + 1 = 36634737697 * 551383648481
+        "18446791352961204869",                     // 16777259 * 1099511627791
+        "3000000000000000046000000000000000111"     // (10^18 + 3)(3 10^18 + 37): all 1M steps, no split
+    };
+    for (int i = 0; i < 3; i++)
+    {
+        u128 n = parse_u128(rho_tests[i]);
+        u128 f_slow, f_fast;
+        set_mulmod_engine(MOD_SLOW);
+        double slow = bench_rho(n, &f_slow);
+        set_mulmod_engine(MOD_AUTO);
+        double fast = bench_rho(n, &f_fast);
+        printf("%-38s %11.4fs %11.4fs %8.1fx%s\n", rho_tests[i], slow, fast, slow / fast,
+               (f_slow == f_fast) ? "" : "  (factors differ!)");
+    }
+    
+    printf("\nSpecial forms: ns per product, engine picked by default marked *\n");
+    printf("%-24s %10s %10s %10s\n", "n", "Montgomery", "fold", "Barrett");
+    const char *forms[] = {
+        "815730722",                                // 13^8 + 1 (README)
+        "20199795332516287488257",                  // 614^8 + 1 (README)
+        "1267650600228229401496703205341",          // 2^100 - 35
+        "170141183460469231731687303715884105727",  // 2^127 - 1
+        "1267650600228229401496703205442",          // 2^100 + 66
+        "85070591730234615865843651857942052870",   // 2^126 + 6
+    };
+    int kinds[] = {MOD_MONT, MOD_FOLD, MOD_BARRETT};
+    for (int i = 0; i < 6; i++)
+    {
+        u128 n = parse_u128(forms[i]);
+        SpecialForm sf;
+        char label[64] = "generic";
+        if (detect_special_form(n, &sf))
+        {
+            if (sf.m == 2)
+                snprintf(label, sizeof(label), "2^%d %c %" PRIu64, sf.d, (sf.sign > 0) ? '+' : '-', sf.c);
+            else
+                snprintf(label, sizeof(label), "%" PRIu64 "^%d %c %" PRIu64, (uint64_t)sf.m, sf.d, (sf.sign > 0) ? '+' : '-', sf.c);
+        }
+        printf("%-24s", label);
+        int picked = mod_ctx(n)->kind;
+        for (int j = 0; j < 3; j++)
+        {
+            print_ns(bench_engine(n, kinds[j], 2000000));
+            printf("%s", (kinds[j] == picked) ? "*" : " ");
+        }
+        printf("\n");
+    }
+    
+    u128 n = parse_u128(forms[2]);
+    u128 f_mont, f_fold;
+    set_mulmod_engine(MOD_MONT);
+    double t_mont = bench_rho(n, &f_mont);
+    set_mulmod_engine(MOD_FOLD);
+    double t_fold = bench_rho(n, &f_fold);
+    set_mulmod_engine(MOD_AUTO);
+    printf("\nrho on 2^100 - 35: Montgomery %.4fs, fold %.4fs%s\n", t_mont, t_fold,
+           (f_mont == f_fold) ? "" : "  (factors differ!)");
+}
+
+// ============ Benchmark: hinted vs plain fallbacks ============
+
+static double bench_rho_power(u128 n, uint32_t power, uint64_t *steps, u128 *factor)
+{
+    RhoState128 s;
+    rho_init_u128(&s, n, power);
+    clock_t start = clock();
+    *factor = pollard_rho_u128_walk(&s, NULL);
+    *steps = s.total;
+    return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+void run_bench_hints()
+{
+    printf("Fallbacks with and without the p == 1 (mod k) hint\n");
+    printf("===================================================\n\n");
+    printf("%-14s %4s %10s %9s %10s %9s %7s %7s\n", "n", "k", "rho steps", "time", "x^k steps", "time", "p-1", "p-1 k");
+    printf("-------------------------------------------------------------------------------\n");
+    
+    const char *tests[] = {
+        "20199795332516287488257",                  // 614^8 + 1
+        "4242819384959978003251457",                // 1198^8 + 1
+        "5104153908692063061074177",                // 1226^8 + 1
+        "11566398725708262182338817",               // 1358^8 + 1
+        "30113614963390651432960000000000000001",   // 220^16 + 1
+        "70438120351099559671412028074440523777",   // 232^16 + 1
+        "147573952589676412927",                    // 2^67 - 1
+    };
+    int num_tests = sizeof(tests) / sizeof(tests[0]);
+    double total_plain = 0, total_hint = 0;
+    
+    for (int i = 0; i < num_tests; i++)
+    {
+        u128 n = parse_u128(tests[i]);
+        SpecialForm sf;
+        char label[32] = "?";
+        if (detect_special_form(n, &sf))
+            snprintf(label, sizeof(label), "%" PRIu64 "^%d %c %" PRIu64, (uint64_t)sf.m, sf.d, (sf.sign > 0) ? '+' : '-', sf.c);
+        FactorHint hint = hint_from_form(n, &sf);
+        
+        uint64_t steps_plain, steps_hint;
+        u128 f_plain, f_hint;
+        double t_plain = bench_rho_power(n, 2, &steps_plain, &f_plain);
+        double t_hint = bench_rho_power(n, hint.modulus, &steps_hint, &f_hint);
+        total_plain += t_plain;
+        total_hint += t_hint;
+        int pm1_plain = pm1_u128(n, PM1_B1, 1) != 0;
+        int pm1_hint = pm1_u128(n, PM1_B1, hint.modulus) != 0;
+        
+        printf("%-14s %4u %10" PRIu64 " %8.4fs %10" PRIu64 " %8.4fs %7s %7s\n", label, hint.modulus,
+               steps_plain, t_plain, steps_hint, t_hint, pm1_plain ? "yes" : "no", pm1_hint ? "yes" : "no");
+        if (!f_plain || !f_hint)
+            printf("  (rho gave up: %s)\n", !f_plain ? "x^2" : "x^k");
+    }
+    printf("\nrho total: x^2 + c %.4fs, x^k + c %.4fs (%.2fx)\n", total_plain, total_hint, total_plain / total_hint);
+    
+    u128 n = parse_u128(tests[0]);
+    uint64_t bound_plain = 0, bound_hint = 0;
+    trial_divide_hinted(n, 2, &bound_plain);
+    trial_divide_hinted(n, 16, &bound_hint);
+    printf("trial division, %d candidates on 614^8 + 1: odd p up to %" PRIu64 ", p == 1 (mod 16) up to %" PRIu64 "\n",
+           TD_CANDIDATES, bound_plain, bound_hint);
+}
+
+// ============ Benchmark: 1-D line vs 2-D (a, b) region ============
+
+/*
+ * Relations from sieving `area` positions, either on the single line b = 1,
+ * a = m + 1 .. m + area (what snfs_factor sieved before), or over the square
+ * region snfs_factor uses now. Both sides must be smooth in either case, up
+ * to the large primes, and each relation is counted but not kept.
+ */
+static int count_relations(const SnfsPoly *f, int fb_bound, int area, int two_d, double *seconds)
+{
+    static Relation rel;
+    u128 m = f->m;
+    int fb_base = job_begin(fb_bound, f);
+    uint32_t *primes = job_primes;
+    int found = 0;
+    
+    clock_t start = clock();
+    sieve_init(primes, fb_base, f);
+    Lattice L;
+    lattice_identity(&L);
+    lattice_roots(primes, fb_base, &L);
+    int64_t A = two_d ? sieve_half_width(area, f) : 0;
+    int64_t b_max = two_d ? A : 1;
+    int64_t a_lo = two_d ? -A : (int64_t)m + 1;
+    int64_t a_hi = two_d ? A : (int64_t)m + 1 + area;
+    
+    int blocks = bucket_fill(primes, fb_base, &L, a_lo, a_hi - a_lo, b_max);
+    for (int blk = 0; blk < blocks; blk++)
+    {
+        int hits = sieve_block(primes, f, &L, a_lo, a_hi - a_lo, b_max, blk);
+        for (int h = 0; h < hits; h++)
+        {
+            int64_t a = sieve_hits_a[h], b = sieve_hits_b[h];
+            if (gcd_u64((a < 0) ? -(uint64_t)a : (uint64_t)a, (uint64_t)b) == 1 &&
+                factor_pair(a, b, f, primes, fb_base, h, &rel))
+            {
+                found++;
+                factors_used = rel.first;   // counted, not kept
+            }
+        }
+    }
+    *seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+    job_end();
+    return found;
+}
+
+static void bench_sieve_row(u128 n, int degree, int B, int area)
+{
+    double t1, t2;
+    SnfsPoly f = poly_xd_plus_1(n, degree);
+    int r1 = count_relations(&f, B, area, 0, &t1);
+    int r2 = count_relations(&f, B, area, 1, &t2);
+    printf("%6d %9d | %7d %9.0f | %7d %9.0f | ", B, area, r1, r1 / ((t1 > 0) ? t1 : 1e-9), r2,
+           r2 / ((t2 > 0) ? t2 : 1e-9));
+    if (r1 > 0)
+        printf("%7.1fx\n", (double)r2 / r1);
+    else
+        printf("%8s\n", "-");
+}
+
+static void bench_sieve_header(const char *label)
+{
+    printf("%s\n", label);
+    printf("%6s %9s | %7s %9s | %7s %9s | %8s\n", "B", "area", "1-D rels", "rel/s", "2-D rels", "rel/s", "yield");
+}
+
+void run_bench_sieve()
+{
+    printf("Relations (both sides smooth): line b = 1 vs (a, b) region of equal area\n");
+    printf("=========================================================================\n\n");
+    
+    u128 small = parse_u128("815730722");   // 13^8 + 1
+    bench_sieve_header("n = 13^8 + 1, f = x^8 + 1, m = 13");
+    int small_b[] = {50, 100, 200, 500, 1000};
+    for (int i = 0; i < 5; i++)
+        bench_sieve_row(small, 8, small_b[i], 5000);
+    // x^8 + 1 only has roots mod p == 1 (mod 16), so the algebraic base is thin at B = 200
+    for (int area = 20000; area <= 2000000; area *= 10)
+        bench_sieve_row(small, 8, 2000, area);
+    printf("\n");
+    
+    u128 big = parse_u128("20199795332516287488257");   // 614^8 + 1
+    bench_sieve_header("n = 614^8 + 1, f = x^8 + 1, m = 614");
+    int big_b[] = {200, 2000, 20000, 50000};
+    for (int i = 0; i < 4; i++)
+        bench_sieve_row(big, 8, big_b[i], 1000000);
+    printf("\n");
+    
+    u128 cubic = parse_u128("1000000000000001");   // 100000^3 + 1
+    bench_sieve_header("n = 100000^3 + 1, f = x^3 + 1, m = 100000");
+    int cubic_b[] = {200, 2000, 20000};
+    for (int i = 0; i < 3; i++)
+        bench_sieve_row(cubic, 3, cubic_b[i], 200000);
+    printf("\n");
+    
+    printf("On the line |a - b m| stays small but a^d + 1 grows like (m + k)^d;\n");
+    printf("in the square region both a^d + b^d and b m are bounded by the area.\n");
+}
+
+// ============ Benchmark: (a, b) region vs special-q lattices ============
+
+/*
+ * Relations from the first num_q special q >= q0 (every root), each over
+ * ~area positions, without the matrix and without deduplication. Returns
+ * the count and sets *positions to the number of (i, j) sieved.
+ */
+static int count_lattice_relations(u128 n, int degree, int fb_bound, int area, uint32_t q0, int num_q, double *seconds, int64_t *positions)
+{
+    static Relation rel;
+    SnfsPoly f = poly_xd_plus_1(n, degree);
+    int fb_base = job_begin(fb_bound, &f);
+    uint32_t *primes = job_primes;
+    int64_t I = sieve_half_width(area, &f);
+    int found = 0;
+    *positions = 0;
+    
+    clock_t start = clock();
+    sieve_init(primes, fb_base, &f);
+    for (int k = 0; k < fb_base && num_q > 0; k++)
+    {
+        if (primes[k] < q0 || alg_fb.first[k] == alg_fb.first[k + 1])
+            continue;
+        num_q--;
+        for (uint32_t t = alg_fb.first[k]; t < alg_fb.first[k + 1]; t++)
+        {
+            Lattice L;
+            lattice_reduce(primes[k], alg_fb.r[t], &L);
+            lattice_roots(primes, fb_base, &L);
+            *positions += 2 * I * I;
+            int blocks = bucket_fill(primes, fb_base, &L, -I, 2 * I, I);
+            for (int blk = 0; blk < blocks; blk++)
+            {
+                int hits = sieve_block(primes, &f, &L, -I, 2 * I, I, blk);
+                for (int h = 0; h < hits; h++)
+                {
+                    int64_t a = sieve_hits_a[h], b = sieve_hits_b[h];
+                    if (gcd_u64((a < 0) ? -(uint64_t)a : (uint64_t)a, (uint64_t)b) == 1 &&
+                        factor_pair(a, b, &f, primes, fb_base, h, &rel))
+                    {
+                        found++;
+                        factors_used = rel.first;   // counted, not kept
+                    }
+                }
+            }
+        }
+    }
+    *seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+    job_end();
+    return found;
+}
+
+static void bench_lattice_row(u128 n, int degree, int B, int area_q, int num_q)
+{
+    double t_lat, t_reg;
+    int64_t positions;
+    int r_lat = count_lattice_relations(n, degree, B, area_q, (uint32_t)(B / 2), num_q, &t_lat, &positions);
+    SnfsPoly f = poly_xd_plus_1(n, degree);
+    int r_reg = count_relations(&f, B, (int)positions, 1, &t_reg);
+    printf("%6d %7d %4d %10" PRId64 " | %7d %9.0f | %7d %9.0f\n", B, area_q, num_q, positions, r_reg,
+           r_reg / ((t_reg > 0) ? t_reg : 1e-9), r_lat, r_lat / ((t_lat > 0) ? t_lat : 1e-9));
+}
+
+void run_bench_lattice()
+{
+    printf("(a, b) region vs special-q lattices, equal number of sieved positions\n");
+    printf("====================================================================\n\n");
+    printf("Special q: the first q >= B/2 with roots, every root; rel/s is per core (CPU time).\n\n");
+    
+    struct { const char *label; const char *n; int degree; } cases[] = {
+        {"n = 614^8 + 1, f = x^8 + 1", "20199795332516287488257", 8},
+        {"n = 100000^3 + 1, f = x^3 + 1", "1000000000000001", 3},
+    };
+    int configs[][3] = {{2000, 20000, 8}, {20000, 20000, 8}, {50000, 20000, 8}};
+    for (int c = 0; c < 2; c++)
+    {
+        u128 n = parse_u128(cases[c].n);
+        printf("%s\n", cases[c].label);
+        printf("%6s %7s %4s %10s | %7s %9s | %7s %9s\n", "B", "area/q", "q", "positions", "region", "rel/s/core",
+               "lattice", "rel/s/core");
+        for (int i = 0; i < 3; i++)
+            bench_lattice_row(n, cases[c].degree, configs[i][0], configs[i][1], configs[i][2]);
+        printf("\n");
+    }
+    printf("The lattice counts include pairs seen under two special q.\n");
+}
+
+// ============ Benchmark: polynomial selection ============
+
+/*
+ * Predicted vs measured relations for the leading candidates of each n.
+ * The measurement sieves the full region of each pair and counts every
+ * relation, large primes included but not kept, so it sees exactly what
+ * the prediction models.
+ */
+void run_bench_poly()
+{
+    printf("Polynomial selection: predicted vs measured relations per candidate\n");
+    printf("===================================================================\n\n");
+    
+    struct { const char *label; const char *n; int B, area; } cases[] = {
+        {"13^8 + 1", "815730722", 200, 5000},
+        {"2^101 - 1", "2535301200456458802993406410751", 2000, 1000000},
+        {"614^8 + 1", "20199795332516287488257", 20000, 1000000},
+        {"3*5^48 + 2", "10658141036401502788066864013671877", 20000, 1000000},
+    };
+    static PolyCandidate cand[SEL_MAX_CANDIDATES];
+    for (int c = 0; c < 4; c++)
+    {
+        u128 n = parse_u128(cases[c].n);
+        int nforms;
+        int count = poly_candidates(n, 0, cases[c].B, cases[c].area, cand, &nforms);
+        printf("n = %s, B = %d, K = %d: %d candidates from %d forms\n", cases[c].label, cases[c].B, cases[c].area, count, nforms);
+        printf("  %-22s %-26s %14s %7s %10s %10s %9s %6s\n", "form", "f", "m", "alpha", "E", "predicted", "measured", "ratio");
+        int best_measured = 0, best_index = 0;
+        for (int i = 0; i < count && i < SEL_SHOW; i++)
+        {
+            double t;
+            int measured = count_relations(&cand[i].f, cases[c].B, cases[c].area, 1, &t);
+            print_candidate(&cand[i]);
+            printf(" %9d %5.2fx\n", measured, measured / cand[i].predicted);
+            if (measured > best_measured)
+            {
+                best_measured = measured;
+                best_index = i;
+            }
+        }
+        printf("  most relations measured: rank %d of the prediction\n\n", best_index + 1);
+    }
+}
+
+// ============ Benchmark: plain vs bucket sieve ============
+
+// L1D and last-level cache read accesses / misses (generic events have no L2)
+typedef struct {
+    int fd[4];
+} CacheCounters;
+
+static void counters_open(CacheCounters *cc)
+{
+    for (int i = 0; i < 4; i++)
+        cc->fd[i] = -1;
+#ifdef __linux__
+    uint64_t caches[2] = {PERF_COUNT_HW_CACHE_L1D, PERF_COUNT_HW_CACHE_LL};
+    uint64_t results[2] = {PERF_COUNT_HW_CACHE_RESULT_ACCESS, PERF_COUNT_HW_CACHE_RESULT_MISS};
+    for (int i = 0; i < 4; i++)
+    {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HW_CACHE;
+        attr.config = caches[i / 2] | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (results[i % 2] << 16);
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        cc->fd[i] = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    }
+#endif
+}
+
+static void counters_enable(CacheCounters *cc, int on)
+{
+#ifdef __linux__
+    for (int i = 0; i < 4; i++)
+    {
+        if (cc->fd[i] < 0)
+            continue;
+        if (on)
+            ioctl(cc->fd[i], PERF_EVENT_IOC_RESET, 0);
+        ioctl(cc->fd[i], on ? PERF_EVENT_IOC_ENABLE : PERF_EVENT_IOC_DISABLE, 0);
+    }
+#else
+    (void)cc;
+    (void)on;
+#endif
+}
+
+// Miss rate of level (0 = L1D, 1 = LLC) as a percentage, or -1 without counters
+static double counters_miss_rate(const CacheCounters *cc, int level)
+{
+    uint64_t access = 0, miss = 0;
+    if (cc->fd[2 * level] < 0 || cc->fd[2 * level + 1] < 0)
+        return -1.0;
+    if (read(cc->fd[2 * level], &access, sizeof(access)) != sizeof(access) ||
+        read(cc->fd[2 * level + 1], &miss, sizeof(miss)) != sizeof(miss) || access == 0)
+        return -1.0;
+    return 100.0 * miss / access;
+}
+
+static void counters_close(CacheCounters *cc)
+{
+    for (int i = 0; i < 4; i++)
+        if (cc->fd[i] >= 0)
+            close(cc->fd[i]);
+}
+
+// Sieve the whole (i, j) square of L; survivors only, no cofactorization
+static double time_sieve(const uint32_t *primes, int fb_size, const SnfsPoly *f, const Lattice *L, int64_t I, int use_buckets,
+                         uint64_t *survivors, CacheCounters *cc, double miss[2])
+{
+    bucket_sieve = use_buckets;
+    *survivors = 0;
+    counters_enable(cc, 1);
+    clock_t start = clock();
+    int blocks = bucket_fill(primes, fb_size, L, -I, 2 * I, I);
+    for (int blk = 0; blk < blocks; blk++)
+        *survivors += sieve_block(primes, f, L, -I, 2 * I, I, blk);
+    double t = (double)(clock() - start) / CLOCKS_PER_SEC;
+    counters_enable(cc, 0);
+    miss[0] = counters_miss_rate(cc, 0);
+    miss[1] = counters_miss_rate(cc, 1);
+    bucket_sieve = 1;
+    return t;
+}
+
+static void print_miss(const double miss[2])
+{
+    for (int level = 0; level < 2; level++)
+    {
+        if (miss[level] < 0)
+            printf(" %6s", "n/a");
+        else
+            printf(" %5.1f%%", miss[level]);
+    }
+}
+
+void run_bench_bucket()
+{
+    printf("Plain line sieve vs bucket sieve for p >= line width\n");
+    printf("====================================================\n\n");
+    
+    u128 n = parse_u128("20199795332516287488257");   // 614^8 + 1
+    SnfsPoly f = poly_xd_plus_1(n, 8);
+    int area = 1 << 22;
+    int64_t I = sieve_half_width(area, &f);
+    int limits[] = {10000, 100000, 1000000};
+    
+    CacheCounters cc;
+    counters_open(&cc);
+    printf("n = 614^8 + 1, (i, j) square %" PRId64 " x %" PRId64 ", blocks of %d\n", 2 * I, I, SIEVE_BLOCK);
+    printf("miss columns: L1D, LLC read miss rate (n/a: no hardware counters here)\n\n");
+    printf("%8s %7s %-8s %7s %9s %9s | %-13s | %-13s\n", "B", "primes", "lattice", "bucket", "plain s", "bucket s",
+           "plain miss", "bucket miss");
+    
+    for (int c = 0; c < 3; c++)
+    {
+        int B = limits[c];
+        uint32_t *primes = malloc((B / 2 + 1) * sizeof(uint32_t));
+        if (!primes)
+            return;
+        int fb_size = generate_primes(B, primes, B / 2 + 1);
+        if (!sieve_init(primes, fb_size, &f))
+        {
+            free(primes);
+            return;
+        }
+        
+        for (int use_q = 0; use_q < 2; use_q++)
+        {
+            Lattice L;
+            if (use_q)
+            {
+                // First special q above B / 2 that has roots
+                int k = 0;
+                while (k < fb_size - 1 && (primes[k] < (uint32_t)B / 2 || alg_fb.first[k] == alg_fb.first[k + 1]))
+                    k++;
+                lattice_reduce(primes[k], alg_fb.r[alg_fb.first[k]], &L);
+            }
+            else
+                lattice_identity(&L);
+            lattice_roots(primes, fb_size, &L);
+            
+            uint64_t s_plain, s_bucket;
+            double miss_plain[2], miss_bucket[2];
+            double t_plain = time_sieve(primes, fb_size, &f, &L, I, 0, &s_plain, &cc, miss_plain);
+            double t_bucket = time_sieve(primes, fb_size, &f, &L, I, 1, &s_bucket, &cc, miss_bucket);
+            
+            char label[16];
+            snprintf(label, sizeof(label), use_q ? "q=%u" : "(a, b)", L.q);
+            printf("%8d %7d %-8s %7d %8.3fs %8.3fs |", B, fb_size, label, fb_size - bucket_first, t_plain, t_bucket);
+            print_miss(miss_plain);
+            printf(" |");
+            print_miss(miss_bucket);
+            printf("  %5.1fx%s\n", t_plain / ((t_bucket > 0) ? t_bucket : 1e-9),
+                   (s_plain == s_bucket) ? "" : "  SURVIVORS DIFFER");
+        }
+        free(primes);
+    }
+    counters_close(&cc);
+    printf("\nbucket = primes >= the line width %" PRId64 ", walked hit by hit into per-block buckets.\n", 2 * I);
+}
+
+// ============ Benchmark: cofactorization ============
+
+typedef struct {
+    uint64_t survivors, relations[3];    // relations[k]: k large primes
+    double seconds;
+} CofactorRun;
+
+// Sieve and factor the (a, b) region, counting relations by large primes
+static void count_cofactor_run(const SnfsPoly *f, int fb_bound, int area, CofactorRun *run)
+{
+    static Relation rel;
+    memset(run, 0, sizeof(*run));
+    int fb_base = job_begin(fb_bound, f);
+    uint32_t *primes = job_primes;
+    clock_t start = clock();
+    sieve_init(primes, fb_base, f);
+    Lattice L;
+    lattice_identity(&L);
+    lattice_roots(primes, fb_base, &L);
+    int64_t A = sieve_half_width(area, f);
+    int blocks = bucket_fill(primes, fb_base, &L, -A, 2 * A, A);
+    for (int blk = 0; blk < blocks; blk++)
+    {
+        int hits = sieve_block(primes, f, &L, -A, 2 * A, A, blk);
+        run->survivors += hits;
+        for (int h = 0; h < hits; h++)
+        {
+            int64_t a = sieve_hits_a[h], b = sieve_hits_b[h];
+            if (gcd_u64((a < 0) ? -(uint64_t)a : (uint64_t)a, (uint64_t)b) == 1 &&
+                factor_pair(a, b, f, primes, fb_base, h, &rel))
+            {
+                run->relations[(rel.lp[0] != 0) + (rel.lp[1] != 0)]++;
+                factors_used = rel.first;   // counted, not kept
+            }
+        }
+    }
+    run->seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+    job_end();
+}
+
+/*
+ * Relations with and without splitting composite cofactors, then the
+ * composites met on the way split again on their own to time the engines.
+ */
+void run_bench_cofactor()
+{
+    printf("Cofactorization of sieve survivors: extra yield and cofactorizations/s\n");
+    printf("======================================================================\n\n");
+    
+    u128 n = parse_u128("20199795332516287488257");   // 614^8 + 1
+    SnfsPoly f = poly_xd_plus_1(n, 4);
+    int area = 1 << 20;
+    int limits[] = {20000, 50000};
+    int bits[] = {30, 44};
+    static const char *engine_names[] = {"spf", "rho", "squfof", "ecm"};
+    
+    cofactor_log_capacity = 1 << 20;
+    cofactor_log = malloc(cofactor_log_capacity * sizeof(uint64_t));
+    if (!cofactor_log)
+        return;
+    printf("n = 614^8 + 1, f = x^4 + 1, area %d, large primes <= %u, up to 2 per relation\n", area, lp_bound);
+    printf("prime: composite cofactors refused (as before); split: composites go to the engines\n\n");
+    printf("%6s %4s %9s | %-29s | %-29s | %7s %9s\n", "B", "bits", "survivors", "prime: 0/1/2 LP, s",
+           "split: 0/1/2 LP, s", "extra", "cofac/s");
+    for (int c = 0; c < 2; c++)
+    {
+        for (int k = 0; k < 2; k++)
+        {
+            cofactor_bits = bits[k];
+            CofactorRun plain, split;
+            cofactorize = 0;
+            count_cofactor_run(&f, limits[c], area, &plain);
+            cofactorize = 1;
+            cofactor_logged = 0;
+            count_cofactor_run(&f, limits[c], area, &split);
+            
+            // Replay the composites through the dispatch alone
+            memset(&cofac_stats, 0, sizeof(cofac_stats));
+            uint32_t logged = cofactor_logged, lp[2];
+            uint64_t *log = cofactor_log;
+            cofactor_log = NULL;
+            clock_t start = clock();
+            for (uint32_t i = 0; i < logged; i++)
+                cofactor_split(log[i], 2, lp);
+            double t = (double)(clock() - start) / CLOCKS_PER_SEC;
+            cofactor_log = log;
+            
+            uint64_t r_plain = plain.relations[0] + plain.relations[1] + plain.relations[2];
+            uint64_t r_split = split.relations[0] + split.relations[1] + split.relations[2];
+            printf("%6d %4d %9" PRIu64 " | %6" PRIu64 " %7" PRIu64 " %6" PRIu64 " %6.2fs | %6" PRIu64 " %7" PRIu64 " %6" PRIu64
+                   " %6.2fs | %+6.1f%% %9.0f\n", limits[c], bits[k], split.survivors, plain.relations[0], plain.relations[1],
+                   plain.relations[2], plain.seconds, split.relations[0], split.relations[1], split.relations[2], split.seconds,
+                   100.0 * ((double)r_split - r_plain) / ((r_plain > 0) ? r_plain : 1), logged / ((t > 0) ? t : 1e-9));
+            printf("%6s %4s %9s   composites %u:", "", "", "", logged);
+            for (int e = 0; e < COFAC_ENGINES; e++)
+                printf(" %s %" PRIu64 "/%" PRIu64, engine_names[e], cofac_stats.splits[e], cofac_stats.calls[e]);
+            printf("\n");
+        }
+    }
+    cofactor_bits = COFACTOR_BITS;
+    free(cofactor_log);
+    cofactor_log = NULL;
+    printf("\nextra: relations gained by splitting. engine columns: splits/calls on the replay;\n");
+    printf("a split whose factors exceed the bound still counts as a split. A composite\n");
+    printf("cofactor has both primes > B, so 30 bits leaves none to split once B^2 > 2^30.\n");
+}
+
+// ============ Benchmark: large-prime variations ============
+
+/*
+ * Sieve the (a, b) region until the matrix has as many rows as it needs,
+ * keeping no large prime, one per relation, or up to two. Partial
+ * relations only count once a cycle of them closes, so what the large
+ * primes buy is fewer lines sieved; each line costs more, since survivors
+ * with a prime cofactor go on to factoring the other side.
+ */
+void run_bench_lp()
+{
+    printf("Large-prime variations: sieving until the matrix is solvable\n");
+    printf("============================================================\n\n");
+    
+    u128 n = parse_u128("20199795332516287488257");   // 614^8 + 1
+    SnfsPoly f = poly_xd_plus_1(n, 4);
+    int limits[] = {20000, 50000};
+    static const char *names[] = {"none", "single", "double"};
+    
+    // Large primes run up to --lp-bound < 2^32: keys must tell apart q's that differ only in bit 31
+    int keys_ok = 1;
+    for (uint32_t q = 3; q < 1000; q += 2)
+    {
+        uint32_t high = q | 0x80000000u;
+        keys_ok &= lp_key(q, 1) != lp_key(high, 1) && lp_key(q, LP_NONE) != lp_key(high, LP_NONE) &&
+                   lp_key(q, 1) != lp_key(q, LP_NONE) && lp_key(high, 1) != lp_key(high, LP_NONE);
+    }
+    printf("large-prime keys for q and q + 2^31, rational and algebraic: %s\n",
+           keys_ok ? "all distinct" : "COLLISION");
+    printf("n = 614^8 + 1, f = x^4 + 1; rows needed = rational primes + ideals + 18\n\n");
+    printf("%7s %-7s %6s %6s %8s %8s %7s %7s %9s %9s\n", "B", "LP", "rows", "lines", "full", "partial", "cycles",
+           "vertex", "solvable", "LA");
+    for (int c = 0; c < 2; c++)
+    {
+        for (int mode = 0; mode <= 2; mode++)
+        {
+            large_prime_max = mode;
+            RegionStats rs;
+            u128 p = snfs_factor(n, &f, limits[c], 1 << 24, &rs);
+            printf("%7d %-7s %6d %6" PRId64 " %8u %8u %7u %7u %8.3fs %8.3fs%s\n", limits[c], names[mode], rel_capacity,
+                   rs.rows, rs.full, rs.partial[0] + rs.partial[1], rs.cycles, lp_vertex_count,
+                   rs.seconds, rs.la_seconds, p ? "  (split)" : "");
+        }
+    }
+    large_prime_max = 2;
+    printf("\nvertex: distinct large primes seen, plus the vertex 1. The large-prime\n");
+    printf("bound is %u, so only a few partials share a prime before the matrix fills.\n", lp_bound);
+}
+
+// ============ Benchmark: resieving ============
+
+typedef struct {
+    uint64_t survivors, relations;
+    double sieve_seconds, factor_seconds;
+} ResieveRun;
+
+// Sieve and factor the (a, b) region, timing the sieve (with any resieve) and the factoring apart
+static void count_resieve_run(const SnfsPoly *f, int fb_bound, int area, ResieveRun *run)
+{
+    static Relation rel;
+    memset(run, 0, sizeof(*run));
+    int fb_base = job_begin(fb_bound, f);
+    uint32_t *primes = job_primes;
+    clock_t start = clock();
+    sieve_init(primes, fb_base, f);
+    Lattice L;
+    lattice_identity(&L);
+    lattice_roots(primes, fb_base, &L);
+    int64_t A = sieve_half_width(area, f);
+    int blocks = bucket_fill(primes, fb_base, &L, -A, 2 * A, A);
+    clock_t sieve_clock = clock() - start, factor_clock = 0;
+    for (int blk = 0; blk < blocks; blk++)
+    {
+        start = clock();
+        int hits = sieve_block(primes, f, &L, -A, 2 * A, A, blk);
+        clock_t mid = clock();
+        sieve_clock += mid - start;
+        run->survivors += hits;
+        for (int h = 0; h < hits; h++)
+        {
+            int64_t a = sieve_hits_a[h], b = sieve_hits_b[h];
+            if (gcd_u64((a < 0) ? -(uint64_t)a : (uint64_t)a, (uint64_t)b) == 1 &&
+                factor_pair(a, b, f, primes, fb_base, h, &rel))
+            {
+                run->relations++;
+                factors_used = rel.first;   // counted, not kept
+            }
+        }
+        factor_clock += clock() - mid;
+    }
+    run->sieve_seconds = (double)sieve_clock / CLOCKS_PER_SEC;
+    run->factor_seconds = (double)factor_clock / CLOCKS_PER_SEC;
+    job_end();
+}
+
+/*
+ * Survivors factored by trial division over the whole factor base versus
+ * by their resieved divisors: the same relations, with the resieve's cost
+ * moved into the sieve column.
+ */
+void run_bench_resieve()
+{
+    printf("Resieving: time per sieve survivor, trial division vs resieved divisors\n");
+    printf("=======================================================================\n\n");
+    
+    u128 n = parse_u128("20199795332516287488257");   // 614^8 + 1
+    SnfsPoly f = poly_xd_plus_1(n, 4);
+    int area = 1 << 20;
+    int limits[] = {2000, 20000, 100000};
+    
+    printf("n = 614^8 + 1, f = x^4 + 1, area %d, cofactors < 2^%d, primes < %d still trial-divided\n\n", area,
+           cofactor_bits, RESIEVE_MIN);
+    printf("%7s %9s %9s | %-21s | %-23s | %7s\n", "B", "survivors", "relations", "sieve s: trial/res.",
+           "us/survivor: trial/res.", "speedup");
+    for (int c = 0; c < 3; c++)
+    {
+        ResieveRun trial, res;
+        resieve = 0;
+        count_resieve_run(&f, limits[c], area, &trial);
+        resieve = 1;
+        count_resieve_run(&f, limits[c], area, &res);
+        double per_trial = 1e6 * (trial.sieve_seconds + trial.factor_seconds) / (trial.survivors ? trial.survivors : 1);
+        double per_res = 1e6 * (res.sieve_seconds + res.factor_seconds) / (res.survivors ? res.survivors : 1);
+        printf("%7d %9" PRIu64 " %9" PRIu64 " | %10.3f %10.3f | %11.3f %11.3f | %6.1fx%s\n", limits[c], res.survivors,
+               res.relations, trial.sieve_seconds, res.sieve_seconds, 1e6 * trial.factor_seconds / (trial.survivors ? trial.survivors : 1),
+               1e6 * res.factor_seconds / (res.survivors ? res.survivors : 1), per_trial / ((per_res > 0) ? per_res : 1e-9),
+               (trial.relations == res.relations) ? "" : "  (relations differ!)");
+    }
+    printf("\nus/survivor: factoring time alone. speedup: sieve plus factoring per survivor.\n");
+}
+
+// ============ Benchmark: relation filtering ============
+
+/*
+ * Sieve the (a, b) region until the matrix is full, then run the matrix
+ * stage twice on the same units: every unit eliminated as it is, and the
+ * filtered matrix.
+ */
+void run_bench_filter()
+{
+    printf("Relation filtering: matrix size and elimination time, unfiltered vs filtered\n");
+    printf("============================================================================\n\n");
+    
+    u128 n = parse_u128("20199795332516287488257");   // 614^8 + 1
+    SnfsPoly f = poly_xd_plus_1(n, 4);
+    int limits[] = {20000, 50000, 100000};
+    
+    printf("n = 614^8 + 1, f = x^4 + 1, sieved until units = rational primes + ideals + 18;\n");
+    printf("filtering keeps %d rows over the columns\n\n", MATRIX_EXCESS);
+    printf("%7s %-10s %6s %6s %8s %10s %9s %10s %5s\n", "B", "matrix", "rows", "cols", "nonzeros", "singletons",
+           "cliques", "LA", "deps");
+    lanczos_rows = UINT32_MAX;   // the same solver both ways, on the rows as filtered
+    merge_matrix = 0;
+    for (int c = 0; c < 3; c++)
+    {
+        RegionStats rs;
+        memset(&rs, 0, sizeof(rs));
+        int fb_base = job_begin(limits[c], &f);
+        if (fb_base == 0)
+            continue;
+        sieve_region(&f, fb_base, 1 << 26, &rs);
+        for (int mode = 0; mode <= 1; mode++)
+        {
+            filter_matrix = mode;
+            solve_matrix(n, job_primes, fb_base);
+            const MatrixStats *ms = &matrix_stats;
+            const MatrixShape *shape = mode ? &ms->after : &ms->before;
+            printf("%7d %-10s %6u %6u %8" PRIu64 " %10u %9u %9.3fs %5u\n", limits[c], mode ? "filtered" : "unfiltered",
+                   shape->rows, shape->cols, shape->weight, ms->singletons, ms->cliques,
+                   ms->filter_seconds + ms->la_seconds, ms->dependencies);
+        }
+        job_end();
+    }
+    filter_matrix = 1;
+    merge_matrix = 1;
+    lanczos_rows = LANCZOS_MIN_ROWS;
+    printf("\nLA: filtering plus Gaussian elimination; deps: null vectors found. Each\n");
+    printf("clique dropped costs at most one of the excess rows, and a singleton none.\n");
+}
+
+// ============ Benchmark: block Lanczos ============
+
+// Columns of M^T x that are not zero, over the 64 vectors of x together
+static uint32_t lanczos_check(const SparseMatrix *M, const uint64_t *x)
+{
+    uint32_t bad = 0;
+    for (uint32_t c = 0; c < M->cols; c++)
+    {
+        uint64_t acc = 0;
+        for (uint32_t e = M->col_first[c]; e < M->col_first[c + 1]; e++)
+            acc ^= x[M->col_rows[e]];
+        bad += (acc != 0);
+    }
+    return bad;
+}
+
+/*
+ * A random matrix shaped like a filtered one: rows = cols + 64, about
+ * weight entries per row, column c drawn about 1/(c+1) often (small
+ * primes are common) but none left with fewer than two rows. Returns 0
+ * when out of memory.
+ */
+static int lanczos_random_matrix(SparseMatrix *M, uint32_t cols, int weight, uint64_t seed)
+{
+    uint32_t rows = cols + MATRIX_EXCESS;
+    uint32_t *row_first = malloc((rows + 1) * sizeof(uint32_t));
+    uint32_t *row_cols = malloc(((size_t)rows * weight + 1) * sizeof(uint32_t));
+    M->rows = rows;
+    M->cols = cols;
+    M->row_first = row_first;
+    M->row_cols = row_cols;
+    M->col_first = M->col_rows = NULL;
+    if (!row_first || !row_cols)
+        return 0;
+    row_first[0] = 0;
+    for (uint32_t r = 0; r < rows; r++)
+    {
+        // Two fixed entries give every column weight 2 or more, as after filtering
+        uint32_t *row = row_cols + row_first[r], used = 0;
+        row[used++] = r % cols;
+        row[used++] = (uint32_t)(((uint64_t)r * 7919 + 1) % cols);
+        for (int i = 2; i < weight; i++)
+        {
+            seed ^= seed << 13;
+            seed ^= seed >> 7;
+            seed ^= seed << 17;
+            // exp(u log cols) - 1 for u uniform in [0, 1)
+            double u = (double)(seed >> 11) / 9007199254740992.0;
+            row[used++] = (uint32_t)(exp(u * log((double)cols)) - 1);
+        }
+        qsort(row, used, sizeof(uint32_t), compare_u32);
+        uint32_t kept = 0;
+        for (uint32_t i = 0, j; i < used; i = j)
+        {
+            for (j = i; j < used && row[j] == row[i]; j++)
+                ;
+            if ((j - i) % 2)
+                row[kept++] = row[i];
+        }
+        row_first[r + 1] = row_first[r] + kept;
+    }
+    return sparse_transpose(M);
+}
+
+/*
+ * The SNFS matrices of --bench-filter, filtered but not merged, through
+ * both solvers; then random matrices up to 10^5 columns through block
+ * Lanczos alone at 1, 2 and 4 threads, with every dependency checked
+ * against M^T.
+ */
+void run_bench_lanczos()
+{
+    printf("Block Lanczos vs Gaussian elimination\n");
+    printf("=====================================\n\n");
+    
+    u128 n = parse_u128("20199795332516287488257");   // 614^8 + 1
+    SnfsPoly f = poly_xd_plus_1(n, 4);
+    int limits[] = {20000, 50000, 100000};
+    
+    printf("SNFS matrices (614^8 + 1, f = x^4 + 1), filtered, not merged:\n");
+    printf("%7s %6s %6s %8s | %-9s %9s %5s | %-9s %9s %5s %5s\n", "B", "rows", "cols", "nonzeros", "solver", "time",
+           "deps", "solver", "time", "iters", "deps");
+    for (int c = 0; c < 3; c++)
+    {
+        RegionStats rs;
+        memset(&rs, 0, sizeof(rs));
+        int fb_base = job_begin(limits[c], &f);
+        if (fb_base == 0)
+            continue;
+        sieve_region(&f, fb_base, 1 << 26, &rs);
+        MatrixStats runs[2];
+        merge_matrix = 0;
+        for (int mode = 0; mode <= 1; mode++)
+        {
+            lanczos_rows = mode ? 0 : UINT32_MAX;
+            solve_matrix(n, job_primes, fb_base);
+            runs[mode] = matrix_stats;
+        }
+        printf("%7d %6u %6u %8" PRIu64 " | %-9s %8.3fs %5u | %-9s %8.3fs %5u %5u\n", limits[c], runs[0].after.rows,
+               runs[0].after.cols, runs[0].after.weight, runs[0].solver, runs[0].la_seconds, runs[0].dependencies,
+               runs[1].solver, runs[1].la_seconds, runs[1].iterations, runs[1].dependencies);
+        job_end();
+    }
+    merge_matrix = 1;
+    lanczos_rows = LANCZOS_MIN_ROWS;
+    
+    uint32_t sizes[] = {10000, 30000, 100000};
+    int threads[] = {1, 2, 4};
+    int cores = default_threads();
+    printf("\nRandom matrices, rows = cols + %d, 20 entries per row drawn ~ 1/(column + 1); %d core%s online:\n",
+           MATRIX_EXCESS, cores, (cores == 1) ? "" : "s");
+    printf("%7s %7s %9s %7s | %7s %9s %5s %9s\n", "rows", "cols", "nonzeros", "threads", "iters", "wall", "deps",
+           "M^T x");
+    for (int c = 0; c < 3; c++)
+    {
+        SparseMatrix M;
+        uint64_t *x = malloc((sizes[c] + MATRIX_EXCESS) * sizeof(uint64_t));
+        if (!x || !lanczos_random_matrix(&M, sizes[c], 20, 0x2545F4914F6CDD1DULL + c))
+        {
+            fprintf(stderr, "Error: out of memory for the matrix\n");
+            free(x);
+            sparse_free(&M);
+            continue;
+        }
+        for (int t = 0; t < 3; t++)
+        {
+            uint32_t iterations = 0;
+            double start = wall_seconds();
+            int deps = block_lanczos(&M, threads[t], x, &iterations);
+            double wall = wall_seconds() - start;
+            uint32_t bad = (deps > 0) ? lanczos_check(&M, x) : 0;
+            printf("%7u %7u %9u %7d | %7u %8.3fs %5d %9s\n", M.rows, M.cols, M.row_first[M.rows], threads[t], iterations,
+                   wall, deps, (deps <= 0) ? "-" : bad ? "FAILED" : "0");
+        }
+        free(x);
+        sparse_free(&M);
+    }
+    printf("\nLA: wall clock for the solve alone. iters: Lanczos steps, each one product\n");
+    printf("with M M^T. M^T x: whether every dependency returned is a null vector.\n");
+}
+
+// ============ Benchmark: structured Gaussian elimination ============
+
+/*
+ * Block Lanczos on the rows of M as they are, or after merging them. The
+ * dependencies found are mapped back to M's rows and checked there.
+ */
+static void merge_bench_random(const SparseMatrix *M, int merge)
+{
+    MergeRow *rows = calloc(M->rows + 1, sizeof(MergeRow));
+    uint64_t *found = malloc((M->rows + 1) * sizeof(uint64_t)), *x = calloc(M->rows + 1, sizeof(uint64_t));
+    SparseMatrix R;
+    uint32_t nrows = 0, iterations = 0;
+    memset(&R, 0, sizeof(R));
+    if (!rows || !found || !x)
+        goto out;
+    double start = wall_seconds();
+    for (; nrows < M->rows; nrows++)
+    {
+        MergeRow *row = &rows[nrows];
+        row->ncols = M->row_first[nrows + 1] - M->row_first[nrows];
+        row->nunits = 1;
+        row->cols = malloc((row->ncols + 1) * sizeof(uint32_t));
+        row->units = malloc(sizeof(uint32_t));
+        if (!row->cols || !row->units)
+            goto out;
+        memcpy(row->cols, M->row_cols + M->row_first[nrows], row->ncols * sizeof(uint32_t));
+        row->units[0] = nrows;
+    }
+    if (merge)
+        merge_rows(rows, nrows, M->cols);
+    if (!merge_to_sparse(rows, &nrows, M->cols, &R) || !sparse_transpose(&R))
+        goto out;
+    double mid = wall_seconds();
+    int deps = block_lanczos(&R, 1, found, &iterations);
+    double end = wall_seconds();
+    
+    for (uint32_t r = 0; r < R.rows; r++)
+        for (uint32_t u = 0; u < rows[r].nunits; u++)
+            x[rows[r].units[u]] ^= found[r];
+    uint32_t bad = (deps > 0) ? lanczos_check(M, x) : 0;
+    printf("%7u %-6s %7u %7u %9u %8.3fs %8.3fs %6u %5d %7s\n", M->rows, merge ? "merged" : "as is", R.rows, R.cols,
+           R.row_first[R.rows], mid - start, end - mid, iterations, deps, (deps <= 0) ? "-" : bad ? "FAILED" : "0");
+out:
+    for (uint32_t k = 0; rows && k < nrows; k++)
+        merge_drop(&rows[k]);
+    free(rows);
+    free(found);
+    free(x);
+    sparse_free(&R);
+}
+
+/*
+ * The matrix stage on the filtered 614^8 + 1 matrices with and without
+ * merging; then block Lanczos on random matrices, as --bench-lanczos
+ * makes them, with and without merging first.
+ */
+void run_bench_merge()
+{
+    printf("Structured Gaussian elimination: matrix size and LA time, filtered vs merged\n");
+    printf("============================================================================\n\n");
+    
+    u128 n = parse_u128("20199795332516287488257");   // 614^8 + 1
+    SnfsPoly f = poly_xd_plus_1(n, 4);
+    int limits[] = {20000, 50000, 100000};
+    
+    printf("SNFS matrices (614^8 + 1, f = x^4 + 1); columns of weight <= %d merged, rows kept <= %d entries:\n",
+           MERGE_MAX_WEIGHT, MERGE_MAX_ROW);
+    printf("%7s %-8s %6s %6s %8s %8s | %-9s %8s %8s %5s\n", "B", "matrix", "rows", "cols", "nonzeros", "merged", "solver",
+           "solve", "LA", "deps");
+    for (int c = 0; c < 3; c++)
+    {
+        RegionStats rs;
+        memset(&rs, 0, sizeof(rs));
+        int fb_base = job_begin(limits[c], &f);
+        if (fb_base == 0)
+            continue;
+        sieve_region(&f, fb_base, 1 << 26, &rs);
+        for (int mode = 0; mode <= 1; mode++)
+        {
+            merge_matrix = mode;
+            solve_matrix(n, job_primes, fb_base);
+            const MatrixStats *ms = &matrix_stats;
+            printf("%7d %-8s %6u %6u %8" PRIu64 " %8u | %-9s %7.3fs %7.3fs %5u\n", limits[c], mode ? "merged" : "filtered",
+                   ms->merged.rows, ms->merged.cols, ms->merged.weight, ms->merged_cols, ms->solver, ms->la_seconds,
+                   ms->filter_seconds + ms->merge_seconds + ms->la_seconds, ms->dependencies);
+        }
+        job_end();
+    }
+    merge_matrix = 1;
+    
+    uint32_t sizes[] = {10000, 30000, 100000};
+    printf("\nRandom matrices, rows = cols + %d, 20 entries per row (see --bench-lanczos), one thread:\n", MATRIX_EXCESS);
+    printf("%7s %-6s %7s %7s %9s %9s %9s %6s %5s %7s\n", "rows", "matrix", "rows", "cols", "nonzeros", "merge",
+           "Lanczos", "iters", "deps", "M^T x");
+    for (int c = 0; c < 3; c++)
+    {
+        SparseMatrix M;
+        if (!lanczos_random_matrix(&M, sizes[c], 20, 0x2545F4914F6CDD1DULL + c))
+        {
+            fprintf(stderr, "Error: out of memory for the matrix\n");
+            sparse_free(&M);
+            continue;
+        }
+        merge_bench_random(&M, 0);
+        merge_bench_random(&M, 1);
+        sparse_free(&M);
+    }
+    printf("\nLA: filtering, merging and the solve. merge: building the rows and merging\n");
+    printf("them. M^T x: dependencies mapped back to the original rows, all null vectors.\n");
+}
+
+// ============ Benchmark: M4RI vs insert_row ============
+
+/*
+ * Columns of M^T x left nonzero over all count dependencies (stride
+ * words each); their average number of rows goes to *mean_rows.
+ */
+static uint32_t m4ri_check(const SparseMatrix *M, const uint64_t *deps, int count, uint32_t stride, double *mean_rows)
+{
+    uint64_t *x = malloc((M->rows + 1) * sizeof(uint64_t));
+    uint32_t bad = 0;
+    uint64_t total = 0;
+    if (!x)
+        return UINT32_MAX;
+    for (int d0 = 0; d0 < count; d0 += 64)
+    {
+        memset(x, 0, M->rows * sizeof(uint64_t));
+        for (int d = d0; d < count && d < d0 + 64; d++)
+        {
+            const uint64_t *combo = deps + (size_t)d * stride;
+            total += popcount_words(combo, stride);
+            for (uint32_t r = 0; r < M->rows; r++)
+                if (combo[r / 64] >> (r % 64) & 1)
+                    x[r] |= (uint64_t)1 << (d - d0);
+        }
+        bad += lanczos_check(M, x);
+    }
+    free(x);
+    *mean_rows = count ? (double)total / count : 0;
+    return bad;
+}
+
+/*
+ * Random matrices as --bench-lanczos makes them, 6000 and 12000 columns,
+ * through the insert_row loop and through dense_nullspace with each set
+ * of kernels this CPU runs. Every dependency is checked against M^T.
+ */
+void run_bench_m4ri()
+{
+    printf("M4RI dense elimination vs the insert_row loop\n");
+    printf("=============================================\n\n");
+    
+    // A job of 10^5 primes gives rows wide enough for 12000 columns
+    u128 n = parse_u128("20199795332516287488257");   // 614^8 + 1
+    SnfsPoly f = poly_xd_plus_1(n, 4);
+    uint32_t sizes[] = {6000, 12000};
+    int best = simd_detect();
+    printf("Random matrices, rows = cols + %d, 20 entries per row; best kernels here: %s\n", MATRIX_EXCESS,
+           simd_names[best]);
+    printf("%6s %6s %9s | %-10s %-8s %9s %5s %9s %7s\n", "rows", "cols", "nonzeros", "solver", "kernels", "time", "deps",
+           "rows/dep", "M^T x");
+    for (int c = 0; c < 2; c++)
+    {
+        SparseMatrix M;
+        if (job_begin(100000, &f) == 0 || !lanczos_random_matrix(&M, sizes[c], 20, 0x2545F4914F6CDD1DULL + c))
+        {
+            fprintf(stderr, "Error: out of memory for the matrix\n");
+            sparse_free(&M);
+            job_end();
+            continue;
+        }
+        uint64_t *deps = NULL;
+        double mean = 0;
+        
+        simd_select(best);
+        matrix_stats.dependencies = 0;
+        double start = wall_seconds();
+        solve_gaussian(&M, &deps);
+        double wall = wall_seconds() - start;
+        int count = (int)matrix_stats.dependencies;
+        uint32_t bad = m4ri_check(&M, deps, count, (uint32_t)combo_words, &mean);
+        printf("%6u %6u %9u | %-10s %-8s %8.3fs %5d %9.1f %7s\n", M.rows, M.cols, M.row_first[M.rows], "insert_row", "-",
+               wall, count, mean, (count <= 0) ? "-" : bad ? "FAILED" : "0");
+        free(deps);
+        
+        for (int level = SIMD_SCALAR; level <= best; level++)
+        {
+            simd_select(level);
+            start = wall_seconds();
+            count = dense_nullspace(&M, (uint32_t)combo_words, &deps);
+            wall = wall_seconds() - start;
+            bad = (count > 0) ? m4ri_check(&M, deps, count, (uint32_t)combo_words, &mean) : 0;
+            printf("%6u %6u %9u | %-10s %-8s %8.3fs %5d %9.1f %7s\n", M.rows, M.cols, M.row_first[M.rows], "M4RI",
+                   simd_names[level], wall, count, (count > 0) ? mean : 0.0, (count <= 0) ? "-" : bad ? "FAILED" : "0");
+            free(deps);
+        }
+        simd_select(best);
+        sparse_free(&M);
+        job_end();
+    }
+    printf("\ntime: wall clock, one thread. deps: null vectors returned. rows/dep: rows\n");
+    printf("summed per dependency. M^T x: whether every dependency is a null vector.\n");
+}
+
+// ============ Benchmark: sieving threads ============
+
+/*
+ * The sieve of 614^8 + 1 (f = x^4 + 1) until the matrix is full: the
+ * (a, b) region at B = 50000, then special q in [50000, 10^5) at B = 10^5.
+ * First the serial sieve, then the threaded one at 1 to 64 threads. Rates
+ * are relations kept per second of wall clock, counting the work the stop
+ * throws away; speedups are against one thread.
+ */
+void run_bench_threads()
+{
+    printf("Sieving threads: relations/s from 1 to 64 threads\n");
+    printf("=================================================\n\n");
+    
+    u128 n = parse_u128("20199795332516287488257");   // 614^8 + 1
+    SnfsPoly f = poly_xd_plus_1(n, 4);
+    int threads[] = {0, 1, 2, 4, 8, 16, 32, 64};
+    int cores = default_threads();
+    printf("614^8 + 1, f = x^4 + 1; %d core%s online\n", cores, (cores == 1) ? "" : "s");
+    printf("%7s | %-46s | %s\n", "", "(a, b) region, B = 50000", "special q in [50000, 10^5), B = 10^5");
+    printf("%7s | %9s %8s %8s %9s %7s | %9s %8s %8s %9s %7s\n", "threads", "relations", "wall", "CPU", "rel/s", "speedup",
+           "relations", "wall", "CPU", "rel/s", "speedup");
+    double base[2] = {0, 0};
+    for (int t = 0; t < 8; t++)
+    {
+        double rate[2] = {0, 0}, wall[2] = {0, 0}, cpu[2] = {0, 0};
+        uint64_t rels[2] = {0, 0};
+        sieve_threads = threads[t];
+        for (int mode = 0; mode <= 1; mode++)
+        {
+            int fb_base = job_begin(mode ? 100000 : 50000, &f);
+            if (fb_base == 0)
+                continue;
+            clock_t c0 = clock();
+            double w0 = wall_seconds();
+            if (mode)
+            {
+                SpecialQStats st;
+                memset(&st, 0, sizeof(st));
+                sieve_special_q(&f, fb_base, 1 << 18, 50000, 100000, NULL, &st);
+                rels[1] = st.relations;
+            }
+            else
+            {
+                RegionStats rs;
+                memset(&rs, 0, sizeof(rs));
+                sieve_region(&f, fb_base, 1 << 26, &rs);
+                rels[0] = rs.relations;
+            }
+            wall[mode] = wall_seconds() - w0;
+            cpu[mode] = (double)(clock() - c0) / CLOCKS_PER_SEC;
+            rate[mode] = rels[mode] / ((wall[mode] > 0) ? wall[mode] : 1e-9);
+            if (t == 1)
+                base[mode] = rate[mode];
+            job_end();
+        }
+        char label[16], speedup[2][16];
+        snprintf(label, sizeof(label), "%d", threads[t]);
+        for (int mode = 0; mode <= 1; mode++)
+            snprintf(speedup[mode], sizeof(speedup[mode]), "%.2fx", (base[mode] > 0) ? rate[mode] / base[mode] : 0.0);
+        printf("%7s | %9" PRIu64 " %7.3fs %7.3fs %9.0f %7s | %9" PRIu64 " %7.3fs %7.3fs %9.0f %7s\n",
+               t ? label : "serial", rels[0], wall[0], cpu[0], rate[0], t ? speedup[0] : "-", rels[1], wall[1], cpu[1],
+               rate[1], t ? speedup[1] : "-");
+    }
+    sieve_threads = 0;
+    printf("\nrel/s: relations kept per second of wall clock. CPU: all threads. What the\n");
+    printf("threads have in hand when the matrix fills is thrown away, so CPU per\n");
+    printf("relation grows with threads even when they have cores of their own.\n");
+}
+
+void run_demo()
+{
+    const char *demo_n_str = "815730722"; // 13^8 + 1 (small, finishes fast)
+    u128 n = parse_u128(demo_n_str);
+    int fb = 200;
+    int K = 5000; // sieve area in (a, b) positions
+    
+    printf("SNFS Demo (toy) on n = ");
+    print_u128(n);
+    printf(" (B=%d, K=%d)\n\n", fb, K);
+    PolyCandidate chosen;
+    if (!select_polynomial(n, 0, fb, K, &chosen))
+        chosen.f = poly_xd_plus_1(n, 8);
+    printf("\n");
+    
+    clock_t start = clock();
+    RegionStats rs;
+    u128 p = snfs_factor(n, &chosen.f, fb, K, &rs);
+    clock_t mid = clock();
+    double elapsed = (double)(mid - start) / CLOCKS_PER_SEC;
+    
+    if (p == 0 || p == n)
+    {
+        printf("SNFS toy failed, trying Pollard rho fallback...\n");
+        p = pollard_rho_u128(n);
+    }
+    clock_t end = clock();
+    double elapsed_total = (double)(end - start) / CLOCKS_PER_SEC;
+    
+    if (p == 0 || p == n)
+    {
+        printf("Failed to factor.\n");
+        return;
+    }
+    u128 q = n / p;
+    
+    printf("Factors:\n  p = ");
+    print_u128(p);
+    printf("\n  q = ");
+    print_u128(q);
+    printf("\nSNFS time: %.4fs, total with fallback: %.4fs\n", elapsed, elapsed_total);
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2)
+    {
+        printf("Usage: %s <n> [e] [degree] [B] [K] [--checkpoint FILE] [--resume FILE]\n", argv[0]);
+        printf("          [--special-q Q0 Q1] [--relations FILE]   (lattice sieve over q in [Q0, Q1), K per q)\n");
+        printf("          [--lp-bound L] [--cofactor-bits M]       (large primes <= L, cofactors < 2^M per side)\n");
+        printf("          [--threads T]                            (threads for sieving and block Lanczos, default: all cores)\n");
+        printf("       %s --demo\n", argv[0]);
+        printf("       %s --bench-mulmod    (double-and-add vs Montgomery/Barrett)\n", argv[0]);
+        printf("       %s --bench-hints     (rho / p-1 / trial division with and without the form's hint)\n", argv[0]);
+        printf("       %s --bench-sieve     (relations/s vs B: line b = 1 vs (a, b) region)\n", argv[0]);
+        printf("       %s --bench-lattice   (relations/s/core: (a, b) region vs special-q lattices)\n", argv[0]);
+        printf("       %s --bench-bucket    (plain vs bucket sieve up to B = 10^6, cache miss rates)\n", argv[0]);
+        printf("       %s --bench-poly      (polynomial selection: predicted vs measured relations)\n", argv[0]);
+        printf("       %s --bench-lp        (no / single / double large primes: time to a solvable matrix)\n", argv[0]);
+        printf("       %s --bench-cofactor  (splitting composite cofactors: extra relations, cofactorizations/s)\n", argv[0]);
+        printf("       %s --bench-resieve   (time per survivor: trial division vs resieved divisors)\n", argv[0]);
+        printf("       %s --bench-filter    (matrix size and elimination time with and without filtering)\n", argv[0]);
+        printf("       %s --bench-lanczos   (block Lanczos vs Gaussian elimination, sparse matrices up to 10^5)\n", argv[0]);
+        printf("       %s --bench-merge     (matrix size and LA time with and without structured elimination)\n", argv[0]);
+        printf("       %s --bench-m4ri      (M4RI with scalar/AVX2/AVX-512 kernels vs insert_row, 6000 and 12000 columns)\n", argv[0]);
+        printf("       %s --bench-threads   (relations/s of the region and special-q sieves at 1 to 64 threads)\n", argv[0]);
         return 1;
     }
     
@@ -507,16 +7070,169 @@ int main(int argc, char *argv[])
         run_demo();
         return 0;
     }
+    if (strcmp(argv[1], "--bench-mulmod") == 0)
+    {
+        run_bench_mulmod();
+        return 0;
+    }
+    if (strcmp(argv[1], "--bench-hints") == 0)
+    {
+        run_bench_hints();
+        return 0;
+    }
+    if (strcmp(argv[1], "--bench-sieve") == 0)
+    {
+        run_bench_sieve();
+        return 0;
+    }
+    if (strcmp(argv[1], "--bench-lattice") == 0)
+    {
+        run_bench_lattice();
+        return 0;
+    }
+    if (strcmp(argv[1], "--bench-bucket") == 0)
+    {
+        run_bench_bucket();
+        return 0;
+    }
+    if (strcmp(argv[1], "--bench-poly") == 0)
+    {
+        run_bench_poly();
+        return 0;
+    }
+    if (strcmp(argv[1], "--bench-lp") == 0)
+    {
+        run_bench_lp();
+        return 0;
+    }
+    if (strcmp(argv[1], "--bench-cofactor") == 0)
+    {
+        run_bench_cofactor();
+        return 0;
+    }
+    if (strcmp(argv[1], "--bench-resieve") == 0)
+    {
+        run_bench_resieve();
+        return 0;
+    }
+    if (strcmp(argv[1], "--bench-filter") == 0)
+    {
+        run_bench_filter();
+        return 0;
+    }
+    if (strcmp(argv[1], "--bench-lanczos") == 0)
+    {
+        run_bench_lanczos();
+        return 0;
+    }
+    if (strcmp(argv[1], "--bench-merge") == 0)
+    {
+        run_bench_merge();
+        return 0;
+    }
+    if (strcmp(argv[1], "--bench-m4ri") == 0)
+    {
+        run_bench_m4ri();
+        return 0;
+    }
+    if (strcmp(argv[1], "--bench-threads") == 0)
+    {
+        run_bench_threads();
+        return 0;
+    }
+    
+    const char *checkpoint_path = NULL;
+    const char *resume_path = NULL;
+    const char *relations_path = NULL;
+    uint32_t q0 = 0, q1 = 0;
+    const char *lp_arg = NULL;
+    const char *pos[5] = {NULL, NULL, NULL, NULL, NULL};
+    int npos = 0;
+    la_threads = default_threads();
+    
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--checkpoint") == 0 && i + 1 < argc)
+            checkpoint_path = argv[++i];
+        else if (strcmp(argv[i], "--resume") == 0 && i + 1 < argc)
+            resume_path = argv[++i];
+        else if (strcmp(argv[i], "--relations") == 0 && i + 1 < argc)
+            relations_path = argv[++i];
+        else if (strcmp(argv[i], "--lp-bound") == 0 && i + 1 < argc)
+            lp_arg = argv[++i];
+        else if (strcmp(argv[i], "--cofactor-bits") == 0 && i + 1 < argc)
+            cofactor_bits = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+            la_threads = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--special-q") == 0 && i + 2 < argc)
+        {
+            q0 = (uint32_t)strtoul(argv[++i], NULL, 10);
+            q1 = (uint32_t)strtoul(argv[++i], NULL, 10);
+        }
+        else if (argv[i][0] != '-' && npos < 5)
+            pos[npos++] = argv[i];
+    }
+    if (npos == 0)
+    {
+        fprintf(stderr, "Error: missing <n>\n");
+        return 1;
+    }
     
-    u128 n = parse_u128(argv[1]);
-    u128 e = (argc >= 3) ? parse_u128(argv[2]) : 3;
-    int degree = (argc >= 4) ? atoi(argv[3]) : 8;
-    int fb = (argc >= 5) ? atoi(argv[4]) : 200;
-    int K = (argc >= 6) ? atoi(argv[5]) : 5000; // k bound
+    u128 n = parse_u128(pos[0]);
+    u128 e = pos[1] ? parse_u128(pos[1]) : 3;
+    int degree = pos[2] ? atoi(pos[2]) : 0;   // 0 (or "auto"): chosen by polynomial selection
+    int fb = pos[3] ? atoi(pos[3]) : 200;
+    int K = pos[4] ? atoi(pos[4]) : 5000; // sieve area
+    
+    RhoState128 rho;
+    int resumed = 0;
+    if (resume_path)
+    {
+        if (!load_rho_checkpoint(resume_path, &rho))
+        {
+            fprintf(stderr, "Error: %s is not a valid checkpoint\n", resume_path);
+            return 1;
+        }
+        if (rho.n != n)
+        {
+            fprintf(stderr, "Error: checkpoint %s was written for a different n\n", resume_path);
+            return 1;
+        }
+        resumed = 1;
+        // Keep writing to the file we resumed from unless told otherwise
+        if (!checkpoint_path)
+            checkpoint_path = resume_path;
+    }
     
-    if (degree < 3 || degree > 12)
+    if (degree != 0 && (degree < 3 || degree > MAX_DEGREE))
+    {
+        fprintf(stderr, "Degree must be 0 (automatic) or between 3 and 12 for this toy.\n");
+        return 1;
+    }
+    if (lp_arg)
+    {
+        unsigned long long L = strtoull(lp_arg, NULL, 10);
+        if (L < 2 || L > UINT32_MAX)
+        {
+            fprintf(stderr, "Error: --lp-bound must be between 2 and %u\n", UINT32_MAX);
+            return 1;
+        }
+        lp_bound = (uint32_t)L;
+    }
+    if (cofactor_bits < 1 || cofactor_bits > 62)
+    {
+        fprintf(stderr, "Error: --cofactor-bits must be between 1 and 62\n");
+        return 1;
+    }
+    if (la_threads < 1 || la_threads > MAX_THREADS)
+    {
+        fprintf(stderr, "Error: --threads must be between 1 and %d\n", MAX_THREADS);
+        return 1;
+    }
+    sieve_threads = la_threads;
+    if (q1 && (q0 >= q1 || q1 > (uint32_t)fb + 1))
     {
-        fprintf(stderr, "Degree must be between 3 and 12 for this toy.\n");
+        fprintf(stderr, "Error: special-q range [Q0, Q1) must be non-empty and lie within the factor base (Q1 <= B + 1)\n");
         return 1;
     }
     
@@ -525,17 +7241,76 @@ int main(int argc, char *argv[])
     print_u128(n);
     printf("\ne = ");
     print_u128(e);
-    printf("\ndegree = %d, B = %d, K = %d\n\n", degree, fb, K);
+    printf("\nB = %d, K = %d, large primes <= %u, cofactors < 2^%d\n", fb, K, lp_bound, cofactor_bits);
+    SpecialForm sf;
+    static const char *engine_names[] = {"double-and-add", "Montgomery", "Barrett", "2^k fold"};
+    int have_sf = detect_special_form(n, &sf);
+    if (have_sf)
+    {
+        printf("special form: n = ");
+        print_special_form(&sf);
+        printf(", ");
+    }
+    printf("mul_mod engine: %s\n\n", engine_names[mod_ctx(n)->kind]);
+    
+    PolyCandidate chosen;
+    if (!select_polynomial(n, degree, fb, K, &chosen))
+    {
+        chosen.f = poly_xd_plus_1(n, degree ? degree : 8);
+        poly_score(&chosen, fb, K);
+        printf("no a*b^k +- c form found: f = x^%d + 1 with m = floor((n - 1)^(1/%d)), a root mod n only if n = m^%d + 1\n",
+               chosen.f.degree, chosen.f.degree, chosen.f.degree);
+    }
+    char poly[64];
+    format_poly(poly, sizeof(poly), &chosen.f);
+    printf("f = %s, g = x - ", poly);
+    print_u128(chosen.f.m);
+    printf(", alpha %.2f, predicted %.1f relations over the region\n\n", chosen.alpha, chosen.predicted);
     
     clock_t start = clock();
-    u128 p = snfs_factor(n, degree, fb, K);
+    // The sieve stage is short and not checkpointed; a resume goes straight to rho
+    u128 p = 0;
+    if (!resumed && q1)
+    {
+        SpecialQStats st;
+        p = snfs_factor_lattice(n, &chosen.f, fb, K, q0, q1, relations_path, &st);
+        printf("special-q [%u, %u): %u q, %u lattices, %" PRIu64 " survivors, %" PRIu64 " relations (%" PRIu64
+               " duplicates), %.3fs wall, %.3fs CPU, %.0f rel/s/core\n", q0, q1, st.q_count, st.root_count,
+               st.survivors, st.relations, st.duplicates, st.seconds, st.cpu_seconds,
+               st.relations / ((st.cpu_seconds > 0) ? st.cpu_seconds : 1e-9));
+        print_matrix_stats();
+    }
+    else if (!resumed)
+    {
+        RegionStats rs;
+        double e;
+        p = snfs_factor(n, &chosen.f, fb, K, &rs);
+        double predicted = poly_yield(&chosen.f, chosen.alpha, fb, rs.A, rs.rows, &e);
+        printf("yield over lines b <= %" PRId64 " of %" PRId64 ": predicted %.1f relations, measured %" PRIu64 " (%.2fx)\n",
+               rs.rows, rs.A, predicted, rs.relations, (predicted > 0) ? rs.relations / predicted : 0.0);
+        printf("relations: %u full, %u with one large prime, %u with two; %u cycles, %u matrix rows of %d needed\n",
+               rs.full, rs.partial[0], rs.partial[1], rs.cycles, rs.full + rs.cycles, rel_capacity);
+        printf("sieved %.3fs wall, %.3fs CPU\n", rs.seconds, rs.cpu_seconds);
+        print_matrix_stats();
+    }
     clock_t mid = clock();
     double elapsed = (double)(mid - start) / CLOCKS_PER_SEC;
     
     if (p == 0 || p == n)
     {
-        printf("SNFS toy failed, trying Pollard rho fallback...\n");
-        p = pollard_rho_u128(n);
+        if (resumed)
+        {
+            printf("Resuming Pollard rho from %s (c = ", resume_path);
+            print_u128(rho.c);
+            printf(", step %" PRIu64 ")...\n", rho.iteration);
+        }
+        else
+        {
+            printf("SNFS toy failed, trying fallbacks...\n");
+            p = fallback_stages(n, have_sf ? &sf : NULL, &rho);
+        }
+        if (p == 0)
+            p = pollard_rho_u128_walk(&rho, checkpoint_path);
     }
     clock_t end = clock();
     double elapsed_total = (double)(end - start) / CLOCKS_PER_SEC;
@@ -545,6 +7320,8 @@ int main(int argc, char *argv[])
         printf("Failed to factor (try increasing B or K).\n");
         return 1;
     }
+    if (checkpoint_path)
+        remove(checkpoint_path);
     
     u128 q = n / p;
     
@@ -0,0 +1,370 @@
+/*
+ * Shanks' Square Forms Factorization (SQUFOF) Attack on RSA
+ * Usage: ./squfof <n> [e]
+ *        ./squfof --demo
+ *
+ * Word-size only: n up to 62 bits. Several multipliers k race in
+ * round-robin on k*n, which avoids the long cycles a single form can hit.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#define SQUFOF_MAX_BITS 62
+#define RACE_SLICE 256   // forward steps per multiplier before switching
+
+uint64_t gcd(uint64_t a, uint64_t b)
+{
+    while (b != 0)
+    {
+        uint64_t temp = b;
+        b = a % b;
+        a = temp;
+    }
+    return a;
+}
+
+int64_t mod_inverse(int64_t e, int64_t phi)
+{
+    int64_t t = 0, newt = 1;
+    int64_t r = phi, newr = e;
+    
+    while (newr != 0)
+    {
+        int64_t quotient = r / newr;
+        int64_t temp_t = t;
+        t = newt;
+        newt = temp_t - quotient * newt;
+        int64_t temp_r = r;
+        r = newr;
+        newr = temp_r - quotient * newr;
+    }
+    
+    if (t < 0)
+        t += phi;
+    return t;
+}
+
+// floor(sqrt(x)) for 128-bit x
+static uint64_t isqrt_u128(__uint128_t x)
+{
+    uint64_t r = (uint64_t)sqrtl((long double)x);
+    while ((__uint128_t)r * r > x)
+        r--;
+    while ((__uint128_t)(r + 1) * (r + 1) <= x)
+        r++;
+    return r;
+}
+
+// Returns sqrt(x) if x is a perfect square, otherwise 0
+static uint64_t square_root_exact(uint64_t x)
+{
+    // Squares mod 64 can only end in these residues
+    if (!((0x0202021202030213ULL >> (x & 63)) & 1))
+        return 0;
+    uint64_t r = isqrt_u128(x);
+    return (r * r == x) ? r : 0;
+}
+
+// ============ SQUFOF ============
+
+// Gower & Wagstaff's square-free multipliers, products of 3, 5, 7, 11
+static const uint32_t multipliers[] = {
+    1, 3, 5, 7, 11, 3 * 5, 3 * 7, 3 * 11, 5 * 7, 5 * 11, 7 * 11,
+    3 * 5 * 7, 3 * 5 * 11, 3 * 7 * 11, 5 * 7 * 11, 3 * 5 * 7 * 11
+};
+#define NUM_MULTIPLIERS (int)(sizeof(multipliers) / sizeof(multipliers[0]))
+
+typedef struct {
+    __uint128_t N;       // k * n
+    int64_t P0;          // floor(sqrt(N))
+    int64_t P, Q, Qprev; // current form
+    uint64_t step;
+    uint64_t limit;
+    int active;
+} SquareForm;
+
+static void form_init(SquareForm *f, uint64_t n, uint32_t k)
+{
+    f->N = (__uint128_t)n * k;
+    f->P0 = (int64_t)isqrt_u128(f->N);
+    f->P = f->P0;
+    f->Qprev = 1;
+    f->Q = (int64_t)(f->N - (__uint128_t)f->P0 * f->P0);
+    f->step = 1;
+    // Expected cycle length is O(N^1/4); allow a generous multiple of it
+    f->limit = 4 * (uint64_t)(2.0 * sqrt(2.0 * sqrt((double)f->N)));
+    f->active = (f->Q != 0);
+}
+
+/*
+ * Reverse cycle from the square form found at Q = r^2. Returns a factor
+ * of n (possibly trivial).
+ */
+static uint64_t reverse_cycle(const SquareForm *f, int64_t r, uint64_t n)
+{
+    int64_t b = (f->P0 - f->P) / r;
+    int64_t P = b * r + f->P;
+    int64_t Qprev = r;
+    int64_t Q = (int64_t)((f->N - (__uint128_t)((__int128)P * P)) / (uint64_t)Qprev);
+    int64_t Pprev;
+    
+    do
+    {
+        b = (f->P0 + P) / Q;
+        Pprev = P;
+        P = b * Q - P;
+        int64_t Qnext = Qprev + b * (Pprev - P);
+        Qprev = Q;
+        Q = Qnext;
+    } while (P != Pprev);
+    
+    return gcd(n, (uint64_t)P);
+}
+
+/*
+ * Advance one form by up to `steps` forward iterations. Returns a proper
+ * factor of n when the square form leads to one, otherwise 0.
+ */
+static uint64_t form_advance(SquareForm *f, uint64_t n, int steps, uint64_t *iterations)
+{
+    for (int s = 0; s < steps && f->active; s++)
+    {
+        if (f->step >= f->limit)
+        {
+            f->active = 0;
+            break;
+        }
+        (*iterations)++;
+        int64_t b = (f->P0 + f->P) / f->Q;
+        int64_t Pnext = b * f->Q - f->P;
+        int64_t Qnext = f->Qprev + b * (f->P - Pnext);
+        f->Qprev = f->Q;
+        f->Q = Qnext;
+        f->P = Pnext;
+        f->step++;
+        
+        // Only forms at even positions are proper squares
+        if (f->step & 1)
+            continue;
+        int64_t r = (int64_t)square_root_exact((uint64_t)f->Q);
+        if (r == 0)
+            continue;
+        uint64_t d = reverse_cycle(f, r, n);
+        if (d > 1 && d < n)
+            return d;
+    }
+    return 0;
+}
+
+/*
+ * SQUFOF with a multiplier race
+ *
+ * Each multiplier k gives its own continued fraction expansion of sqrt(kn);
+ * we step them round-robin in slices of RACE_SLICE iterations and stop at
+ * the first proper factor. Needs n < 2^62, odd, and not a perfect square
+ * (those are handled up front).
+ */
+uint64_t squfof(uint64_t n, uint64_t *iterations)
+{
+    *iterations = 0;
+    
+    if (n % 2 == 0)
+    {
+        *iterations = 1;
+        return 2;
+    }
+    
+    uint64_t root = square_root_exact(n);
+    if (root)
+        return root;
+    
+    SquareForm forms[NUM_MULTIPLIERS];
+    int live = 0;
+    for (int i = 0; i < NUM_MULTIPLIERS; i++)
+    {
+        uint64_t g = gcd(n, multipliers[i]);
+        if (g > 1 && g < n)
+            return g;
+        form_init(&forms[i], n, multipliers[i]);
+        live += forms[i].active;
+    }
+    
+    while (live > 0)
+    {
+        live = 0;
+        for (int i = 0; i < NUM_MULTIPLIERS; i++)
+        {
+            if (!forms[i].active)
+                continue;
+            uint64_t d = form_advance(&forms[i], n, RACE_SLICE, iterations);
+            if (d)
+                return d;
+            live += forms[i].active;
+        }
+    }
+    return 0;
+}
+
+// ============ Pollard's Rho (benchmark reference) ============
+
+uint64_t f(uint64_t x, uint64_t n)
+{
+    return ((__uint128_t)x * x + 1) % n;
+}
+
+uint64_t pollards_rho(uint64_t n, uint64_t *iterations)
+{
+    *iterations = 0;
+    
+    if (n % 2 == 0)
+    {
+        *iterations = 1;
+        return 2;
+    }
+    
+    uint64_t x = 2, y = 2, d = 1;
+    
+    while (d == 1)
+    {
+        (*iterations)++;
+        x = f(x, n);
+        y = f(f(y, n), n);
+        
+        uint64_t diff = (x > y) ? x - y : y - x;
+        d = gcd(diff, n);
+        
+        if (*iterations > 10000000)
+            return 0;
+    }
+    
+    return (d != n) ? d : 0;
+}
+
+void run_demo()
+{
+    printf("SQUFOF vs Pollard's Rho (40-62 bit n)\n");
+    printf("=====================================\n\n");
+    printf("%-8s %12s %12s %12s %12s %9s\n", "n bits", "SQUFOF it", "SQUFOF", "Rho it", "Rho", "Speedup");
+    printf("-----------------------------------------------------------------------\n");
+    
+    // 40-62 bit entries of the pollards_rho demo table, a 62-bit one, then
+    // unbalanced n where p and q are far apart (no near-square shortcut)
+    uint64_t tests[] = {
+        4400626126189ULL,
+        70377803883943ULL,
+        1125938964277027ULL,
+        18014546685901351ULL,
+        288230981742142951ULL,
+        1152922614855900181ULL,
+        4611671922355366507ULL,
+        517573545913631ULL,         // 863851 * 599146781
+        39707224686495253ULL,       // 8513359 * 4664107867
+        737612186274915641ULL,      // 37521271 * 19658507471
+        1664756705172057713ULL,     // 230443373 * 7224146581
+    };
+    int num_tests = sizeof(tests) / sizeof(tests[0]);
+    int reps = 20;
+    
+    for (int i = 0; i < num_tests; i++)
+    {
+        uint64_t it_s = 0, it_r = 0, p_s = 0, p_r = 0;
+        
+        clock_t start = clock();
+        for (int r = 0; r < reps; r++)
+            p_s = squfof(tests[i], &it_s);
+        double t_s = (double)(clock() - start) / CLOCKS_PER_SEC / reps;
+        
+        start = clock();
+        for (int r = 0; r < reps; r++)
+            p_r = pollards_rho(tests[i], &it_r);
+        double t_r = (double)(clock() - start) / CLOCKS_PER_SEC / reps;
+        
+        printf("%-8d ", 64 - __builtin_clzll(tests[i]));
+        if (p_s)
+            printf("%12" PRIu64 " %10.6fs ", it_s, t_s);
+        else
+            printf("%12s %10.6fs ", "FAILED", t_s);
+        if (p_r)
+            printf("%12" PRIu64 " %10.6fs ", it_r, t_r);
+        else
+            printf("%12s %10.6fs ", "FAILED", t_r);
+        printf("%8.1fx\n", (t_s > 0) ? t_r / t_s : 0.0);
+    }
+    
+    printf("\n");
+    printf("SQUFOF complexity: O(n^1/4) with word-size arithmetic only.\n");
+    printf("Useful as a cofactorization backend for sieve survivors.\n");
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2)
+    {
+        printf("Usage: %s <n> [e]\n", argv[0]);
+        printf("       %s --demo    (benchmark against Pollard's rho)\n", argv[0]);
+        return 1;
+    }
+    
+    if (strcmp(argv[1], "--demo") == 0)
+    {
+        run_demo();
+        return 0;
+    }
+    
+    uint64_t n = strtoull(argv[1], NULL, 10);
+    uint64_t e = (argc >= 3) ? strtoull(argv[2], NULL, 10) : 3;
+    
+    if (n < 4)
+    {
+        fprintf(stderr, "Error: n must be >= 4\n");
+        return 1;
+    }
+    if (n >> SQUFOF_MAX_BITS)
+    {
+        fprintf(stderr, "Error: n must be < 2^%d\n", SQUFOF_MAX_BITS);
+        return 1;
+    }
+    
+    printf("SQUFOF Attack\n");
+    printf("n = %" PRIu64 ", e = %" PRIu64 "\n\n", n, e);
+    
+    clock_t start = clock();
+    uint64_t iterations;
+    uint64_t p = squfof(n, &iterations);
+    clock_t end = clock();
+    double time_spent = (double)(end - start) / CLOCKS_PER_SEC;
+    
+    if (p == 0)
+    {
+        printf("Failed to factor\n");
+        return 1;
+    }
+    
+    uint64_t q = n / p;
+    uint64_t phi = (p - 1) * (q - 1);
+    
+    printf("Factors: p = %" PRIu64 ", q = %" PRIu64 "\n", p, q);
+    printf("Iterations: %" PRIu64 ", Time: %.6fs\n\n", iterations, time_spent);
+    
+    if (gcd(e, phi) != 1)
+    {
+        printf("Error: e is not valid for these primes\n");
+        return 1;
+    }
+    
+    int64_t d = mod_inverse(e, phi);
+    
+    printf("phi(n) = %" PRIu64 "\n", phi);
+    printf("Private key d = %" PRId64 "\n\n", d);
+    
+    printf("Public:  (n=%" PRIu64 ", e=%" PRIu64 ")\n", n, e);
+    printf("Private: (n=%" PRIu64 ", d=%" PRId64 ")\n", n, d);
+    
+    return 0;
+}
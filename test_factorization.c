@@ -1,5 +1,6 @@
 /*
- * Test cases for Trial Division and Pollard's Rho factorization algorithms
+ * Test cases for Trial Division, Pollard's Rho, SQUFOF, Lehman, Hart and
+ * Fermat factorization algorithms
  * Usage: ./test_factorization
  */
 
@@ -8,6 +9,8 @@
 #include <inttypes.h>
 #include <math.h>
 
+#define RACE_SLICE 256
+
 // ============ Trial Division ============
 uint64_t trial_division(uint64_t n, uint64_t *iterations)
 {
@@ -74,6 +77,367 @@ uint64_t pollards_rho(uint64_t n, uint64_t *iterations)
     return (d != n) ? d : 0;
 }
 
+// ============ SQUFOF ============
+// floor(sqrt(x)) for 128-bit x
+static uint64_t isqrt_u128(__uint128_t x)
+{
+    uint64_t r = (uint64_t)sqrtl((long double)x);
+    while ((__uint128_t)r * r > x)
+        r--;
+    while ((__uint128_t)(r + 1) * (r + 1) <= x)
+        r++;
+    return r;
+}
+
+// Returns sqrt(x) if x is a perfect square, otherwise 0
+static uint64_t square_root_exact(uint64_t x)
+{
+    // Squares mod 64 can only end in these residues
+    if (!((0x0202021202030213ULL >> (x & 63)) & 1))
+        return 0;
+    uint64_t r = isqrt_u128(x);
+    return (r * r == x) ? r : 0;
+}
+
+// Gower & Wagstaff's square-free multipliers, products of 3, 5, 7, 11
+static const uint32_t multipliers[] = {
+    1, 3, 5, 7, 11, 3 * 5, 3 * 7, 3 * 11, 5 * 7, 5 * 11, 7 * 11,
+    3 * 5 * 7, 3 * 5 * 11, 3 * 7 * 11, 5 * 7 * 11, 3 * 5 * 7 * 11
+};
+#define NUM_MULTIPLIERS (int)(sizeof(multipliers) / sizeof(multipliers[0]))
+
+typedef struct {
+    __uint128_t N;       // k * n
+    int64_t P0;          // floor(sqrt(N))
+    int64_t P, Q, Qprev; // current form
+    uint64_t step;
+    uint64_t limit;
+    int active;
+} SquareForm;
+
+static void form_init(SquareForm *f, uint64_t n, uint32_t k)
+{
+    f->N = (__uint128_t)n * k;
+    f->P0 = (int64_t)isqrt_u128(f->N);
+    f->P = f->P0;
+    f->Qprev = 1;
+    f->Q = (int64_t)(f->N - (__uint128_t)f->P0 * f->P0);
+    f->step = 1;
+    // Expected cycle length is O(N^1/4); allow a generous multiple of it
+    f->limit = 4 * (uint64_t)(2.0 * sqrt(2.0 * sqrt((double)f->N)));
+    f->active = (f->Q != 0);
+}
+
+/*
+ * Reverse cycle from the square form found at Q = r^2. Returns a factor
+ * of n (possibly trivial).
+ */
+static uint64_t reverse_cycle(const SquareForm *f, int64_t r, uint64_t n)
+{
+    int64_t b = (f->P0 - f->P) / r;
+    int64_t P = b * r + f->P;
+    int64_t Qprev = r;
+    int64_t Q = (int64_t)((f->N - (__uint128_t)((__int128)P * P)) / (uint64_t)Qprev);
+    int64_t Pprev;
+    
+    do
+    {
+        b = (f->P0 + P) / Q;
+        Pprev = P;
+        P = b * Q - P;
+        int64_t Qnext = Qprev + b * (Pprev - P);
+        Qprev = Q;
+        Q = Qnext;
+    } while (P != Pprev);
+    
+    return gcd(n, (uint64_t)P);
+}
+
+/*
+ * Advance one form by up to `steps` forward iterations. Returns a proper
+ * factor of n when the square form leads to one, otherwise 0.
+ */
+static uint64_t form_advance(SquareForm *f, uint64_t n, int steps, uint64_t *iterations)
+{
+    for (int s = 0; s < steps && f->active; s++)
+    {
+        if (f->step >= f->limit)
+        {
+            f->active = 0;
+            break;
+        }
+        (*iterations)++;
+        int64_t b = (f->P0 + f->P) / f->Q;
+        int64_t Pnext = b * f->Q - f->P;
+        int64_t Qnext = f->Qprev + b * (f->P - Pnext);
+        f->Qprev = f->Q;
+        f->Q = Qnext;
+        f->P = Pnext;
+        f->step++;
+        
+        // Only forms at even positions are proper squares
+        if (f->step & 1)
+            continue;
+        int64_t r = (int64_t)square_root_exact((uint64_t)f->Q);
+        if (r == 0)
+            continue;
+        uint64_t d = reverse_cycle(f, r, n);
+        if (d > 1 && d < n)
+            return d;
+    }
+    return 0;
+}
+
+/*
+ * SQUFOF with a multiplier race
+ *
+ * Each multiplier k gives its own continued fraction expansion of sqrt(kn);
+ * we step them round-robin in slices of RACE_SLICE iterations and stop at
+ * the first proper factor. Needs n < 2^62, odd, and not a perfect square
+ * (those are handled up front).
+ */
+uint64_t squfof(uint64_t n, uint64_t *iterations)
+{
+    *iterations = 0;
+    
+    if (n % 2 == 0)
+    {
+        *iterations = 1;
+        return 2;
+    }
+    
+    uint64_t root = square_root_exact(n);
+    if (root)
+        return root;
+    
+    SquareForm forms[NUM_MULTIPLIERS];
+    int live = 0;
+    for (int i = 0; i < NUM_MULTIPLIERS; i++)
+    {
+        uint64_t g = gcd(n, multipliers[i]);
+        if (g > 1 && g < n)
+            return g;
+        form_init(&forms[i], n, multipliers[i]);
+        live += forms[i].active;
+    }
+    
+    while (live > 0)
+    {
+        live = 0;
+        for (int i = 0; i < NUM_MULTIPLIERS; i++)
+        {
+            if (!forms[i].active)
+                continue;
+            uint64_t d = form_advance(&forms[i], n, RACE_SLICE, iterations);
+            if (d)
+                return d;
+            live += forms[i].active;
+        }
+    }
+    return 0;
+}
+
+// ============ Square detection ============
+// Quadratic-residue tables: x can only be a square if it is a square mod each
+static uint8_t sq_mod64[64], sq_mod63[63], sq_mod65[65], sq_mod11[11];
+
+static void init_square_filters(void)
+{
+    static int done = 0;
+    if (done)
+        return;
+    for (int i = 0; i < 64; i++)
+        sq_mod64[(i * i) % 64] = 1;
+    for (int i = 0; i < 63; i++)
+        sq_mod63[(i * i) % 63] = 1;
+    for (int i = 0; i < 65; i++)
+        sq_mod65[(i * i) % 65] = 1;
+    for (int i = 0; i < 11; i++)
+        sq_mod11[(i * i) % 11] = 1;
+    done = 1;
+}
+
+// Returns 1 and sets *root if x is a perfect square. The four filters reject
+// all but ~0.4% of non-squares before the square root is taken.
+static int is_square(__uint128_t x, uint64_t *root)
+{
+    if (!sq_mod64[(unsigned)(x & 63)])
+        return 0;
+    uint64_t r = (uint64_t)(x % (63ULL * 65 * 11));
+    if (!sq_mod63[r % 63] || !sq_mod65[r % 65] || !sq_mod11[r % 11])
+        return 0;
+    uint64_t s = isqrt_u128(x);
+    if ((__uint128_t)s * s != x)
+        return 0;
+    *root = s;
+    return 1;
+}
+
+// Trial division by 2 and odd i with i^3 <= n; returns the factor or 0
+static uint64_t trial_cbrt(uint64_t n, uint64_t *iterations)
+{
+    if (n % 2 == 0)
+        return 2;
+    for (uint64_t i = 3; (__uint128_t)i * i * i <= n; i += 2)
+    {
+        (*iterations)++;
+        if (n % i == 0)
+            return i;
+    }
+    return 0;
+}
+
+// ============ Lehman ============
+/*
+ * Lehman's method, O(n^1/3)
+ *
+ * For each k <= n^1/3 scan a in [sqrt(4kn), sqrt(4kn) + n^1/6 / (4 sqrt(k))]
+ * for a^2 - 4kn = b^2; then gcd(a + b, n) is a proper factor. Trial division
+ * up to n^1/3 runs last, so close factors are found without paying for it.
+ * Deterministic for n < 2^62.
+ */
+uint64_t lehman(uint64_t n, uint64_t *iterations)
+{
+    *iterations = 0;
+    init_square_filters();
+    
+    if (n % 2 == 0)
+        return 2;
+    
+    uint64_t k_max = (uint64_t)cbrt((double)n) + 1;
+    double sixth = pow((double)n, 1.0 / 6.0);
+    
+    for (uint64_t k = 1; k <= k_max; k++)
+    {
+        __uint128_t four_kn = (__uint128_t)4 * k * n;
+        uint64_t a = isqrt_u128(four_kn);
+        if ((__uint128_t)a * a < four_kn)
+            a++;
+        uint64_t a_max = (uint64_t)(sqrtl((long double)four_kn) + sixth / (4.0 * sqrt((double)k))) + 1;
+        
+        for (; a <= a_max; a++)
+        {
+            (*iterations)++;
+            uint64_t b;
+            if (!is_square((__uint128_t)a * a - four_kn, &b))
+                continue;
+            uint64_t g = gcd(a + b, n);
+            if (g > 1 && g < n)
+                return g;
+        }
+    }
+    // Factors below n^1/3 are the only ones the square search can miss
+    return trial_cbrt(n, iterations);
+}
+
+// ============ Hart's one-line factoring ============
+/*
+ * Hart's OLF
+ *
+ * s = ceil(sqrt(n i)), m = s^2 mod n; if m = t^2 then gcd(s - t, n)
+ * splits n. Without Hart's optional 480 multiplier, i = 1 is already
+ * Fermat's first step, so near-square n fall out immediately.
+ * Heuristic O(n^1/3); trial division up to n^1/3 is the fallback.
+ */
+uint64_t hart(uint64_t n, uint64_t *iterations)
+{
+    *iterations = 0;
+    init_square_filters();
+    
+    if (n % 2 == 0)
+        return 2;
+    
+    uint64_t root;
+    if (is_square(n, &root))
+        return root;
+    
+    __uint128_t step = n;
+    uint64_t limit = 4 * ((uint64_t)cbrt((double)n) + 1);
+    __uint128_t ni = 0;
+    
+    for (uint64_t i = 1; i <= limit; i++)
+    {
+        (*iterations)++;
+        ni += step;
+        uint64_t s = isqrt_u128(ni);
+        if ((__uint128_t)s * s < ni)
+            s++;
+        uint64_t m = (uint64_t)(((__uint128_t)s * s) % n);
+        uint64_t t;
+        if (!is_square(m, &t))
+            continue;
+        uint64_t g = gcd((s % n + n - t % n) % n, n);
+        if (g > 1 && g < n)
+            return g;
+    }
+    return trial_cbrt(n, iterations);
+}
+
+// ============ Fermat ============
+// Square-residue bitmaps: bit r is set iff r is a square mod m
+#define SQ_MOD64 0x0202021202030213ULL
+#define SQ_MOD63 0x0402483012450293ULL
+#define SQ_MOD65_LO 0x218a019866014613ULL   // residues 0..63
+#define SQ_MOD65_HI 0x1ULL                  // residue 64
+#define SQ_MOD11 0x23bULL
+
+// Cheap rejection of non-squares; passes ~1 in 270 random values
+static int maybe_square(__uint128_t x)
+{
+    if (!((SQ_MOD64 >> (unsigned)(x & 63)) & 1))
+        return 0;
+    unsigned r = (unsigned)(x % 45045);   // 63 * 65 * 11
+    if (!((SQ_MOD63 >> (r % 63)) & 1))
+        return 0;
+    unsigned r65 = r % 65;
+    if (!((r65 < 64) ? (SQ_MOD65_LO >> r65) & 1 : SQ_MOD65_HI))
+        return 0;
+    return (SQ_MOD11 >> (r % 11)) & 1;
+}
+
+/*
+ * Fermat's method with an iteration budget
+ *
+ * Walks a = ceil(sqrt(n)), ceil(sqrt(n)) + 1, ... until a^2 - n = b^2, so
+ * n = (a - b)(a + b). It needs (p + q)/2 - sqrt(n) steps: a handful when p
+ * and q are close. Returns 0 once `budget` steps are spent.
+ */
+uint64_t fermat(uint64_t n, uint64_t budget, uint64_t *iterations)
+{
+    *iterations = 0;
+    
+    if (n % 2 == 0)
+    {
+        *iterations = 1;
+        return 2;
+    }
+    
+    uint64_t a = isqrt_u128(n);
+    if ((__uint128_t)a * a < n)
+        a++;
+    __uint128_t r = (__uint128_t)a * a - n;   // a^2 - n, updated incrementally
+    
+    while (*iterations < budget)
+    {
+        (*iterations)++;
+        if (maybe_square(r))
+        {
+            uint64_t b = isqrt_u128(r);
+            if ((__uint128_t)b * b == r)
+                return (a - b > 1) ? a - b : 0;
+        }
+        r += 2 * (__uint128_t)a + 1;
+        a++;
+    }
+    return 0;
+}
+
+// Unbounded: (n + 1)/2 - sqrt(n) steps always suffice for odd composite n
+uint64_t fermat_full(uint64_t n, uint64_t *iterations)
+{
+    return fermat(n, n, iterations);
+}
+
 // ============ Test Framework ============
 typedef struct {
     uint64_t n;
@@ -177,15 +541,24 @@ int main()
     
     int td_failures = test_algorithm("Trial Division", trial_division, tests, num_tests);
     int pr_failures = test_algorithm("Pollard's Rho", pollards_rho, tests, num_tests);
+    int sq_failures = test_algorithm("SQUFOF", squfof, tests, num_tests);
+    int lh_failures = test_algorithm("Lehman", lehman, tests, num_tests);
+    int ht_failures = test_algorithm("Hart OLF", hart, tests, num_tests);
+    int fm_failures = test_algorithm("Fermat", fermat_full, tests, num_tests);
     
     printf("========================================\n");
     printf("Final Summary\n");
     printf("========================================\n");
     printf("Trial Division: %d/%d tests passed\n", num_tests - td_failures, num_tests);
     printf("Pollard's Rho:  %d/%d tests passed\n", num_tests - pr_failures, num_tests);
+    printf("SQUFOF:         %d/%d tests passed\n", num_tests - sq_failures, num_tests);
+    printf("Lehman:         %d/%d tests passed\n", num_tests - lh_failures, num_tests);
+    printf("Hart OLF:       %d/%d tests passed\n", num_tests - ht_failures, num_tests);
+    printf("Fermat:         %d/%d tests passed\n", num_tests - fm_failures, num_tests);
     printf("\n");
     
-    if (td_failures == 0 && pr_failures == 0)
+    if (td_failures == 0 && pr_failures == 0 && sq_failures == 0 &&
+        lh_failures == 0 && ht_failures == 0 && fm_failures == 0)
     {
         printf("All tests passed!\n");
         return 0;